@@ -139,6 +139,15 @@ seqAnResult alignSeqAn(const std::string & row, const std::string & col, int rle
 }
 
 #ifndef __NVCC__
+// is the seed of col the reverse complement of the seed of row (compared in place)
+bool seedTwin(const std::string& row, const std::string& col, int i, int j, int kmerSize)
+{
+	bool twin = true;
+	for(int b = 0; b < kmerSize && twin; ++b)
+		twin = (complementbase(row[i + kmerSize - 1 - b]) == col[j + b]);
+	return twin;
+}
+
 /**
  * @brief alignLogan does the seed-and-extend alignment
  * @param row
@@ -147,7 +156,7 @@ seqAnResult alignSeqAn(const std::string & row, const std::string & col, int rle
  * @param i is the starting position of the k-mer on the first read
  * @param j is the starting position of the k-mer on the second read
  * @param xDrop
- * @return alignment score and extended seed
+ * @return alignment score and extended seed (on the reverse complement of row if the seed is on the other strand)
  */
 xavierResult xavierAlign(const std::string& row, const std::string& col, int rowLen, int i, int j, int xDrop, int kmerSize)
 {
@@ -155,31 +164,23 @@ xavierResult xavierAlign(const std::string& row, const std::string& col, int row
 	std::pair<int, int> tmp;
 	xavierResult result;
 
-	// penalties (LOGAN currently supports only linear gap penalty and penalty within +/- 3)
+	// penalties (linear gap penalty only, Xavier moves to int16 lanes when the band does not fit in int8)
 	short match    =  1;
 	short mismatch = -1;
 	short gap 	   = -1;
 
 	// initialize scoring scheme
-	ScoringSchemeX scoringScheme(match, mismatch, gap);	// enalties (LOGAN currently supports only linear gap penalty and penalty within +/- 3)
+	ScoringSchemeX scoringScheme(match, mismatch, gap);
 
 	SeedX seed(i, j, kmerSize);
-	std::string seedH = row.substr(getBeginPositionH(seed), kmerSize); 
-	std::string seedV = col.substr(getBeginPositionV(seed), kmerSize);
-
-	std::string rep = reversecomplement(seedH);
-	std::string cpyrow(row);
 
-	if(rep == seedV)
+	if(seedTwin(row, col, i, j, kmerSize))
 	{
-		std::reverse(std::begin(cpyrow), std::end(cpyrow));
-		std::transform(std::begin(cpyrow), std::end(cpyrow), std::begin(cpyrow), complementbase);
-
 		setBeginPositionH(seed, rowLen - i - kmerSize);
 		setEndPositionH(seed, rowLen - i);
 
-		// perform match extension reverse string
- 		tmp = XavierXDrop(seed, XAVIER_EXTEND_BOTH, cpyrow, col, scoringScheme, xDrop);
+		// perform match extension reverse string (read in place, backwards and complemented)
+ 		tmp = XavierXDrop(seed, XAVIER_EXTEND_BOTH, XavierView(row).twin(), col, scoringScheme, xDrop);
 		result.strand = "c";
 	}
 	else
@@ -200,6 +201,32 @@ xavierResult xavierAlign(const std::string& row, const std::string& col, int row
 	return result;
 }
 
+/**
+ * @brief xavierJobs appends the two extensions of a seed for BatchXDrop: left (the prefixes, walked backwards) then right
+ * @param row is already the reverse complement if the seed is on the other strand, and i is on it
+ */
+void xavierJobs(const std::string& row, const std::string& col, int i, int j, int kmerSize, std::vector<XDropJob>& jobs)
+{
+	jobs.push_back({row.data() + i - 1, -1, i, col.data() + j - 1, -1, j});
+	jobs.push_back({row.data() + i + kmerSize, 1, (int)row.length() - i - kmerSize,
+		col.data() + j + kmerSize, 1, (int)col.length() - j - kmerSize});
+}
+
+// the alignment of a seed from its two extensions, what xavierAlign returns (the k matches of the seed are scored)
+xavierResult xavierBatchResult(int i, int j, int kmerSize, bool twin, const XDropResult& left, const XDropResult& right)
+{
+	xavierResult result;
+	result.score  = left.score + kmerSize + right.score;
+	result.strand = twin ? "c" : "n";
+
+	setBeginPositionH(result.seed, i - left.hext);
+	setBeginPositionV(result.seed, j - left.vext);
+	setEndPositionH(result.seed, i + kmerSize + right.hext);
+	setEndPositionV(result.seed, j + kmerSize + right.vext);
+
+	return result;
+}
+
 #else
 
 // ======================================= //
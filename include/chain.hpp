@@ -30,26 +30,45 @@
 #include <omp.h>
 
 #include "common/common.h"
+#include "readstore.hpp"
 
 //	GG: check orientation
 bool
 checkstrand(const std::string& read1, const std::string& read2, const int begpH,
 	const int begpV, const int kmerSize) {
 
-	std::string seedH = read1.substr(begpH, kmerSize);
-	std::string seedV = read2.substr(begpV, kmerSize);
+	// compare in place: this runs once per shared k-mer in the SpGEMM, no substr copies
+	return read1.compare(begpH, kmerSize, read2, begpV, kmerSize) == 0;
+}
+
+// same on packed reads: the k-mers are compared a word at a time, nothing is decoded
+bool
+checkstrand(const ReadStore& reads1, size_t id1, const ReadStore& reads2, size_t id2,
+	const int begpH, const int begpV, const int kmerSize) {
 
-	if(seedH != seedV) return false;
-	else return true;
+	return reads1.equal(id1, begpH, reads2, id2, begpV, kmerSize);
 }
 
-//	GG: check strand and compute overlap length
+//	GG: overlap length of two reads sharing a k-mer, begpH is on the strand of read2
 int
-overlapop(const std::string& read1, const std::string& read2, unsigned short int begpH, 
-	unsigned short int begpV, const unsigned short int kmerSize) {
+overlaplength(int read1len, int read2len, int begpH, 
+	int begpV, const unsigned short int kmerSize) {
+
+	// GG: computing overlap length
+	int endpH = begpH + kmerSize;
+	int endpV = begpV + kmerSize;
+
+	int margin1 = std::min(begpH, begpV);
+	int margin2 = std::min(read1len - endpH, read2len - endpV);
+	int overlap = margin1 + margin2 + kmerSize;
+
+	return overlap;
+}
 
-	int read1len = read1.length();
-	int read2len = read2.length();
+//	GG: check strand and compute overlap length
+int
+overlapop(const std::string& read1, const std::string& read2, int begpH, 
+	int begpV, const unsigned short int kmerSize) {
 
 	// GG: checking strand
 	bool oriented = checkstrand(read1, read2, begpH, begpV, kmerSize);
@@ -59,95 +78,91 @@ overlapop(const std::string& read1, const std::string& read2, unsigned short int
 		begpH = read1.length() - begpH - kmerSize;
 	}
 
-	// GG: computing overlap length
-	unsigned short int endpH = begpH + kmerSize;
-	unsigned short int endpV = begpV + kmerSize;
+	return overlaplength(read1.length(), read2.length(), begpH, begpV, kmerSize);
+}
 
-	int margin1 = std::min(begpH, begpV);
-	int margin2 = std::min(read1len - endpH, read2len - endpV);
-	int overlap = margin1 + margin2 + kmerSize;
+int
+overlapop(const ReadStore& reads1, size_t id1, const ReadStore& reads2, size_t id2,
+	int begpH, int begpV, const unsigned short int kmerSize) {
 
-	return overlap;
+	if(!checkstrand(reads1, id1, reads2, id2, begpH, begpV, kmerSize))
+	{
+		begpH = reads1.length(id1) - begpH - kmerSize;
+	}
+
+	return overlaplength(reads1.length(id1), reads2.length(id2), begpH, begpV, kmerSize);
+}
+
+//	GG: overlap length of a pair from the seed of its best bin, on the strand of the bin
+int
+binoverlap(const spmatRefType_& value, int read1len, int read2len, const unsigned short int kmerSize) {
+
+	const seedBin_& bin = value.bins[value.best()];
+	int begpH = (bin.strand == 'n') ? (int)bin.seed.first : read1len - (int)bin.seed.first - kmerSize;
+
+	return overlaplength(read1len, read2len, begpH, bin.seed.second, kmerSize);
+}
+
+//	GG: q-gram lemma, two sequences of ovlen bases with at most divergence * ovlen edits share at least
+//	this many k-mers (on one diagonal band); not positive for short or noisy overlaps
+int
+qgramlemma(int ovlen, double divergence, const unsigned short int kmerSize) {
+
+	int edits = (int)std::ceil(divergence * ovlen);
+	return ovlen - kmerSize + 1 - kmerSize * edits;
+}
+
+//	GG: multiply operation, a shared k-mer is a bin of its own
+void
+multiop(spmatRefType_& value, const ReadStore& reads1, size_t id1, const ReadStore& reads2, size_t id2,
+	unsigned int begpH, unsigned int begpV, const int kmerSize) {
+
+	value.count = 1;
+	value.nbins = 1;
+
+	seedBin_& bin = value.bins[0];
+	bin.strand  = checkstrand(reads1, id1, reads2, id2, begpH, begpV, kmerSize) ? 'n' : 'c';
+	bin.support = 1;
+	bin.seed.first  = begpH;
+	bin.seed.second = begpV;
+
+	// diagonal on the strand of read2, as in overlapop
+	int posH = (bin.strand == 'n') ? (int)begpH : (int)reads1.length(id1) - (int)begpH - kmerSize;
+	bin.diag = (int)begpV - posH;
 }
 
-// DEFAULT (NOT DAVID'S)
-
-//	GG: multiply operation
-// void
-// multiop(spmatPtr_& value, const std::string& read1, const std::string& read2, 
-// 	unsigned short int begpH, unsigned short int begpV, const int kmerSize) {
-
-// 	value->count = 1;
-// 	vector<pair<unsigned short int, unsigned short int>> vec{std::make_pair(begpH, begpV)};	// GG: to facilitate bin division
-// 	value->pos.push_back(vec);
-// 	value->support.push_back(1);	// initial k-mer has support 1
-
-// 	// GG: check strand and compute overlap length
-// 	int overlap = overlapop(read1, read2, begpH, begpV, kmerSize);
-// 	value->overlap.push_back(overlap);
-// }
-
-// template <typename T,typename U>
-// std::pair<T,U> distance(const std::pair<T,U>& l, const std::pair<T,U>& r) {
-// 	return {std::abs(l.first - r.first), std::abs(l.second - r.second)};
-// }
-
-// template <typename T,typename U>
-// bool operator>(const std::pair<T,U>& l, const T& c) {
-// 	if(l.first > c && l.second > c) return true;
-// 	else return false;
-// }
-
-//	GG: binning operation
-// void
-// chainop(spmatPtr_& m1, spmatPtr_& m2, BELLApars& bpars)
-// {
-// 	// number of common k-mer
-// 	m1->count = m1->count + m2->count;
-// 	vector<unsigned short int> tobeinserted;
-// 	vector<vector<pair<unsigned short int, unsigned short int>>> kmertobeinserted(m1->pos.size());
-
-// 	for(int i = 0; i < m2->pos.size(); ++i)	
-// 	{
-// 		bool orphan = true;
-// 		for(int j = 0; j < m1->pos.size(); ++j)
-// 		{
-// 			if(std::abs(m2->overlap[i] - m1->overlap[j]) < bpars.binSize)
-// 			{
-// 				for(auto kmer1:m1->pos[j])
-// 				{
-// 					for(auto kmer2:m2->pos[i])
-// 					{
-// 						//	GG: kmer need to be not overlapping and at least <kmerRift> distant from each other (kmerRift = kmerSize deafult)
-// 						if(distance(kmer1, kmer2) > bpars.kmerSize)
-// 						{
-// 							kmertobeinserted[j].push_back(kmer2);
-// 						}
-// 					}
-// 				}
-// 				orphan = false;	// we can be within b length of multiple overlap estimations, so we can't break
-// 			}
-
-// 			if(orphan)
-// 			{
-// 				tobeinserted.push_back(i);	// we don't want to immediately insert to m1 and increase computational complexity
-// 			}
-// 		}
-// 	}
-
-// 	for (int j = 0; j < kmertobeinserted.size(); j++)
-// 	{
-// 		m1->support[j] += kmertobeinserted[j].size();
-// 		m1->count	   += kmertobeinserted[j].size();
-// 		m1->pos[j].insert(m1->pos[j].end(), kmertobeinserted[j].begin(), kmertobeinserted[j].end());
-// 	}
-
-// 	for (auto i:tobeinserted)
-// 	{
-// 		m1->pos.push_back(m2->pos[i]);
-// 		m1->overlap.push_back(m2->overlap[i]);
-// 		m1->support.push_back(m2->support[i]);
-// 	}
-// }
+//	GG: binning operation, the bins of m1 are added to those of m2: same strand and diagonals
+//	closer than binSize make one bin, which keeps the seed it had first
+void
+chainop(const spmatRefType_& m1, spmatRefType_& m2, const int binSize) {
+
+	m2.count = m2.count + m1.count;
+
+	for(int i = 0; i < m1.nbins; ++i)
+	{
+		const seedBin_& bin = m1.bins[i];
+
+		int j = 0;
+		while(j < m2.nbins && !(m2.bins[j].strand == bin.strand && std::abs(m2.bins[j].diag - bin.diag) < binSize))
+			++j;
+
+		if(j < m2.nbins)
+		{
+			m2.bins[j].support = std::min(65535, m2.bins[j].support + bin.support);
+		}
+		else if(m2.nbins < MAXBINS)
+		{
+			m2.bins[m2.nbins++] = bin;
+		}
+		else	// no room: the weakest bin is replaced only by a better supported one
+		{
+			int weakest = 0;
+			for(int w = 1; w < MAXBINS; ++w)
+				if(m2.bins[w].support < m2.bins[weakest].support) weakest = w;
+			if(bin.support > m2.bins[weakest].support)
+				m2.bins[weakest] = bin;
+		}
+	}
+}
 
 #endif
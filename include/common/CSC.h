@@ -36,6 +36,9 @@ public:
     template <typename AddOperation>
     CSC (vector<tuple<IT,IT,NT>> & tuple, IT m, IT n, AddOperation addop, bool needsort); // costruttore
     
+    template <typename VT, typename AddOperation>
+    CSC (vector<vector<tuple<IT,IT,VT>>> & buckets, IT m, IT n, AddOperation addop, bool transpose); // from per-thread tuples, consumes them
+
     template <typename AddOperation>
     void MergeDuplicates (AddOperation addop, bool issorted); // method
 
@@ -1,7 +1,7 @@
 
-template <typename KIND, typename CIND>  // kmer_index, count_index
+template <typename KT, typename KIND, typename CIND>  // kmer_type, kmer_index, count_index
 void WriteToDisk(const vector<vector<tuple<KIND, KIND, CIND>>> & alltranstuples,
-                 const CuckooDict<KIND> & countsreliable,
+                 const CuckooDict<KT, KIND> & countsreliable,
                  KIND readcount, KIND tuplecount)
 {
 	cout << "Writing to disk" << endl;
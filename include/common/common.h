@@ -6,6 +6,7 @@
 #include <seqan/score.h>
 #include <seqan/modifier.h>
 #include <seqan/seeds.h>
+#include <type_traits>
 
 #ifndef __NVCC__
 	#include "../xavier/xavier.h"
@@ -47,8 +48,13 @@ struct BELLApars
 {
 	unsigned short int		kmerSize;			// KmerSize
 	unsigned short int		binSize;			// Bin size chaining algorithm 			(b)
+	unsigned short int		minSupport;			// K-mers the best bin needs to be aligned 	(chain-support)
+	unsigned short int		minShared;			// Shared k-mers a pair needs to be aligned 	(min-shared)
+	int						minOverlap;			// Estimated overlap a pair needs to be aligned (min-overlap)
+	bool					useQgram;			// Q-gram lemma filter before alignment 	(qgram)
 	short int		        fixedThreshold;		// Default alignment score threshold 	(a)
 	unsigned short int		xDrop;				// SeqAn xDrop value 					(x)
+	bool					batchAlign;			// Many pairs per SIMD vector in X-drop 	(batch-xdrop)
 	unsigned short int		numGPU;				// Number GPUs available/to be used  	(g)
 	unsigned short int		SplitCount;			// Number of splits counting k-mers  	(s)
 	unsigned int 			chunkSize;			//Size of Reference Genome Chunks		(c)
@@ -58,6 +64,12 @@ struct BELLApars
 	bool	userDefMem;			// RAM available 										(m)
 
 	bool 	useHOPC; 			// use HOPC representation
+	bool 	useMPHF; 			// freeze the reliable k-mers into a minimal perfect hash
+	bool 	useSortCount; 		// count k-mers by radix sort instead of bloom filter + hash table
+	std::string tmpDir; 		// if not empty, count k-mers in super-k-mer bins written here
+	bool 	useIndex64; 		// 64-bit k-mer ids, read ids and nonzero counts, otherwise picked from the input size
+	std::string spgemmKernel; 	// kernel forming the overlap matrix: auto (by flops per nonzero), hash or esc (spgemm)
+	int 	spgemmThreads; 		// threads forming the overlap matrix while the others align, 0: a quarter (spgemm-threads)
 
 	double	deltaChernoff;		// delta computed via Chernoff bound 					(d)
 	double	totalMemory;		// In MB, default is ~ 8GB
@@ -69,8 +81,8 @@ struct BELLApars
     bool useMinimizer;			// use HOPC representation
     size_t windowLen;           // window length								        (w)
 
-	BELLApars(): kmerSize(17), binSize(500), fixedThreshold(-1), xDrop(7), numGPU(1), SplitCount(1), chunkSize(100000),
-					estimateErr(false), skipAlignment(false), outputPaf(false), userDefMem(false), useHOPC(false), deltaChernoff(0.10), 
+	BELLApars(): kmerSize(17), binSize(500), minSupport(1), minShared(1), minOverlap(0), useQgram(false), fixedThreshold(-1), xDrop(7), batchAlign(false), numGPU(1), SplitCount(1), chunkSize(100000),
+					estimateErr(false), skipAlignment(false), outputPaf(false), userDefMem(false), useHOPC(false), useMPHF(false), useSortCount(false), useIndex64(false), spgemmKernel("auto"), spgemmThreads(0), deltaChernoff(0.10), 
 						totalMemory(8000.0), errorRate(0.00), HOPCerate(0.035), useSyncmer(0), useMinimizer(0), windowLen(0)  {};
 };
 
@@ -117,11 +129,53 @@ struct SortBy:std::binary_function<unsigned short int, unsigned short int, bool>
 	const std::vector<unsigned short int>& vec;
 };
 
+#define MAXBINS 4	// diagonal bins kept per overlap record
+
+//	k-mer position <read-i, read-j>, plain struct (std::pair is not trivially copyable)
+//	32-bit: reads and reference chunks can be longer than 65,535 bases
+struct seedPos_ {
+	unsigned int first;
+	unsigned int second;
+};
+
+//	Shared k-mers of a pair on the same strand and within binSize (-b) of the same diagonal: one overlap candidate
+struct seedBin_ {
+	int diag;					// diagonal of the first k-mer of the bin, position on read-j minus position on read-i (on the strand of read-j)
+	unsigned short int support;	// k-mers in the bin
+	char strand;				// 'n' if the k-mers are on the same strand, 'c' otherwise
+	seedPos_ seed;				// first k-mer of the bin, where the alignment starts
+};
+
 // GGGG: this is the SpMat David Schober should use for now when working on reference genome using SpMat (simpler type, we can go back to the more compelx one later)
+//	Inline overlap record: no heap payload, so sizeof(spmatRefType_) is the whole per-nonzero cost of C
 struct spmatRefType_ {
-	unsigned short int count = 0; // number of shared k-mers
-	std::vector<pair<unsigned short int, unsigned short int>> pos; // std::vector of k-mer positions <read-i, read-j> (use at most 2 kmers)
+	uint32_t count;				// number of shared k-mers (32-bit: ultra-long pairs share more than 65,535)
+	unsigned char nbins;		// number of valid entries in bins
+	seedBin_ bins[MAXBINS];		// best supported diagonal bins (see chainop in chain.hpp)
+
+	// bin with the most k-mers, the first one found on ties
+	int best() const
+	{
+		int b = 0;
+		for(int i = 1; i < nbins; ++i)
+			if(bins[i].support > bins[b].support) b = i;
+		return b;
+	}
+
+	//	GG: seed of the most voted bin
+	pair<unsigned int, unsigned int> choose() const
+	{
+		const seedPos_& seed = bins[best()].seed;
+		return std::make_pair(seed.first, seed.second);
+	}
+
+	//	GG: number of k-mers supporting the most voted bin
+	unsigned short int support() const
+	{
+		return bins[best()].support;
+	}
 };
+static_assert(std::is_trivially_copyable<spmatRefType_>::value, "overlap record must be trivially copyable");
 
 // GGGG: BELLA's default type
 struct spmatType_ {
@@ -188,7 +242,7 @@ struct spmatType_ {
 // typedef shared_ptr<spmatType_> spmatPtr_; // pointer to spmatType_ datastruct
 
 // GGGG: David's type
-typedef shared_ptr<spmatRefType_> spmatPtr_; // pointer to spmatType_ datastruct
+typedef spmatRefType_ spmatVal_; // value type of the overlap matrix, stored inline
 
 typedef std::vector<Kmer> Kmers;
 
@@ -31,20 +31,24 @@
 #include <omp.h>
 #include <fstream>
 #include <typeinfo>
+#include <deque>
+#include <unistd.h>
 
 #ifdef __NVCC__
 #include "../loganGPU/logan.cuh"
 #endif
 
 #include "../libcuckoo/cuckoohash_map.hh"
-#include "../libbloom/bloom64.h"
+#include "../libbloom/blockedbloom64.h"
 
 #include "../kmercode/hash_funcs.h"
 #include "../kmercode/Kmer.hpp"
+#include "../kmercode/KmerIterator.hpp"
 #include "../kmercode/Buffer.h"
 #include "../kmercode/common.h"
 #include "../kmercode/fq_reader.h"
 #include "../kmercode/ParallelFASTQ.h"
+#include "../kmercode/MappedFASTQ.h"
 #include "../kmercode/bound.hpp"
 #include "../kmercode/hyperloglog.hpp"
 #include "common/common.h"
@@ -61,12 +65,36 @@ using namespace std;
 #endif
 
 
-template <typename IT>
-using CuckooDict = cuckoohash_map<Kmer, IT>;
+//	KT is Kmer32 or Kmer64 (see FixedKmer.hpp), IT the type of the k-mer ids
+template <typename KT, typename IT>
+using CuckooDict = cuckoohash_map<KT, IT>;
 
 
 //    GG: when couting k-mers the values can be 16bit (k-mer occurrence) instead of 32 (k-mer ids in the final dictionary)
-typedef cuckoohash_map<Kmer, unsigned short int> dictionary_t_16bit;	// <k-mer && reverse-complement, kmer_multiplicity>
+template <typename KT>
+using dictionary_t_16bit = cuckoohash_map<KT, unsigned short int>;	// <k-mer && reverse-complement, kmer_multiplicity>
+
+/**
+ * @brief BloomInsert: first counting pass, a k-mer goes into the hash table
+ * the second time the bloom filter sees it (one 64-bit hash per k-mer)
+ */
+template <typename KT>
+void BloomInsert(BlockedBloom64& bm, const vector<KT>& kmers, dictionary_t_16bit<KT>& countsdenovo)
+{
+	const size_t batch = 256;
+	uint64_t hashes[batch];
+	uint8_t inBloom[batch];
+
+	for(size_t b = 0; b < kmers.size(); b += batch)
+	{
+		size_t n = std::min(batch, kmers.size() - b);
+		for(size_t i = 0; i < n; ++i)
+			hashes[i] = kmers[b+i].hash();
+		bm.check_add_batch(hashes, n, inBloom);
+		for(size_t i = 0; i < n; ++i)
+			if(inBloom[i]) countsdenovo.insert(kmers[b+i], 0);
+	}
+}
 
 struct filedata {
 
@@ -123,8 +151,8 @@ vector<filedata>  GetFiles(char *filename) {
  * @param bpars.kmerSize
  * @param upperlimit
  */
-template <typename IT>
-void SimpleCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
+template <typename KT, typename IT>
+void SimpleCount(vector<filedata> & allfiles, CuckooDict<KT, IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
 	size_t upperlimit, BELLApars & bpars)
 {
 	vector < vector<double> > allquals(MAXTHREADS);
@@ -132,14 +160,14 @@ void SimpleCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
 	double denovocount = omp_get_wtime();
 	size_t totreads = 0;
 
-	dictionary_t_16bit countsdenovo;
+	dictionary_t_16bit<KT> countsdenovo;
 	auto updatefn = [](unsigned short int &count) { if (count < std::numeric_limits<unsigned short int>::max()) ++count; };
 
 	for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++) 
 	{
 		#pragma omp parallel
 		{
-			ParallelFASTQ *pfq = new ParallelFASTQ();
+			MappedFASTQ *pfq = new MappedFASTQ();
 			pfq->open(itr->filename, false, itr->filesize);
 
 			if(MYTHREAD == 0)
@@ -148,9 +176,9 @@ void SimpleCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
     		    		printLog(ReadingFASTQ);
     			}
 
-			vector<string> seqs;
-			vector<string> quals;
-			vector<string> nametags;
+			vector<SeqView> seqs;
+			vector<SeqView> quals;
+			vector<SeqView> nametags;
 			size_t tlreads = 0; // thread local reads
 
 			size_t fillstatus = 1;
@@ -163,29 +191,19 @@ void SimpleCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
 				{
 					// remember that the last valid position is length()-1
 					int len = seqs[i].length();
-					double rerror = 0.0;
 
-					for(int j = 0; j<= len - bpars.kmerSize; j++)  
+					KmerIterator<KT> kmers(seqs[i].data(), len, bpars.kmerSize);
+					while(kmers.next())
 					{
-						std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-						Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-						Kmer lexsmall = mykmer.rep();
-
-                        countsdenovo.upsert(lexsmall, updatefn, 1);
-						
-						if(bpars.estimateErr == true) 
-						{
-								// accuracy
-								int bqual = (int)quals[i][j] - ASCIIBASE;
-								double berror = pow(10,-(double)bqual/10);
-								rerror += berror;
-						}
+						KT lexsmall = kmers.rep();
+						countsdenovo.upsert(lexsmall, updatefn, 1);
 					}
 
 					if(bpars.estimateErr == true) 
 					{
-						// remaining k qual position accuracy
-						for(int j = len - bpars.kmerSize + 1; j < len; j++)
+						// accuracy of every base of the read
+						double rerror = 0.0;
+						for(int j = 0; j < (int)quals[i].length(); j++)
 						{
 							int bqual = (int)quals[i][j] - ASCIIBASE;
 							double berror = pow(10,-(double)bqual/10);
@@ -260,11 +278,11 @@ void SimpleCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
  * @param bpars.kmerSize
  * @param upperlimit
  */
-template <typename IT>
-void DeNovoCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
+template <typename KT, typename IT>
+void DeNovoCount(vector<filedata> & allfiles, CuckooDict<KT, IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
 	size_t upperlimit, BELLApars & bpars)
 {
-	vector < vector<Kmer> >   allkmers(MAXTHREADS);
+	vector < vector<KT> >   allkmers(MAXTHREADS);
 	vector < vector<double> > allquals(MAXTHREADS);
 	vector < HyperLogLog > hlls(MAXTHREADS, HyperLogLog(12));   // std::vector fill constructor
 
@@ -276,7 +294,7 @@ void DeNovoCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
 	{
 		#pragma omp parallel
 		{
-			ParallelFASTQ *pfq = new ParallelFASTQ();
+			MappedFASTQ *pfq = new MappedFASTQ();
 			pfq->open(itr->filename, false, itr->filesize);
 
 			if(MYTHREAD == 0)
@@ -285,9 +303,9 @@ void DeNovoCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
     		    		printLog(ReadingFASTQ);
     			}
 
-			vector<string> seqs;
-			vector<string> quals;
-			vector<string> nametags;
+			vector<SeqView> seqs;
+			vector<SeqView> quals;
+			vector<SeqView> nametags;
 			size_t tlreads = 0; // thread local reads
 
 			size_t fillstatus = 1;
@@ -300,40 +318,30 @@ void DeNovoCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
 				{
 					// remember that the last valid position is length()-1
 					int len = seqs[i].length();
-					double rerror = 0.0;
 
-					for(int j = 0; j<= len - bpars.kmerSize; j++)  
+					KmerIterator<KT> kmers(seqs[i].data(), len, bpars.kmerSize);
+					while(kmers.next())
 					{
-						std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-						Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-
-						Kmer lexsmall;
+						KT lexsmall;
 
 						if (bpars.useHOPC)
 						{
-							lexsmall = mykmer.hopc();
+							lexsmall = kmers.forward().hopc();
 						}
 						else
 						{
-							lexsmall = mykmer.rep();
+							lexsmall = kmers.rep();
 						}
 
 						allkmers[MYTHREAD].push_back(lexsmall);
 						hlls[MYTHREAD].add((const char*) lexsmall.getBytes(), lexsmall.getNumBytes());
-
-						if(bpars.estimateErr == true) 
-						{
-								// accuracy
-								int bqual = (int)quals[i][j] - ASCIIBASE;
-								double berror = pow(10,-(double)bqual/10);
-								rerror += berror;
-						}
 					}
 
 					if(bpars.estimateErr == true) 
 					{
-						// remaining k qual position accuracy
-						for(int j = len - bpars.kmerSize + 1; j < len; j++)
+						// accuracy of every base of the read
+						double rerror = 0.0;
+						for(int j = 0; j < (int)quals[i].length(); j++)
 						{
 							int bqual = (int)quals[i][j] - ASCIIBASE;
 							double berror = pow(10,-(double)bqual/10);
@@ -380,32 +388,27 @@ void DeNovoCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_de
 	printLog(kmerCountingTime);
 
 	const double desired_probability_of_false_positive = 0.05;
-	struct bloom * bm = (struct bloom*) malloc(sizeof(struct bloom));
-	bloom_init64(bm, CardinalityEstimate * 1.1, desired_probability_of_false_positive);
+	std::unique_ptr<BlockedBloom64> bm(new BlockedBloom64(CardinalityEstimate * 1.1, desired_probability_of_false_positive));
 
-	double TableSize = ((double)bm->bits)/8/1024/1024;
-	int numHashFunctions = bm->hashes;
+	double TableSize = ((double)bm->bits())/8/1024/1024;
+	int numHashFunctions = bm->hashes();
 
 	printLog(CardinalityEstimate);
 	printLog(TableSize);
 	printLog(numHashFunctions);
 
-	dictionary_t_16bit countsdenovo;
+	dictionary_t_16bit<KT> countsdenovo;
 
 	#pragma omp parallel
 	{
-		for(auto v:allkmers[MYTHREAD])
-		{
-			bool inBloom = (bool) bloom_check_add(bm, v.getBytes(), v.getNumBytes(),1);
-			if(inBloom) countsdenovo.insert(v, 0);
-		}
+		BloomInsert(*bm, allkmers[MYTHREAD], countsdenovo);
 	}
 
 	double firstpass = omp_get_wtime();
 	std::string FirstKmerPassTime = std::to_string(firstpass - load2kmers) + " seconds";
 	printLog(FirstKmerPassTime);
 
-	free(bm); // release bloom filter memory
+	bm.reset(); // release bloom filter memory
 
 	// in this pass, only use entries that already are in the hash table
 	auto updatecount = [](unsigned short int &num) { ++num; };
@@ -463,8 +466,8 @@ double getAvg(double prev_avg, double x, int64_t n)
  * @param bpars.kmerSize
  * @param upperlimit
  */
-template <typename IT>
-void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_denovo, int& LowerBound, int& UpperBound, 
+template <typename KT, typename IT>
+void SplitCount(vector<filedata> & allfiles, CuckooDict<KT, IT> & countsreliable_denovo, int& LowerBound, int& UpperBound, 
 	size_t upperlimit, BELLApars & bpars)
 {
 	size_t totreads = 0;
@@ -479,14 +482,14 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
 	{
 		double denovocount = omp_get_wtime();
 		
-		vector < vector<Kmer> >   allkmers(MAXTHREADS);
+		vector < vector<KT> >   allkmers(MAXTHREADS);
 		vector < HyperLogLog > hlls(MAXTHREADS, HyperLogLog(12));   // std::vector fill constructor
 		
 		for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++) 
 		{
 			#pragma omp parallel
 			{
-				ParallelFASTQ *pfq = new ParallelFASTQ();
+				MappedFASTQ *pfq = new MappedFASTQ();
 				pfq->open(itr->filename, false, itr->filesize);
 
 				if(MYTHREAD == 0)
@@ -495,9 +498,9 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
     		    			printLog(ReadingFASTQ);
     				}
 
-				vector<string> seqs;
-				vector<string> quals;
-				vector<string> nametags;
+				vector<SeqView> seqs;
+				vector<SeqView> quals;
+				vector<SeqView> nametags;
 
 				size_t tlreads = 0; // thread local reads
 				size_t tlbases = 0; // thread local bases
@@ -513,22 +516,19 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
 					{
 						// remember that the last valid position is length()-1
 						int len = seqs[i].length();
-						double rerror = 0.0;
 
-						for(int j = 0; j<= len - bpars.kmerSize; j++)  
+						KmerIterator<KT> kmers(seqs[i].data(), len, bpars.kmerSize);
+						while(kmers.next())
 						{
-							std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-							Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-
-							Kmer lexsmall;
+							KT lexsmall;
 
 							if (bpars.useHOPC)
 							{
-								lexsmall = mykmer.hopc();
+								lexsmall = kmers.forward().hopc();
 							}
 							else
 							{
-								lexsmall = mykmer.rep();
+								lexsmall = kmers.rep();
 							}
 
 							if(lexsmall.hash() % bpars.SplitCount == CurrSplitCount)	// mod bpars.SplitCount
@@ -536,24 +536,16 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
 								allkmers[MYTHREAD].push_back(lexsmall);
 								hlls[MYTHREAD].add((const char*) lexsmall.getBytes(), lexsmall.getNumBytes());
 							}
-							if(CurrSplitCount == 0 && bpars.estimateErr == true) 
-							{
-								// accuracy
-								int bqual = (int)quals[i][j] - ASCIIBASE;
-								double berror = pow(10,-(double)bqual/10);
-        							tlave = getAvg(tlave, berror, tlbases++); 
-							}
-
 						}
 
 						if(CurrSplitCount == 0 && bpars.estimateErr == true) 
 						{
-							// remaining k qual position accuracy
-							for(int j = len - bpars.kmerSize + 1; j < len; j++)
+							// accuracy of every base of the read
+							for(int j = 0; j < (int)quals[i].length(); j++)
 							{
 								int bqual = (int)quals[i][j] - ASCIIBASE;
 								double berror = pow(10,-(double)bqual/10);
-        							tlave = getAvg(tlave, berror, tlbases++); 									
+        							tlave = getAvg(tlave, berror, tlbases++); 
 							}
 						}
 					} // for(int i=0; i<nreads; i++)
@@ -597,25 +589,20 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
 	
 	
 		const double desired_probability_of_false_positive = 0.05;
-		struct bloom * bm = (struct bloom*) malloc(sizeof(struct bloom));
-		bloom_init64(bm, CardinalityEstimate * 1.1, desired_probability_of_false_positive);
+		std::unique_ptr<BlockedBloom64> bm(new BlockedBloom64(CardinalityEstimate * 1.1, desired_probability_of_false_positive));
 
-		double TableSize = ((double)bm->bits)/8/1024/1024;
-		int numHashFunctions = bm->hashes;
+		double TableSize = ((double)bm->bits())/8/1024/1024;
+		int numHashFunctions = bm->hashes();
 
 		printLog(CardinalityEstimate);
 		printLog(TableSize);
 		printLog(numHashFunctions);
 
-		dictionary_t_16bit countsdenovo;
+		dictionary_t_16bit<KT> countsdenovo;
 
 		#pragma omp parallel
 		{
-			for(auto v:allkmers[MYTHREAD])
-			{
-				bool inBloom = (bool) bloom_check_add(bm, v.getBytes(), v.getNumBytes(),1);
-				if(inBloom) countsdenovo.insert(v, 0);
-			}
+			BloomInsert(*bm, allkmers[MYTHREAD], countsdenovo);
 		}
 		size_t tot_kmers = 0;
 		for (int i=0; i<MAXTHREADS; i++)
@@ -630,7 +617,7 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
 		std::string FirstKmerPassTime = std::to_string(firstpass - load2kmers) + " seconds";
 		printLog(FirstKmerPassTime);
 
-		free(bm); // release bloom filter memory
+		bm.reset(); // release bloom filter memory
 
 		// in this pass, only use entries that already are in the hash table
 		auto updatecount = [](unsigned short int &num) { ++num; };
@@ -678,6 +665,588 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
 
 
 
+#define SORTCOUNT_PARTITIONS 256	// hash partitions sorted independently (top 8 bits of the hash)
+
+/**
+ * @brief RadixSortKmers: LSD radix sort of n k-mers on 8-bit digits, in lexicographic order
+ * the 64*W-2k low bits of a left aligned k-mer are always zero and are not sorted,
+ * passes whose digit is the same for every k-mer are skipped
+ * @return a (the input) or buf, whichever holds the sorted k-mers
+ */
+template <typename KT>
+KT* RadixSortKmers(KT* a, KT* buf, size_t n)
+{
+	const size_t ndigits = 8 * KT::NUM_WORDS;
+	const size_t zerodigits = (64 * KT::NUM_WORDS - 2 * KT::k) / 8;
+	size_t count[256];
+
+	for(size_t d = zerodigits; d < ndigits; ++d)
+	{
+		size_t word  = KT::NUM_WORDS - 1 - d / 8;	// digit 0 is the least significant byte of the last word
+		size_t shift = 8 * (d % 8);
+
+		std::fill(count, count + 256, 0);
+		for(size_t i = 0; i < n; ++i)
+			++count[(a[i].getWord(word) >> shift) & 0xFF];
+
+		if(n == 0 || count[(a[0].getWord(word) >> shift) & 0xFF] == n)
+			continue;
+
+		size_t sofar = 0;
+		for(int b = 0; b < 256; ++b)
+		{
+			size_t c = count[b];
+			count[b] = sofar;
+			sofar += c;
+		}
+		for(size_t i = 0; i < n; ++i)
+			buf[count[(a[i].getWord(word) >> shift) & 0xFF]++] = a[i];
+		std::swap(a, buf);
+	}
+	return a;
+}
+
+/**
+ * @brief SortCount: same input and output as SplitCount, but k-mers are counted
+ * by sorting instead of bloom filter + hash table: k-mers are scattered into hash
+ * partitions (parallel histogram + prefix sum), each partition is radix sorted
+ * and run-length counted, reliable k-mers get their ids from a prefix sum over
+ * the partitions. Memory is twice the k-mers of a split, no random probes.
+ * @param allfiles
+ * @param countsreliable_denovo
+ * @param LowerBound
+ * @param UpperBound
+ * @param bpars.kmerSize
+ * @param upperlimit
+ */
+template <typename KT, typename IT>
+void SortCount(vector<filedata> & allfiles, CuckooDict<KT, IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
+	size_t upperlimit, BELLApars & bpars)
+{
+	size_t totreads = 0;
+	size_t totbases = 0;
+
+	double avesofar = 0.0;
+
+	// Reliable k-mer filter on the sorted runs
+	IT kmer_id_denovo = 0;
+
+	for(int CurrSplitCount = 0; CurrSplitCount < bpars.SplitCount; ++CurrSplitCount)	// bpars.SplitCount
+	{
+		double denovocount = omp_get_wtime();
+
+		vector < vector<KT> >   allkmers(MAXTHREADS);
+
+		for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
+		{
+			#pragma omp parallel
+			{
+				MappedFASTQ *pfq = new MappedFASTQ();
+				pfq->open(itr->filename, false, itr->filesize);
+
+				if(MYTHREAD == 0)
+				{
+					const char* ReadingFASTQ = itr->filename;
+					printLog(ReadingFASTQ);
+				}
+
+				vector<SeqView> seqs;
+				vector<SeqView> quals;
+				vector<SeqView> nametags;
+
+				size_t tlreads = 0; // thread local reads
+				size_t tlbases = 0; // thread local bases
+				double tlave = 0.0; // thread local error rate average
+
+				size_t fillstatus = 1;
+				while(fillstatus)
+				{
+					fillstatus = pfq->fill_block(nametags, seqs, quals, upperlimit);
+					size_t nreads = seqs.size();
+
+					for(int i = 0; i < nreads; i++)
+					{
+						// remember that the last valid position is length()-1
+						int len = seqs[i].length();
+
+						KmerIterator<KT> kmers(seqs[i].data(), len, bpars.kmerSize);
+						while(kmers.next())
+						{
+							KT lexsmall = bpars.useHOPC ? kmers.forward().hopc() : kmers.rep();
+
+							if(lexsmall.hash() % bpars.SplitCount == CurrSplitCount)	// mod bpars.SplitCount
+								allkmers[MYTHREAD].push_back(lexsmall);
+						}
+
+						if(CurrSplitCount == 0 && bpars.estimateErr == true)
+						{
+							// accuracy of every base of the read
+							for(int j = 0; j < (int)quals[i].length(); j++)
+							{
+								int bqual = (int)quals[i][j] - ASCIIBASE;
+								double berror = pow(10,-(double)bqual/10);
+								tlave = getAvg(tlave, berror, tlbases++);
+							}
+						}
+					} // for(int i=0; i<nreads; i++)
+					tlreads += nreads;
+				} //while(fillstatus)
+				delete pfq;
+
+				if(CurrSplitCount == 0)	// don't overcount by a factor of bpars.SplitCount
+				{
+					#pragma omp critical
+					{
+						totreads += tlreads;
+						avesofar = (avesofar * totbases + tlave * tlbases) / (totbases + tlbases);
+						totbases += tlbases;
+					}
+				}
+
+			} // #pragma omp parallel
+
+		} // for allfiles
+
+		if(CurrSplitCount == 0)
+		{
+			if(bpars.estimateErr == true)
+			{
+				bpars.errorRate = avesofar;
+				printLog(bpars.errorRate);
+			}
+		}
+
+		double load2kmers = omp_get_wtime();
+		std::string kmerCountingTime = std::to_string(load2kmers - denovocount) + " seconds";
+		printLog(kmerCountingTime);
+
+		// ======================================== //
+		//  Scatter into partitions (by hash)       //
+		// ======================================== //
+
+		int nthreads = allkmers.size();
+		auto partitionof = [](const KT& km) { return km.hash() >> 56; };	// SplitCount uses the low bits
+
+		// hist[t][p]: k-mers of thread t in partition p, then where they go in sorted
+		vector < vector<size_t> > hist(nthreads, vector<size_t>(SORTCOUNT_PARTITIONS, 0));
+		#pragma omp parallel for
+		for(int t = 0; t < nthreads; ++t)
+			for(const KT& km : allkmers[t])
+				++hist[t][partitionof(km)];
+
+		vector<size_t> partptr(SORTCOUNT_PARTITIONS + 1, 0);
+		size_t sofar = 0;
+		for(int p = 0; p < SORTCOUNT_PARTITIONS; ++p)
+		{
+			partptr[p] = sofar;
+			for(int t = 0; t < nthreads; ++t)
+			{
+				size_t c = hist[t][p];
+				hist[t][p] = sofar;
+				sofar += c;
+			}
+		}
+		partptr[SORTCOUNT_PARTITIONS] = sofar;
+		size_t tot_kmers = sofar;
+
+		vector<KT> partitioned(tot_kmers);
+		#pragma omp parallel for
+		for(int t = 0; t < nthreads; ++t)
+		{
+			for(const KT& km : allkmers[t])
+				partitioned[hist[t][partitionof(km)]++] = km;
+			vector<KT>().swap(allkmers[t]);	// free as we go
+		}
+
+		printLog(CurrSplitCount);
+		std::string TotalKmers = std::to_string(tot_kmers);
+		printLog(TotalKmers);
+
+		double scatter = omp_get_wtime();
+		std::string ScatterKmerTime = std::to_string(scatter - load2kmers) + " seconds";
+		printLog(ScatterKmerTime);
+
+		// ======================================== //
+		//  Sort, run-length count and filter       //
+		// ======================================== //
+
+		// reliable k-mers of each partition are compacted at the beginning of the partition
+		vector<size_t> reliableinpart(SORTCOUNT_PARTITIONS, 0);
+		#pragma omp parallel
+		{
+			vector<KT> buf;	// radix sort buffer, reused across partitions
+			#pragma omp for schedule(dynamic, 1)
+			for(int p = 0; p < SORTCOUNT_PARTITIONS; ++p)
+			{
+				size_t n = partptr[p+1] - partptr[p];
+				KT* part = partitioned.data() + partptr[p];
+				if(buf.size() < n) buf.resize(n);
+				KT* sorted = RadixSortKmers(part, buf.data(), n);
+
+				size_t nreliable = 0;
+				for(size_t i = 0; i < n; )
+				{
+					size_t j = i + 1;
+					while(j < n && sorted[j] == sorted[i]) ++j;
+					size_t count = j - i;
+					if(count >= (size_t)LowerBound && count <= (size_t)UpperBound)
+						part[nreliable++] = sorted[i];	// safe: nreliable <= i, and sorted is either part or buf
+					i = j;
+				}
+				reliableinpart[p] = nreliable;
+			}
+		}
+
+		double sorting = omp_get_wtime();
+		std::string SortKmerTime = std::to_string(sorting - scatter) + " seconds";
+		printLog(SortKmerTime);
+
+		// ids are assigned partition after partition
+		vector<size_t> idptr(SORTCOUNT_PARTITIONS + 1, 0);
+		std::partial_sum(reliableinpart.begin(), reliableinpart.end(), idptr.begin() + 1);
+
+		countsreliable_denovo.reserve(countsreliable_denovo.size() + idptr[SORTCOUNT_PARTITIONS]);
+		#pragma omp parallel for schedule(dynamic, 1)
+		for(int p = 0; p < SORTCOUNT_PARTITIONS; ++p)
+		{
+			const KT* part = partitioned.data() + partptr[p];
+			for(size_t i = 0; i < reliableinpart[p]; ++i)
+				countsreliable_denovo.insert(part[i], kmer_id_denovo + static_cast<IT>(idptr[p] + i));
+		}
+		kmer_id_denovo += static_cast<IT>(idptr[SORTCOUNT_PARTITIONS]);
+
+		std::string ReliableKmerInsertTime = std::to_string(omp_get_wtime() - sorting) + " seconds";
+		printLog(ReliableKmerInsertTime);
+
+		// Print some information about the table
+		if (countsreliable_denovo.size() == 0)
+		{
+			std::string ErrorMessage = "BELLA terminated: 0 entries within reliable range. You may want to reduce the k-mer lenght.";
+			printLog(ErrorMessage);
+			exit(1);
+		}
+		else
+		{
+			size_t numReliableKmers = countsreliable_denovo.size();
+			printLog(numReliableKmers);
+		}
+
+	} // for all bpars.SplitCount
+}
+
+#define DISKCOUNT_BINS 64			// bins when --split-count is not given
+#define DISKCOUNT_MINIMIZER 11		// length of the m-mers used to bin super-k-mers (odd: no palindromes)
+#define DISKCOUNT_BUFFER (1 << 15)	// bytes buffered per thread and bin before writing
+
+/**
+ * @brief SuperKmers: split an A/C/G/T-only segment in maximal runs of consecutive
+ * k-mers sharing the same minimizer, the minimizer is the m-mer with the smallest
+ * hash among the canonical m-mers of a k-mer, so both strands of a k-mer get the
+ * same bin (minimizer hash % nbins)
+ * @param emit(begin, length, minhash) for every super-k-mer of the segment
+ */
+template <typename F>
+void SuperKmers(const char* seg, size_t len, unsigned int k, unsigned int m, F emit)
+{
+	if(len < k) return;
+
+	const uint8_t* codes = KmerIterator<Kmer32>::baseCodes();
+	const uint64_t mask = (1ULL << (2*m)) - 1;
+
+	size_t nmmers = len - m + 1;
+	vector<uint64_t> mhash(nmmers);
+	uint64_t fw = 0, rc = 0;
+	for(size_t i = 0; i < len; ++i)
+	{
+		uint64_t c = codes[(unsigned char)seg[i]];
+		fw = ((fw << 2) | c) & mask;
+		rc = (rc >> 2) | ((3 - c) << (2*(m-1)));
+		if(i + 1 >= m) mhash[i + 1 - m] = fmix64(std::min(fw, rc));
+	}
+
+	// sliding window minimum over the k-m+1 m-mers of each k-mer
+	std::deque<size_t> window;
+	size_t w = k - m + 1;
+	size_t skbegin = 0, skmin = 0;
+	for(size_t j = 0; j < nmmers; ++j)
+	{
+		while(!window.empty() && mhash[window.back()] > mhash[j]) window.pop_back();
+		window.push_back(j);
+		if(j + 1 < w) continue;
+
+		size_t kbegin = j + 1 - w;	// k-mer starting here
+		while(window.front() < kbegin) window.pop_front();
+
+		if(kbegin == 0)
+			skmin = window.front();
+		else if(window.front() != skmin)	// close the super-k-mer of the previous k-mers
+		{
+			emit(skbegin, kbegin - 1 + k - skbegin, mhash[skmin]);
+			skbegin = kbegin;
+			skmin = window.front();
+		}
+	}
+	emit(skbegin, len - skbegin, mhash[skmin]);
+}
+
+/**
+ * @brief DiskCount: same output as SplitCount, but the inputs are read once: super-k-mers
+ * (2-bit packed) are written to minimizer bins under bpars.tmpDir, then each bin is counted
+ * independently by sorting (see SortCount), so memory is bounded by the largest bins
+ * in flight instead of by all k-mers of a split, and no input is parsed twice
+ * @param allfiles
+ * @param countsreliable_denovo
+ * @param LowerBound
+ * @param UpperBound
+ * @param bpars.kmerSize
+ * @param upperlimit
+ */
+template <typename KT, typename IT>
+void DiskCount(vector<filedata> & allfiles, CuckooDict<KT, IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
+	size_t upperlimit, BELLApars & bpars)
+{
+	size_t totreads = 0;
+	size_t totbases = 0;
+	double avesofar = 0.0;
+
+	double denovocount = omp_get_wtime();
+
+	int nbins = (bpars.SplitCount > 1) ? bpars.SplitCount : DISKCOUNT_BINS;
+	unsigned int m = std::min<unsigned int>(DISKCOUNT_MINIMIZER, bpars.kmerSize);
+
+	vector<FILE*> bins(nbins);
+	vector<std::string> binnames(nbins);
+	vector<omp_lock_t> binlocks(nbins);
+	for(int b = 0; b < nbins; ++b)
+	{
+		binnames[b] = bpars.tmpDir + "/bella_" + std::to_string(getpid()) + "_" + std::to_string(b) + ".bin";
+		if((bins[b] = fopen(binnames[b].c_str(), "wb+")) == NULL)
+		{
+			fprintf(stderr, "Could not create k-mer bin %s\n", binnames[b].c_str());
+			exit(1);
+		}
+		omp_init_lock(&binlocks[b]);
+	}
+
+	// ================================ //
+	//  Single pass: super-k-mer bins   //
+	// ================================ //
+
+	for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
+	{
+		#pragma omp parallel
+		{
+			MappedFASTQ *pfq = new MappedFASTQ();
+			pfq->open(itr->filename, false, itr->filesize);
+
+			if(MYTHREAD == 0)
+			{
+				const char* ReadingFASTQ = itr->filename;
+				printLog(ReadingFASTQ);
+			}
+
+			vector<SeqView> seqs;
+			vector<SeqView> quals;
+			vector<SeqView> nametags;
+
+			size_t tlreads = 0; // thread local reads
+			size_t tlbases = 0; // thread local bases
+			double tlave = 0.0; // thread local error rate average
+
+			vector < vector<uint8_t> > tlbins(nbins);	// thread local bin buffers
+			auto flush = [&](int b)
+			{
+				omp_set_lock(&binlocks[b]);
+				fwrite(tlbins[b].data(), 1, tlbins[b].size(), bins[b]);
+				omp_unset_lock(&binlocks[b]);
+				tlbins[b].clear();
+			};
+			const uint8_t* codes = KmerIterator<KT>::baseCodes();
+
+			size_t fillstatus = 1;
+			while(fillstatus)
+			{
+				fillstatus = pfq->fill_block(nametags, seqs, quals, upperlimit);
+				size_t nreads = seqs.size();
+
+				for(int i = 0; i < nreads; i++)
+				{
+					const char* seq = seqs[i].data();
+					int len = seqs[i].length();
+
+					// super-k-mers never span a base other than A/C/G/T
+					for(int beg = 0; beg < len; )
+					{
+						int end = beg;
+						while(end < len && codes[(unsigned char)seq[end]] < 4) ++end;
+
+						SuperKmers(seq + beg, end - beg, bpars.kmerSize, m, [&](size_t skbeg, size_t sklen, uint64_t minhash)
+						{
+							int b = minhash % nbins;
+							vector<uint8_t>& buf = tlbins[b];
+
+							// record: 32-bit length in bases, then 4 bases per byte
+							uint32_t nbases = sklen;
+							const uint8_t* nb = reinterpret_cast<const uint8_t*>(&nbases);
+							buf.insert(buf.end(), nb, nb + sizeof(nbases));
+							for(size_t j = 0; j < sklen; j += 4)
+							{
+								uint8_t packed = 0;
+								for(size_t q = j; q < j + 4; ++q)
+									packed = (packed << 2) | (q < sklen ? codes[(unsigned char)seq[beg + skbeg + q]] : 0);
+								buf.push_back(packed);
+							}
+							if(buf.size() >= DISKCOUNT_BUFFER) flush(b);
+						});
+						beg = end + 1;
+					}
+
+					if(bpars.estimateErr == true)
+					{
+						// accuracy of every base of the read
+						for(int j = 0; j < (int)quals[i].length(); j++)
+						{
+							int bqual = (int)quals[i][j] - ASCIIBASE;
+							double berror = pow(10,-(double)bqual/10);
+							tlave = getAvg(tlave, berror, tlbases++);
+						}
+					}
+				} // for(int i=0; i<nreads; i++)
+				tlreads += nreads;
+			} //while(fillstatus)
+			delete pfq;
+
+			for(int b = 0; b < nbins; ++b)
+				if(!tlbins[b].empty()) flush(b);
+
+			#pragma omp critical
+			{
+				totreads += tlreads;
+				avesofar = (avesofar * totbases + tlave * tlbases) / (totbases + tlbases);
+				totbases += tlbases;
+			}
+		} // #pragma omp parallel
+	} // for allfiles
+
+	if(bpars.estimateErr == true)
+	{
+		bpars.errorRate = avesofar;
+		printLog(bpars.errorRate);
+	}
+
+	size_t binbytes = 0;
+	for(int b = 0; b < nbins; ++b)
+	{
+		fflush(bins[b]);
+		binbytes += ftell(bins[b]);
+	}
+	std::string BinsSize = std::to_string((double)binbytes/(1024 * 1024)) + " MB";
+	printLog(BinsSize);
+
+	double load2kmers = omp_get_wtime();
+	std::string kmerBinningTime = std::to_string(load2kmers - denovocount) + " seconds";
+	printLog(kmerBinningTime);
+
+	// ================================ //
+	//  Count every bin by sorting      //
+	// ================================ //
+
+	vector < vector<KT> > reliableinbin(nbins);
+	size_t tot_kmers = 0;
+
+	#pragma omp parallel
+	{
+		vector<uint8_t> raw;
+		vector<KT> binkmers, buf;
+		string superkmer;
+
+		#pragma omp for schedule(dynamic, 1) reduction(+:tot_kmers)
+		for(int b = 0; b < nbins; ++b)
+		{
+			size_t nbytes = ftell(bins[b]);
+			raw.resize(nbytes);
+			rewind(bins[b]);
+			if(nbytes > 0 && fread(raw.data(), 1, nbytes, bins[b]) != nbytes)
+			{
+				fprintf(stderr, "Could not read k-mer bin %s\n", binnames[b].c_str());
+				exit(1);
+			}
+			fclose(bins[b]);
+			remove(binnames[b].c_str());
+
+			binkmers.clear();
+			for(size_t pos = 0; pos < nbytes; )
+			{
+				uint32_t nbases;
+				memcpy(&nbases, raw.data() + pos, sizeof(nbases));
+				pos += sizeof(nbases);
+
+				superkmer.resize(nbases);
+				for(uint32_t q = 0; q < nbases; ++q)
+					superkmer[q] = "ACGT"[(raw[pos + q/4] >> (2*(3 - q%4))) & 3];
+				pos += (nbases + 3) / 4;
+
+				KmerIterator<KT> kmers(superkmer.data(), nbases, bpars.kmerSize);
+				while(kmers.next())
+					binkmers.push_back(kmers.rep());
+			}
+			tot_kmers += binkmers.size();
+
+			if(buf.size() < binkmers.size()) buf.resize(binkmers.size());
+			KT* sorted = RadixSortKmers(binkmers.data(), buf.data(), binkmers.size());
+
+			vector<KT>& reliable = reliableinbin[b];
+			size_t n = binkmers.size();
+			for(size_t i = 0; i < n; )
+			{
+				size_t j = i + 1;
+				while(j < n && sorted[j] == sorted[i]) ++j;
+				size_t count = j - i;
+				if(count >= (size_t)LowerBound && count <= (size_t)UpperBound)
+					reliable.push_back(sorted[i]);
+				i = j;
+			}
+		}
+	}
+
+	for(int b = 0; b < nbins; ++b)
+		omp_destroy_lock(&binlocks[b]);
+
+	std::string TotalKmers = std::to_string(tot_kmers);
+	printLog(TotalKmers);
+
+	double counting = omp_get_wtime();
+	std::string kmerCountingTime = std::to_string(counting - load2kmers) + " seconds";
+	printLog(kmerCountingTime);
+
+	// ids are assigned bin after bin
+	vector<size_t> idptr(nbins + 1, 0);
+	for(int b = 0; b < nbins; ++b)
+		idptr[b+1] = idptr[b] + reliableinbin[b].size();
+
+	countsreliable_denovo.reserve(idptr[nbins]);
+	#pragma omp parallel for schedule(dynamic, 1)
+	for(int b = 0; b < nbins; ++b)
+	{
+		for(size_t i = 0; i < reliableinbin[b].size(); ++i)
+			countsreliable_denovo.insert(reliableinbin[b][i], static_cast<IT>(idptr[b] + i));
+		vector<KT>().swap(reliableinbin[b]);
+	}
+
+	// Print some information about the table
+	if (countsreliable_denovo.size() == 0)
+	{
+		std::string ErrorMessage = "BELLA terminated: 0 entries within reliable range. You may want to reduce the k-mer lenght.";
+		printLog(ErrorMessage);
+		exit(1);
+	}
+	else
+	{
+		size_t numReliableKmers = countsreliable_denovo.size();
+		printLog(numReliableKmers);
+	}
+}
+
 /**
  * @brief MinimizerCount
  * @param allfiles
@@ -687,22 +1256,22 @@ void SplitCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_den
  * @param bpars.kmerSize
  * @param upperlimit
  */
-template <typename IT>
-void MinimizerCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
+template <typename KT, typename IT>
+void MinimizerCount(vector<filedata> & allfiles, CuckooDict<KT, IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
     size_t upperlimit, BELLApars & bpars)
 {
     vector < vector<double> > allquals(MAXTHREADS);
 
     double minimizercount = omp_get_wtime();
     size_t totreads = 0;
-    dictionary_t_16bit countsdenovo;
+    dictionary_t_16bit<KT> countsdenovo;
     auto updatefn = [](unsigned short int &count) { if (count < std::numeric_limits<unsigned short int>::max()) ++count; };
 
     for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
     {
         #pragma omp parallel
         {
-            ParallelFASTQ *pfq = new ParallelFASTQ();
+            MappedFASTQ *pfq = new MappedFASTQ();
             pfq->open(itr->filename, false, itr->filesize);
 
             if(MYTHREAD == 0)
@@ -711,9 +1280,9 @@ void MinimizerCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable
                 printLog(ReadingFASTQ);
             }
 
-            vector<string> seqs;
-            vector<string> quals;
-            vector<string> nametags;
+            vector<SeqView> seqs;
+            vector<SeqView> quals;
+            vector<SeqView> nametags;
             size_t tlreads = 0; // thread local reads
 
             size_t fillstatus = 1;
@@ -726,40 +1295,27 @@ void MinimizerCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable
                 {
                     // remember that the last valid position is length()-1
                     int len = seqs[i].length();
-                    double rerror = 0.0;
 
-                    vector<Kmer> seqkmers;
-                    std::vector< int > seqminimizers;   // <position_in_read>
+                    vector<KT> seqkmers;              // canonical k-mers
+                    std::vector< int > seqminimizers;   // <index_in_seqkmers>
 
-                    for(int j = 0; j<= len - bpars.kmerSize; j++)
+                    KmerIterator<KT> kmers(seqs[i].data(), len, bpars.kmerSize);
+                    while(kmers.next())
                     {
-                        std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-                        Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-                        seqkmers.emplace_back(mykmer);
-                        
-                        if(bpars.estimateErr == true)
-                        {
-                                // accuracy
-                                int bqual = (int)quals[i][j] - ASCIIBASE;
-                                double berror = pow(10,-(double)bqual/10);
-                                rerror += berror;
-                        }
+                        seqkmers.emplace_back(kmers.rep());
                     }
                     getMinimizers(bpars.windowLen, seqkmers, seqminimizers);
 
-                    for(auto minpos: seqminimizers)
+                    for(auto minidx: seqminimizers)
                     {
-                        std::string strminkmer = seqs[i].substr(minpos, bpars.kmerSize);
-                        Kmer myminkmer(strminkmer.c_str(), strminkmer.length());
-						
-                        myminkmer = myminkmer.rep();
-                        countsdenovo.upsert(myminkmer, updatefn, 1);
+                        countsdenovo.upsert(seqkmers[minidx], updatefn, 1);
                     }
 
                     if(bpars.estimateErr == true)
                     {
-                        // remaining k qual position accuracy
-                        for(int j = len - bpars.kmerSize + 1; j < len; j++)
+                        // accuracy of every base of the read
+                        double rerror = 0.0;
+                        for(int j = 0; j < (int)quals[i].length(); j++)
                         {
                             int bqual = (int)quals[i][j] - ASCIIBASE;
                             double berror = pow(10,-(double)bqual/10);
@@ -842,22 +1398,22 @@ void MinimizerCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable
  * @param bpars.kmerSize
  * @param upperlimit
  */
-template <typename IT>
-void SyncmerCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
+template <typename KT, typename IT>
+void SyncmerCount(vector<filedata> & allfiles, CuckooDict<KT, IT> & countsreliable_denovo, int& LowerBound, int& UpperBound,
     size_t upperlimit, BELLApars & bpars)
 {
     vector < vector<double> > allquals(MAXTHREADS);
 
     double minimizercount = omp_get_wtime();
     size_t totreads = 0;
-    dictionary_t_16bit countsdenovo;
+    dictionary_t_16bit<KT> countsdenovo;
     auto updatefn = [](unsigned short int &count) { if (count < std::numeric_limits<unsigned short int>::max()) ++count; };
 
     for(auto itr=allfiles.begin(); itr!=allfiles.end(); itr++)
     {
         #pragma omp parallel
         {
-            ParallelFASTQ *pfq = new ParallelFASTQ();
+            MappedFASTQ *pfq = new MappedFASTQ();
             pfq->open(itr->filename, false, itr->filesize);
 
             if(MYTHREAD == 0)
@@ -866,9 +1422,9 @@ void SyncmerCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_d
                 printLog(ReadingFASTQ);
             }
 
-            vector<string> seqs;
-            vector<string> quals;
-            vector<string> nametags;
+            vector<SeqView> seqs;
+            vector<SeqView> quals;
+            vector<SeqView> nametags;
             size_t tlreads = 0; // thread local reads
 
             size_t fillstatus = 1;
@@ -881,39 +1437,28 @@ void SyncmerCount(vector<filedata> & allfiles, CuckooDict<IT> & countsreliable_d
                 {
                     // remember that the last valid position is length()-1
                     int len = seqs[i].length();
-                    double rerror = 0.0;
 
-                    vector<Kmer> seqkmers;
-                    std::vector< int > seqminimizers;   // <position_in_read>
+                    vector<KT> seqkmers;              // forward k-mers
+                    std::vector< int > seqminimizers;   // <index_in_seqkmers>
 
-                    for(int j = 0; j<= len - bpars.kmerSize; j++)
+                    KmerIterator<KT> kmers(seqs[i].data(), len, bpars.kmerSize);
+                    while(kmers.next())
                     {
-                        std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-                        Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-                        seqkmers.emplace_back(mykmer);
-                        
-                        if(bpars.estimateErr == true)
-                        {
-                                // accuracy
-                                int bqual = (int)quals[i][j] - ASCIIBASE;
-                                double berror = pow(10,-(double)bqual/10);
-                                rerror += berror;
-                        }
+                        seqkmers.emplace_back(kmers.forward());
                     }
 
                     getSyncmers((int)bpars.kmerSize, seqkmers, seqminimizers);
 
-                    for(auto minpos: seqminimizers)
+                    for(auto minidx: seqminimizers)
                     {
-                        std::string strminkmer = seqs[i].substr(minpos, bpars.kmerSize);
-                        Kmer myminkmer(strminkmer.c_str(), strminkmer.length());
-                        countsdenovo.upsert(myminkmer, updatefn, 1);
+                        countsdenovo.upsert(seqkmers[minidx], updatefn, 1);
                     }
 
                     if(bpars.estimateErr == true)
                     {
-                        // remaining k qual position accuracy
-                        for(int j = len - bpars.kmerSize + 1; j < len; j++)
+                        // accuracy of every base of the read
+                        double rerror = 0.0;
+                        for(int j = 0; j < (int)quals[i].length(); j++)
                         {
                             int bqual = (int)quals[i][j] - ASCIIBASE;
                             double berror = pow(10,-(double)bqual/10);
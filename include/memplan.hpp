@@ -0,0 +1,107 @@
+#ifndef _BELLA_MEMPLAN_H_
+#define _BELLA_MEMPLAN_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+/* Short description:
+ *  - What the process can still allocate, for the stage planning of HashSpGEMM (Linux only, -1 where unknown)
+ *  - Host: MemAvailable of /proc/meminfo, free memory plus what the kernel can reclaim without swapping
+ *  - Container: the limit of the memory cgroup of the process (v2 memory.max, v1 memory.limit_in_bytes)
+ *    minus its usage without the inactive page cache, i.e. the working set the OOM killer looks at
+ *  - Resident footprint of the process from /proc/self/statm, for what is already built
+ *  */
+
+#define MEMPLAN_UNLIMITED ((int64_t)1 << 60)	// cgroup v1 reports "no limit" as a huge number
+#define MEMPLAN_MINIMUM ((int64_t)64 << 20)		// never plan stages for less than this, even if nothing seems free
+
+// first number of path, -1 if it cannot be read or is not a number ("max")
+static inline int64_t readNumber(const std::string& path)
+{
+	std::ifstream in(path);
+	int64_t value;
+	if(!(in >> value)) return -1;
+	return value;
+}
+
+// value of the line "key value" of a file like /proc/meminfo or memory.stat, -1 if missing
+static inline int64_t readKey(const std::string& path, const std::string& key)
+{
+	std::ifstream in(path);
+	std::string line;
+	while(std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		std::string name;
+		int64_t value;
+		if(fields >> name >> value && (name == key || name == key + ":"))
+			return value;
+	}
+	return -1;
+}
+
+// bytes of memory the host can still give without swapping
+static inline int64_t memAvailable()
+{
+	int64_t kb = readKey("/proc/meminfo", "MemAvailable");
+	return kb < 0 ? -1 : kb * 1024;
+}
+
+// directory of the memory cgroup of this process under mount, or mount itself (inside a container
+// the cgroup namespace makes the path relative to what is mounted)
+static inline std::string cgroupDir(const std::string& mount, const std::string& limitfile, bool v2)
+{
+	std::ifstream in("/proc/self/cgroup");
+	std::string line;
+	while(std::getline(in, line))
+	{
+		// hierarchy-id:controllers:path, v2 is "0::path", v1 lists "memory" among the controllers
+		size_t c1 = line.find(':'), c2 = line.find(':', c1 + 1);
+		if(c1 == std::string::npos || c2 == std::string::npos) continue;
+		std::string controllers = line.substr(c1 + 1, c2 - c1 - 1);
+		bool match = v2 ? (line.compare(0, c1, "0") == 0 && controllers.empty()) :
+			(("," + controllers + ",").find(",memory,") != std::string::npos);
+		if(!match) continue;
+		std::string dir = mount + line.substr(c2 + 1);
+		if(access((dir + "/" + limitfile).c_str(), R_OK) == 0)
+			return dir;
+	}
+	return mount;
+}
+
+// bytes the memory cgroup of this process can still grow by, -1 if there is no limit
+static inline int64_t cgroupAvailable()
+{
+	// v2
+	std::string dir = cgroupDir("/sys/fs/cgroup", "memory.max", true);
+	int64_t limit = readNumber(dir + "/memory.max"), usage = readNumber(dir + "/memory.current");
+	int64_t inactive = readKey(dir + "/memory.stat", "inactive_file");
+	if(limit < 0)	// "max" or no v2 hierarchy
+	{
+		dir = cgroupDir("/sys/fs/cgroup/memory", "memory.limit_in_bytes", false);
+		limit = readNumber(dir + "/memory.limit_in_bytes");
+		usage = readNumber(dir + "/memory.usage_in_bytes");
+		inactive = readKey(dir + "/memory.stat", "total_inactive_file");
+	}
+	if(limit < 0 || limit >= MEMPLAN_UNLIMITED || usage < 0)
+		return -1;
+
+	int64_t workingset = usage - (inactive > 0 && inactive < usage ? inactive : 0);
+	return limit > workingset ? limit - workingset : 0;
+}
+
+// resident bytes of this process, -1 if unknown
+static inline int64_t residentMemory()
+{
+	std::ifstream in("/proc/self/statm");
+	int64_t size, resident;
+	if(!(in >> size >> resident)) return -1;
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+#endif
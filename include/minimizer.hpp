@@ -2,7 +2,7 @@
 #define _BELLA_MINIMIZER_H_
 
 #include "../kmercode/hash_funcs.h"
-#include "../kmercode/Kmer.hpp"
+#include "../kmercode/FixedKmer.hpp"
 #include <queue>
 #include <vector>
 #include <utility>
@@ -20,7 +20,8 @@ void furtherPop(std::deque< std::pair<int, uint64_t> > & deq)
     }
 }
 
-uint64_t getOrder(const Kmer & mer)
+template <typename KT>
+uint64_t getOrder(const KT & mer)
 {
     return mer.rep().hash();
 }
@@ -46,7 +47,8 @@ void furtherSample(std::deque< std::pair<int, uint64_t> > & deq, std::vector< in
 
 // this is a canonical strand minimizer
 // to avoid strand ambiguity, we advise choosing an odd number for kmer length
-void getMinimizers(size_t window, const std::vector<Kmer>& input, std::vector<int>& output)
+template <typename KT>
+void getMinimizers(size_t window, const std::vector<KT>& input, std::vector<int>& output)
 {
     std::deque<std::pair<int, uint64_t>> deq; // this double-ended queue will naturally be sorted by construction
 
@@ -0,0 +1,246 @@
+#ifndef _BELLA_MPHF_H_
+#define _BELLA_MPHF_H_
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <omp.h>
+
+#include "../kmercode/FixedKmer.hpp"
+
+/* Short description:
+ *  - Read-only copy of the reliable k-mer dictionary, built once counting is over (--mphf)
+ *  - BBHash-style minimal perfect hash: a cascade of bit arrays, a k-mer is stored at the first
+ *    level where no other k-mer hit the same bit, k-mers colliding at every level go to a small map
+ *  - The k-mer id is the rank of its bit (ids after those for the map), so there is no value array,
+ *    only a fingerprint per k-mer (FP, 32 bits by default) to reject the ones that are not in the set
+ *  - A k-mer outside the set is accepted with probability 2^-(bits of FP), a k-mer in the set is always found.
+ *    Most k-mers looked up during parsing are erroneous, 16-bit fingerprints already add spurious seeds
+ *  - findBatch() hashes a group of k-mers and prefetches their words before resolving them
+ *  */
+
+#define MPHF_GAMMA 2.0		// bits per key at each level, more bits = fewer levels and faster lookups
+#define MPHF_MAXLEVELS 16	// keys still colliding after the last level go to the fallback map
+#define MPHF_BATCH 16		// lookups in flight in findBatch()
+
+template <typename KT, typename IT, typename FP = uint32_t>
+class FrozenKmerDict {
+ public:
+	// pre: keys has no duplicates, ids are reassigned in [0, keys.size())
+	explicit FrozenKmerDict(const std::vector<KT>& keys) : nkeys(keys.size())
+	{
+		std::vector<KT> colliding;	// keys to place at the next level
+		const KT* levelkeys = keys.data();
+		size_t nlevelkeys = keys.size();
+
+		for(int l = 0; l < MPHF_MAXLEVELS && nlevelkeys > 0; ++l)
+		{
+			uint64_t nbits  = std::max<uint64_t>(64, ((uint64_t)std::ceil(MPHF_GAMMA * nlevelkeys) + 63) & ~63ULL);
+			uint64_t nwords = nbits / 64;
+
+			std::unique_ptr<std::atomic<uint64_t>[]> seen(new std::atomic<uint64_t>[nwords]);
+			std::unique_ptr<std::atomic<uint64_t>[]> collision(new std::atomic<uint64_t>[nwords]);
+
+		#pragma omp parallel for
+			for(uint64_t w = 0; w < nwords; ++w)
+			{
+				seen[w].store(0, std::memory_order_relaxed);
+				collision[w].store(0, std::memory_order_relaxed);
+			}
+
+		#pragma omp parallel for
+			for(size_t i = 0; i < nlevelkeys; ++i)
+			{
+				uint64_t p = levelPosition(levelkeys[i].hash(), l, nbits);
+				uint64_t bit = 1ULL << (p & 63);
+				if(seen[p >> 6].fetch_or(bit, std::memory_order_relaxed) & bit)
+					collision[p >> 6].fetch_or(bit, std::memory_order_relaxed);
+			}
+
+			// a bit stays set only if exactly one key hit it
+			uint64_t first = bits.size();
+			bits.resize(first + nwords);
+		#pragma omp parallel for
+			for(uint64_t w = 0; w < nwords; ++w)
+				bits[first + w] = seen[w].load(std::memory_order_relaxed) & ~collision[w].load(std::memory_order_relaxed);
+
+			levelOffset.push_back(first * 64);
+			levelBits.push_back(nbits);
+
+			std::vector<std::vector<KT>> tcolliding(omp_get_max_threads());
+		#pragma omp parallel
+			{
+				std::vector<KT>& mine = tcolliding[omp_get_thread_num()];
+			#pragma omp for nowait
+				for(size_t i = 0; i < nlevelkeys; ++i)
+				{
+					uint64_t p = levelPosition(levelkeys[i].hash(), l, nbits);
+					if(collision[p >> 6].load(std::memory_order_relaxed) & (1ULL << (p & 63)))
+						mine.push_back(levelkeys[i]);
+				}
+			}
+
+			std::vector<KT> next;
+			for(auto& v : tcolliding)
+				next.insert(next.end(), v.begin(), v.end());
+			colliding.swap(next);
+			levelkeys  = colliding.data();
+			nlevelkeys = colliding.size();
+		}
+
+		// cumulative popcount every 8 words (512 bits), the id of a key is the rank of its bit
+		ranks.resize(bits.size() / 8 + 1);
+		uint64_t sofar = 0;
+		for(size_t w = 0; w < bits.size(); ++w)
+		{
+			if(w % 8 == 0) ranks[w / 8] = sofar;
+			sofar += __builtin_popcountll(bits[w]);
+		}
+		nranked = sofar;
+
+		for(size_t i = 0; i < nlevelkeys; ++i)
+			fallback.emplace(levelkeys[i], static_cast<IT>(nranked + i));
+
+		fingerprints.resize(nranked);
+	#pragma omp parallel for
+		for(size_t i = 0; i < keys.size(); ++i)
+		{
+			uint64_t h = keys[i].hash();
+			uint64_t idx;
+			if(rankedIndex(h, 0, idx))
+				fingerprints[idx] = fingerprint(h);
+		}
+	}
+
+	// same interface as cuckoohash_map::find
+	bool find(const KT& key, IT& id) const
+	{
+		uint64_t h = key.hash();
+		uint64_t idx;
+		if(rankedIndex(h, 0, idx))
+		{
+			id = static_cast<IT>(idx);
+			return fingerprints[idx] == fingerprint(h);
+		}
+		return findFallback(key, id);
+	}
+
+	// found[i] tells whether keys[i] is in the set, and then ids[i] is its id
+	void findBatch(const KT* keys, size_t n, IT* ids, uint8_t* found) const
+	{
+		uint64_t h[MPHF_BATCH], idx[MPHF_BATCH];
+		bool ranked[MPHF_BATCH];
+
+		if(levelBits.empty())	// empty set
+		{
+			for(size_t i = 0; i < n; ++i) found[i] = false;
+			return;
+		}
+
+		for(size_t b = 0; b < n; b += MPHF_BATCH)
+		{
+			size_t m = std::min<size_t>(MPHF_BATCH, n - b);
+
+			// the first level resolves most keys: prefetch its word and rank entry
+			for(size_t i = 0; i < m; ++i)
+			{
+				h[i] = keys[b+i].hash();
+				idx[i] = levelOffset[0] + levelPosition(h[i], 0, levelBits[0]);
+				__builtin_prefetch(&bits[idx[i] >> 6]);
+				__builtin_prefetch(&ranks[idx[i] >> 9]);
+			}
+			for(size_t i = 0; i < m; ++i)
+			{
+				uint64_t p = idx[i];
+				if(bits[p >> 6] & (1ULL << (p & 63)))
+				{
+					idx[i] = rank(p);
+					ranked[i] = true;
+				}
+				else ranked[i] = rankedIndex(h[i], 1, idx[i]);
+
+				if(ranked[i]) __builtin_prefetch(&fingerprints[idx[i]]);
+			}
+			for(size_t i = 0; i < m; ++i)
+			{
+				if(ranked[i])
+				{
+					ids[b+i] = static_cast<IT>(idx[i]);
+					found[b+i] = (fingerprints[idx[i]] == fingerprint(h[i]));
+				}
+				else found[b+i] = findFallback(keys[b+i], ids[b+i]);
+			}
+		}
+	}
+
+	size_t size() const { return nkeys; }
+
+	// memory footprint in bytes
+	size_t bytes() const
+	{
+		return bits.size() * sizeof(uint64_t) + ranks.size() * sizeof(uint64_t) +
+			fingerprints.size() * sizeof(FP) + fallback.size() * (sizeof(KT) + sizeof(IT));
+	}
+
+	int numLevels() const { return levelBits.size(); }
+	size_t numFallback() const { return fallback.size(); }
+
+ private:
+	static uint64_t levelPosition(uint64_t h, int level, uint64_t nbits)
+	{
+		uint64_t lh = fmix64(h + (level + 1) * 0x9E3779B97F4A7C15ULL);
+		return (uint64_t)(((unsigned __int128)lh * nbits) >> 64);	// lh mod nbits without the division
+	}
+
+	static FP fingerprint(uint64_t h)
+	{
+		return static_cast<FP>(h >> (64 - 8 * sizeof(FP)));	// top bits, the levels use fmix64 of h
+	}
+
+	uint64_t rank(uint64_t p) const
+	{
+		uint64_t r = ranks[p >> 9];
+		for(uint64_t w = (p >> 9) * 8; w < (p >> 6); ++w)
+			r += __builtin_popcountll(bits[w]);
+		return r + __builtin_popcountll(bits[p >> 6] & ((1ULL << (p & 63)) - 1));
+	}
+
+	// id of the first set bit hit by h at levels >= level, false if there is none
+	bool rankedIndex(uint64_t h, int level, uint64_t& idx) const
+	{
+		for(int l = level; l < (int)levelBits.size(); ++l)
+		{
+			uint64_t p = levelOffset[l] + levelPosition(h, l, levelBits[l]);
+			if(bits[p >> 6] & (1ULL << (p & 63)))
+			{
+				idx = rank(p);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool findFallback(const KT& key, IT& id) const
+	{
+		if(fallback.empty()) return false;
+		auto it = fallback.find(key);
+		if(it == fallback.end()) return false;
+		id = it->second;
+		return true;
+	}
+
+	size_t nkeys;
+	uint64_t nranked;						// keys placed in the levels, the others are in fallback
+	std::vector<uint64_t> bits;				// all levels, each one starts on a word boundary
+	std::vector<uint64_t> ranks;			// number of set bits before every 512-bit block
+	std::vector<uint64_t> levelOffset;		// first bit of each level
+	std::vector<uint64_t> levelBits;		// size of each level
+	std::vector<FP> fingerprints;			// indexed by id
+	std::unordered_map<KT, IT> fallback;
+};
+
+#endif
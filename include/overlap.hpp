@@ -1,5 +1,9 @@
 #include "common/CSC.h"
 #include "align.hpp"
+#include "readstore.hpp"
+#include "stagequeue.hpp"
+#include "memplan.hpp"
+#include "chain.hpp"
 #include "common/common.h"
 #include "../kmercode/hash_funcs.h"
 #include "../kmercode/Kmer.hpp"
@@ -17,12 +21,19 @@
 #include <seqan/modifier.h>
 #include <seqan/seeds.h>
 #include <omp.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <cstdlib>
 #include <algorithm>
+#include <limits>
+#include <memory>
+#include <atomic>
+#include <thread>
 #include <ctype.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -60,6 +71,12 @@ typedef Seed<Simple>  TSeed;
 typedef SeedSet<TSeed> TSeedSet;
 
 #define PERCORECACHE (1024 * 1024)
+#define UNITSPERTHREAD 16	// alignment work units per thread (dynamic scheduling granularity)
+#define ESC_MAXCOMPRESSION 2.0	// stages with fewer flops per nonzero of C than this use the ESC kernel, the others hashing
+#define ESC_INSERTIONSORT 32	// ESC ranges with fewer products are sorted by insertion
+#define PIPELINE_DEPTH 2		// stages of C alive at once in HashSpGEMM: one aligned while the next one is formed
+#define TEXTPERNONZERO 64		// output bytes per nonzero of C assumed until a stage has been aligned
+#define XDROP_BATCHPAIRS 256	// pairs decoded and extended together by BatchAlignUnit (--batch-xdrop)
 #define TIMESTEP
 
 #ifndef PRINT
@@ -69,7 +86,6 @@ typedef SeedSet<TSeed> TSeedSet;
 //#define THREADLIMIT
 //#define MAX_NUM_THREAD 1
 //#define OSX
-//#define LINUX
 
 #ifndef __SIMD__
 #define __SIMD__
@@ -83,12 +99,6 @@ typedef SeedSet<TSeed> TSeedSet;
 #include <mach/mach_host.h>
 #endif
 
-#ifdef LINUX
-#include "sys/types.h"
-#include "sys/sysinfo.h"
-struct sysinfo info;
-#endif
-
 double safety_net = 1.5;
 
 /*
@@ -153,16 +163,17 @@ void toOriginalCoordinates(int& begpH, int& endpH, const int lenH)
 	endpH = lenH-tmp;
 }
 
-// estimate the number of floating point operations of SpGEMM
-template <typename IT, typename NT>
-IT* estimateFLOP(const CSC<IT,NT> & A, const CSC<IT,NT> & B, bool lowtriout)
+// estimate the number of floating point operations of SpGEMM, per column of C. They are counted in 64 bits whatever IT is:
+// the flops (and the nonzeros) of C can outgrow the nonzeros of A and B by far, so do the counters of C built on them
+template <typename IT, typename NTA, typename NTB>
+uint64_t* estimateFLOP(const CSC<IT,NTA> & A, const CSC<IT,NTB> & B, bool lowtriout)
 {
 	if(A.isEmpty() || B.isEmpty())
 	{
 		return NULL;
 	}
 		
-	IT* colflopC = new IT[B.cols]; // nnz in every  column of C
+	uint64_t* colflopC = new uint64_t[B.cols]; // nnz in every  column of C
 		
 	#pragma omp parallel for
 	for(IT i=0; i< B.cols; ++i)
@@ -174,7 +185,7 @@ IT* estimateFLOP(const CSC<IT,NT> & A, const CSC<IT,NT> & B, bool lowtriout)
 		for(IT i=0; i < B.cols; ++i)
 			{
 			// size_t nnzcolB = B.colptr[i+1] - B.colptr[i]; // nnz in the current column of B
-			int myThread = omp_get_thread_num();
+			uint64_t colflops = 0;
 			for (IT j = B.colptr[i]; j < B.colptr[i+1]; ++j)	// all nonzeros in that column of B
 			{
 				IT col2fetch = B.rowids[j];	// find the row index of that nonzero in B, which is the column to fetch in A
@@ -195,22 +206,85 @@ IT* estimateFLOP(const CSC<IT,NT> & A, const CSC<IT,NT> & B, bool lowtriout)
 				{
 					nnzcolA =  A.colptr[col2fetch+1]- A.colptr[col2fetch]; // nonzero count of that column of A
 				}
-				colflopC[i] += nnzcolA;
+				colflops += nnzcolA;
 			}
+			colflopC[i] = colflops;
 		}
 		return colflopC;
 }
 
+/*
+ Column ranges of [start, end) with about the same flops each, from the prefix sum of the flops (flopptr[i] = flops of columns
+ before i): a few columns of repetitive reads can carry most of the flops, equal numbers of columns would leave threads idle.
+ A column is never split, one heavier than a range is a range by itself
+ */
+template <typename IT>
+std::vector<IT> flopPartition(const uint64_t* flopptr, IT start, IT end, int parts)
+{
+	std::vector<IT> bounds;
+	bounds.push_back(start);
+	uint64_t first = flopptr[start];
+	uint64_t flops = flopptr[end] - first;
+	for(int p = 1; p < parts; ++p)
+	{
+		uint64_t target = first + (flops * p) / parts;
+		IT col = std::upper_bound(flopptr + start, flopptr + end, target) - flopptr;	// first column starting past the target
+		if(col > bounds.back() && col < end)
+			bounds.push_back(col);
+	}
+	bounds.push_back(end);
+	return bounds;
+}
+
+/*
+ Linear probing in a table of keys (size a power of two, empty slots hold -1): the slot holding key,
+ or the first empty slot from hash on if key is not there yet
+ */
+template <typename IT>
+inline size_t probeSlot(const IT* keys, size_t ht_size, IT key, size_t hash)
+{
+	while(keys[hash] != key && keys[hash] != (IT) -1)
+	{
+		hash = (hash+1) & (ht_size-1);
+	}
+	return hash;
+}
+
+#ifdef __AVX2__
+// 8 slots compared at once, the slot found is the same as probing one at a time
+template <>
+inline size_t probeSlot<uint32_t>(const uint32_t* keys, size_t ht_size, uint32_t key, size_t hash)
+{
+	const __m256i vkey   = _mm256_set1_epi32(key);
+	const __m256i vempty = _mm256_set1_epi32(-1);
+	for(; hash + 8 <= ht_size; hash += 8)
+	{
+		__m256i slots = _mm256_loadu_si256((const __m256i*)(keys + hash));
+		__m256i hit = _mm256_or_si256(_mm256_cmpeq_epi32(slots, vkey), _mm256_cmpeq_epi32(slots, vempty));
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+		if(mask)
+			return hash + __builtin_ctz(mask);
+	}
+	// the last slots of the table, then around from the first one
+	hash &= ht_size-1;
+	while(keys[hash] != key && keys[hash] != (uint32_t) -1)
+	{
+		hash = (hash+1) & (ht_size-1);
+	}
+	return hash;
+}
+#endif
+
 // estimate space for result of SpGEMM with Hash
-template <typename IT, typename NT>
-IT* estimateNNZ_Hash(const CSC<IT,NT>& A, const CSC<IT,NT>& B, const IT* flopC, bool lowtriout)
+template <typename IT, typename NTA, typename NTB>
+uint64_t* estimateNNZ_Hash(const CSC<IT,NTA>& A, const CSC<IT,NTB>& B, const uint64_t* flopC, const uint64_t* flopptr, bool lowtriout)
 {
 	if(A.isEmpty() || B.isEmpty())
 	{
 		return NULL;
 	}
 
-	IT* colnnzC = new IT[B.cols]; // nnz in every  column of C
+	uint64_t* colnnzC = new uint64_t[B.cols]; // nnz in every  column of C
 
 #pragma omp parallel for
 	for(IT i=0; i< B.cols; ++i)
@@ -218,55 +292,48 @@ IT* estimateNNZ_Hash(const CSC<IT,NT>& A, const CSC<IT,NT>& B, const IT* flopC,
 		colnnzC[i] = 0;
 	}
 
-#pragma omp parallel for
-	for(IT i=0; i < B.cols; ++i)	// for each column of B
+	int numThreads = 1;
+#pragma omp parallel
+	{
+		numThreads = omp_get_num_threads();
+	}
+	std::vector<IT> parts = flopPartition(flopptr, (IT) 0, B.cols, numThreads * UNITSPERTHREAD);
+
+#pragma omp parallel
 	{
-		// size_t nnzcolB = B.colptr[i+1] - B.colptr[i]; //nnz in the current column of B
-		int myThread = omp_get_thread_num();
-			
-		// Hash
 		const unsigned int minHashTableSize = 16;
 		const unsigned int hashScale = 107;
+		std::vector<IT> globalHashVec;	// reused by all the columns of the thread, it only grows
 
-		// Initialize hash tables
-		size_t ht_size = minHashTableSize;
-		while(ht_size < flopC[i]) //ht_size is set as 2^n
+	#pragma omp for schedule(dynamic)
+		for(size_t p = 0; p < parts.size()-1; ++p)
+		for(IT i = parts[p]; i < parts[p+1]; ++i)	// for each column of B
 		{
-			ht_size <<= 1;
-		}
-		std::vector<IT> globalHashVec(ht_size);
-
-		for(size_t j=0; j < ht_size; ++j)
-		{
-			globalHashVec[j] = -1;
-		}
+			// Initialize hash tables
+			size_t ht_size = minHashTableSize;
+			while(ht_size < flopC[i]) //ht_size is set as 2^n
+			{
+				ht_size <<= 1;
+			}
+			if(globalHashVec.size() < ht_size)
+				globalHashVec.resize(ht_size);
+			std::fill(globalHashVec.begin(), globalHashVec.begin() + ht_size, (IT) -1);
 
-		for (IT j = B.colptr[i]; j < B.colptr[i+1]; ++j)	// all nonzeros in that column of B
-		{
-			IT col2fetch = B.rowids[j];	// find the row index of that nonzero in B, which is the column to fetch in A
-			for(IT k = A.colptr[col2fetch]; k < A.colptr[col2fetch+1]; ++k)	// all nonzeros in this column of A
+			for (IT j = B.colptr[i]; j < B.colptr[i+1]; ++j)	// all nonzeros in that column of B
 			{
-				IT key = A.rowids[k];
+				IT col2fetch = B.rowids[j];	// find the row index of that nonzero in B, which is the column to fetch in A
+				for(IT k = A.colptr[col2fetch]; k < A.colptr[col2fetch+1]; ++k)	// all nonzeros in this column of A
+				{
+					IT key = A.rowids[k];
 
-				if(lowtriout && i >= key)	// i is the column_id of the output and key is the row_id of the output
-					continue;
+					if(lowtriout && i >= key)	// i is the column_id of the output and key is the row_id of the output
+						continue;
 
-				IT hash = (key*hashScale) & (ht_size-1);
-				while (1) //hash probing
-				{
-					if (globalHashVec[hash] == key) //key is found in hash table
-					{
-						break;
-					}
-					else if (globalHashVec[hash] == -1) //key is not registered yet
+					size_t hash = probeSlot(globalHashVec.data(), ht_size, key, (key*hashScale) & (ht_size-1));
+					if (globalHashVec[hash] == (IT) -1) //key is not registered yet
 					{
 						globalHashVec[hash] = key;
 						colnnzC[i] ++;
-						break;
-					}
-					else //key is not found
-					{
-						hash = (hash+1) & (ht_size-1);	// don't exit the while loop yet
 					}
 				}
 			}
@@ -278,96 +345,256 @@ IT* estimateNNZ_Hash(const CSC<IT,NT>& A, const CSC<IT,NT>& B, const IT* flopC,
 //! Hash based column-by-column spgemm algorithm. Based on earlier code by Buluc, Azad, and Nagasaka
 //! If lowtriout= true, then only creates the lower triangular part: no diagonal and no upper triangular
 //! input matrices do not need to have sorted rowids within each column
-template <typename IT, typename NT, typename MultiplyOperation, typename AddOperation, typename FT>
-void LocalSpGEMM(IT & start, IT & end, const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation multop, AddOperation addop,
-		vector<IT> * RowIdsofC, vector<FT> * ValuesofC, IT* colptrC, bool lowtriout)
+//! columns are handed out in ranges of equal flops (flopptr is the prefix sum of the flops of the columns of C),
+//! and each thread keeps its hash table (keys and values apart, so that keys can be probed with SIMD) from column to column
+template <typename IT, typename NTA, typename NTB, typename MultiplyOperation, typename AddOperation, typename FT>
+void LocalSpGEMM(IT & start, IT & end, const CSC<IT,NTA> & A, const CSC<IT,NTB> & B, MultiplyOperation multop, AddOperation addop,
+		vector<IT> * RowIdsofC, vector<FT> * ValuesofC, const uint64_t* colptrC, const uint64_t* flopptr, bool lowtriout)
 {
+	int numThreads = 1;
+#pragma omp parallel
+	{
+		numThreads = omp_get_num_threads();
+	}
+	std::vector<IT> parts = flopPartition(flopptr, start, end, numThreads * UNITSPERTHREAD);
 
-#pragma omp parallel for
-	for(IT i = start; i < end; ++i)	// for bcols of B (one block)
+#pragma omp parallel
 	{
 		const IT minHashTableSize = 16;
 		const IT hashScale = 107;
-		size_t nnzcolC = colptrC[i+1] - colptrC[i];	//nnz in the current column of C (=Output)
+		std::vector<IT> hashKeys;	// reused by all the columns of the thread, they only grow
+		std::vector<FT> hashValues;
 
-		IT ht_size = minHashTableSize;
-		while(ht_size < nnzcolC)	//ht_size is set as 2^n
+	#pragma omp for schedule(dynamic)
+		for(size_t p = 0; p < parts.size()-1; ++p)
+		for(IT i = parts[p]; i < parts[p+1]; ++i)	// for bcols of B (one range of equal flops)
 		{
-			ht_size <<= 1;
-		}
-		std::vector< std::pair<IT,FT>> globalHashVec(ht_size);
+			size_t nnzcolC = colptrC[i+1] - colptrC[i];	//nnz in the current column of C (=Output)
 
-		//	Initialize hash tables
-		for(IT j=0; j < ht_size; ++j)
-		{
-			globalHashVec[j].first = -1;
-		}
+			size_t ht_size = minHashTableSize;
+			while(ht_size < nnzcolC)	//ht_size is set as 2^n
+			{
+				ht_size <<= 1;
+			}
+			if(hashKeys.size() < ht_size)
+			{
+				hashKeys.resize(ht_size);
+				hashValues.resize(ht_size);
+			}
 
-		for (IT j = B.colptr[i]; j < B.colptr[i+1]; ++j)	// all nonzeros in that column of B
-		{
-			IT col2fetch = B.rowids[j];	// find the row index of that nonzero in B, which is the column to fetch in A
-			NT valueofB = B.values[j];
-			for(IT k = A.colptr[col2fetch]; k < A.colptr[col2fetch+1]; ++k) // all nonzeros in this column of A
+			//	Initialize hash tables
+			std::fill(hashKeys.begin(), hashKeys.begin() + ht_size, (IT) -1);
+
+			for (IT j = B.colptr[i]; j < B.colptr[i+1]; ++j)	// all nonzeros in that column of B
 			{
-				IT key = A.rowids[k];
+				IT col2fetch = B.rowids[j];	// find the row index of that nonzero in B, which is the column to fetch in A
+				NTB valueofB = B.values[j];
+				for(IT k = A.colptr[col2fetch]; k < A.colptr[col2fetch+1]; ++k) // all nonzeros in this column of A
+				{
+					IT key = A.rowids[k];
 
-				//	i is the column_id of the output and key is the row_id of the output
-				if(lowtriout && i >= key)
-					continue;
+					//	i is the column_id of the output and key is the row_id of the output
+					if(lowtriout && i >= key)
+						continue;
 
-				//	GG: modified to get read ids needed to compute alnlenerlap length
-				FT result =  multop(A.values[k], valueofB, key, i);
+					//	GG: modified to get read ids needed to compute alnlenerlap length
+					FT result =  multop(A.values[k], valueofB, key, i);
 
-				IT hash = (key*hashScale) & (ht_size-1);
-				while (1) //hash probing
-				{
-					if (globalHashVec[hash].first == key) //key is found in hash table
+					size_t hash = probeSlot(hashKeys.data(), ht_size, key, (key*hashScale) & (ht_size-1));
+					if (hashKeys[hash] == key) //key is found in hash table
 					{	//	GG: addop temporary modify, remalnlene key, i after testing
-						globalHashVec[hash].second = addop(result, globalHashVec[hash].second); //, key, i);
-						break;
+						hashValues[hash] = addop(result, hashValues[hash]); //, key, i);
 					}
-					else if (globalHashVec[hash].first == -1) //key is not registered yet
+					else //key is not registered yet
 					{
-						globalHashVec[hash].first = key;
-						globalHashVec[hash].second = result;
-						break;
-					}
-					else //key is not found
-					{
-					hash = (hash+1) & (ht_size-1);	// don't exit the while loop yet
+						hashKeys[hash] = key;
+						hashValues[hash] = result;
 					}
 				}
 			}
+			// gather non-zero elements from hash table (and then sort them by row indices if needed)
+			vector<IT> & rowsC = RowIdsofC[i-start];
+			vector<FT> & valuesC = ValuesofC[i-start];
+			rowsC.reserve(nnzcolC);
+			valuesC.reserve(nnzcolC);
+		#ifdef SORTCOLS
+			std::vector< std::pair<IT,FT>> sorted;
+			for (size_t j=0; j < ht_size; ++j)
+			{
+				if (hashKeys[j] != (IT) -1)
+					sorted.push_back(std::make_pair(hashKeys[j], hashValues[j]));
+			}
+			std::sort(sorted.begin(), sorted.end(), sort_less<IT, FT>);
+			for (auto & entry : sorted)
+			{
+				rowsC.push_back(entry.first);
+				valuesC.push_back(entry.second);
+			}
+		#else
+			for (size_t j=0; j < ht_size; ++j)
+			{
+				if (hashKeys[j] != (IT) -1)
+				{
+					rowsC.push_back(hashKeys[j]);
+					valuesC.push_back(hashValues[j]);
+				}
+			}
+		#endif
 		}
-		// gather non-zero elements from hash table (and then sort them by row indices if needed)
-		IT index = 0;
-		for (IT j=0; j < ht_size; ++j)
+	}
+}
+
+/*
+ Stable LSD radix sort of keys[0, n) on their low bits (8 per pass), perm[i] ends up as the position before the sort
+ of the i-th smallest key. tmpkeys and tmpperm are work space of the same size. Short arrays use insertion sort
+ */
+inline void radixSortKeys(uint64_t* keys, size_t* perm, uint64_t* tmpkeys, size_t* tmpperm, size_t n, int bits)
+{
+	for(size_t i = 0; i < n; ++i)
+		perm[i] = i;
+
+	if(n <= ESC_INSERTIONSORT)
+	{
+		for(size_t i = 1; i < n; ++i)
 		{
-			if (globalHashVec[j].first != -1)
+			uint64_t key = keys[i];
+			size_t j = i;
+			for(; j > 0 && keys[j-1] > key; --j)
 			{
-				globalHashVec[index++] = globalHashVec[j];
+				keys[j] = keys[j-1];
+				perm[j] = perm[j-1];
 			}
+			keys[j] = key;
+			perm[j] = i;
 		}
-	#ifdef SORTCOLS
-		std::sort(globalHashVec.begin(), globalHashVec.begin() + index, sort_less<IT, NT>);
-	#endif
-		RowIdsofC[i-start].resize(index); 
-		ValuesofC[i-start].resize(index);
+		return;
+	}
 
-		for (IT j=0; j< index; ++j)
+	for(int shift = 0; shift < bits; shift += 8)
+	{
+		size_t count[257] = {0};
+		for(size_t i = 0; i < n; ++i)
+			count[((keys[i] >> shift) & 0xff) + 1]++;
+		if(count[((keys[0] >> shift) & 0xff) + 1] == n)	// all the keys have the same digit
+			continue;
+		for(int d = 0; d < 256; ++d)
+			count[d+1] += count[d];
+		for(size_t i = 0; i < n; ++i)
 		{
-			RowIdsofC[i-start][j] = globalHashVec[j].first;
-			ValuesofC[i-start][j] = globalHashVec[j].second;
+			size_t to = count[(keys[i] >> shift) & 0xff]++;
+			tmpkeys[to] = keys[i];
+			tmpperm[to] = perm[i];
 		}
+		std::copy(tmpkeys, tmpkeys + n, keys);
+		std::copy(tmpperm, tmpperm + n, perm);
 	}
 }
 
+//! Expand-sort-compress version of LocalSpGEMM, same interface and same values: for a range of columns of equal flops,
+//! every product is written out with the key (column, row), the keys are radix sorted (stable, so the products of a row keep
+//! the order in which the hash version meets them) and the runs of equal keys are added up with addop.
+//! No probing: better when most products make their own nonzero (low flops/nnz). Rows come out sorted within each column
+template <typename IT, typename NTA, typename NTB, typename MultiplyOperation, typename AddOperation, typename FT>
+void LocalSpGEMM_ESC(IT & start, IT & end, const CSC<IT,NTA> & A, const CSC<IT,NTB> & B, MultiplyOperation multop, AddOperation addop,
+		vector<IT> * RowIdsofC, vector<FT> * ValuesofC, const uint64_t* flopptr, bool lowtriout)
+{
+	int numThreads = 1;
+#pragma omp parallel
+	{
+		numThreads = omp_get_num_threads();
+	}
+	std::vector<IT> parts = flopPartition(flopptr, start, end, numThreads * UNITSPERTHREAD);
+
+	int rowbits = 1;
+	while(rowbits < 64 && ((uint64_t)A.rows >> rowbits) != 0)
+		++rowbits;
+	const uint64_t rowmask = (rowbits == 64) ? ~0ULL : ((1ULL << rowbits) - 1);
+
+#pragma omp parallel
+	{
+		std::vector<uint64_t> keys, tmpkeys;	// reused by all the ranges of the thread, they only grow
+		std::vector<size_t> perm, tmpperm;
+		std::vector<FT> products;
+
+	#pragma omp for schedule(dynamic)
+		for(size_t p = 0; p < parts.size()-1; ++p)
+		{
+			IT first = parts[p], last = parts[p+1];
+			size_t flops = flopptr[last] - flopptr[first];
+			if(keys.size() < flops)
+			{
+				keys.resize(flops);
+				tmpkeys.resize(flops);
+				perm.resize(flops);
+				tmpperm.resize(flops);
+				products.resize(flops);
+			}
+
+			int colbits = 0;
+			while(((uint64_t)(last - 1 - first) >> colbits) != 0)
+				++colbits;
+			if(rowbits + colbits > 64)
+			{
+				fprintf(stderr, "Too many rows and columns for the keys of the ESC kernel\n");
+				exit(1);
+			}
+
+			// expand
+			size_t n = 0;
+			for(IT i = first; i < last; ++i)
+			{
+				for (IT j = B.colptr[i]; j < B.colptr[i+1]; ++j)	// all nonzeros in that column of B
+				{
+					IT col2fetch = B.rowids[j];
+					NTB valueofB = B.values[j];
+					for(IT k = A.colptr[col2fetch]; k < A.colptr[col2fetch+1]; ++k) // all nonzeros in this column of A
+					{
+						IT key = A.rowids[k];
+						if(lowtriout && i >= key)
+							continue;
+						keys[n] = ((uint64_t)(i - first) << rowbits) | (uint64_t)key;
+						products[n] = multop(A.values[k], valueofB, key, i);
+						++n;
+					}
+				}
+			}
+
+			// sort
+			radixSortKeys(keys.data(), perm.data(), tmpkeys.data(), tmpperm.data(), n, rowbits + colbits);
+
+			// compress
+			for(size_t x = 0; x < n; )
+			{
+				uint64_t key = keys[x];
+				IT i = first + (IT)(key >> rowbits);
+				FT value = products[perm[x]];
+				for(++x; x < n && keys[x] == key; ++x)
+					value = addop(products[perm[x]], value);
+
+				RowIdsofC[i-start].push_back((IT)(key & rowmask));
+				ValuesofC[i-start].push_back(value);
+			}
+		}
+	}
+}
+
+/*
+ Memory left for the output of HashSpGEMM, in bytes. -m is the whole RAM BELLA can use, so what is
+ resident already (reads, k-mer matrices) is taken out of it. Otherwise, on Linux, the smallest of what
+ the host (MemAvailable) and the memory cgroup of the process (container limit) can still give, both
+ measured now, so they already leave out what is built. BELLA's default (-m) when nothing can be measured
+ */
 double estimateMemory(const BELLApars & bpars)
 {
 	double free_memory;
+	int64_t resident = residentMemory();
+
+	std::string ResidentMemory = std::to_string((double)resident / (1024 * 1024)) + " MB";
+	printLog(ResidentMemory);
+
 	if (bpars.userDefMem)
 	{
-		free_memory = bpars.totalMemory * 1024 * 1024;
+		free_memory = (double)bpars.totalMemory * 1024 * 1024 - std::max<int64_t>(resident, 0);
 	}
 	else
 	{
@@ -388,19 +615,27 @@ double estimateMemory(const BELLApars & bpars)
 	{
 		free_memory = (double) vm_stats.free_count * (double)page_size;
 	} 
-#elif defined (LINUX) // LINUX-based memory consumption implementation 
-	if(sysinfo(&info) != 0)
-	{
-		return false;
-	}   
-	free_memory = info.freeram * info.mem_unit;
-	free_memory += info.freeswap * info.mem_unit;
-	free_memory += info.bufferram * info.mem_unit;
+#elif defined (__linux__) // LINUX-based memory consumption implementation 
+	int64_t host = memAvailable();
+	int64_t container = cgroupAvailable();
+
+	std::string HostAvailable = (host < 0) ? "unknown" : std::to_string((double)host / (1024 * 1024)) + " MB";
+	printLog(HostAvailable);
+	std::string CgroupAvailable = (container < 0) ? "no limit" : std::to_string((double)container / (1024 * 1024)) + " MB";
+	printLog(CgroupAvailable);
+
+	if(host < 0 && container < 0)
+		free_memory = (double)bpars.totalMemory * 1024 * 1024 - std::max<int64_t>(resident, 0);
+	else if(host < 0 || container < 0)
+		free_memory = std::max(host, container);
+	else
+		free_memory = std::min(host, container);
 #else
-	free_memory = bpars.totalMemory * 1024 * 1024;	// memory is neither user-supplied nor can be estimated, so use BELLA's default
+	free_memory = (double)bpars.totalMemory * 1024 * 1024 - std::max<int64_t>(resident, 0);	// memory is neither user-supplied nor can be estimated, so use BELLA's default
 #endif
 	}
-	return free_memory;
+	// nothing left: go on with small stages rather than none
+	return std::max(free_memory, (double)MEMPLAN_MINIMUM);
 }
 
 #ifndef __NVCC__
@@ -414,7 +649,7 @@ void PostAlignDecision(const xavierResult& maxExtScore,
 #else
 void PostAlignDecision(const seqAnResult& maxExtScore, 
 #endif
-	const readType_& read1, const readType_& read2, 
+	const ReadStore& reads, size_t rid, const ReadStore& refreads, size_t cid, 
 			const BELLApars& bpars, double ratiophi, int count, stringstream& myBatch, size_t& outputted,
 					size_t& numBasesAlignedTrue, size_t& numBasesAlignedFalse, bool& passed) //, int const& matches)
 {
@@ -434,27 +669,25 @@ void PostAlignDecision(const seqAnResult& maxExtScore,
 	int endpH = endPositionH(maxseed);
 #endif
 
-	// Get references for better naming
-	const string& seq1 = read1.seq;	// H
-	const string& seq2 = read2.seq;	// Vzw
+	int read1len = reads.length(rid);		// H
+	int read2len = refreads.length(cid);	// Vzw
 
-	unsigned short int read1len = seq1.length();
-	unsigned short int read2len = seq2.length();
+	int overlapLenV = endpV - begpV;
+	int overlapLenH = endpH - begpH;
 
-	unsigned short int overlapLenV = endpV - begpV;
-	unsigned short int overlapLenH = endpH - begpH;
+	int minLeft  = min(begpV, begpH);
+	int minRight = min(read2len - endpV, read1len - endpH);
+	int ov       = minLeft + minRight + (overlapLenV + overlapLenH) / 2;
 
-	unsigned short int minLeft  = min(begpV, begpH);
-	unsigned short int minRight = min(read2len - endpV, read1len - endpH);
-	unsigned short int ov       = minLeft + minRight + (overlapLenV + overlapLenH) / 2;
-
-	unsigned short int normLen  = max(overlapLenV, overlapLenH);
-	unsigned short int minLen   = min(overlapLenV, overlapLenH);
+	int normLen  = max(overlapLenV, overlapLenH);
+	int minLen   = min(overlapLenV, overlapLenH);
 
 	if(bpars.fixedThreshold == -1)
 	{
+		// an overlap spans at least one base: ov <= 0 only comes from an alignment that ends before it starts,
+		// its threshold would be 0 or negative and let any score through
 		float mythreshold = (1 - bpars.deltaChernoff) * (ratiophi * (float)ov);
-		if((float)maxExtScore.score >= mythreshold)
+		if(ov > 0 && (float)maxExtScore.score >= mythreshold)
 		{
 			passed = true;
 		}
@@ -469,7 +702,7 @@ void PostAlignDecision(const seqAnResult& maxExtScore,
 	{
 		if(!bpars.outputPaf)		// BELLA output format
 		{
-			myBatch << read2.nametag << '\t' << read1.nametag << '\t' << count << '\t' << maxExtScore.score << '\t' << ov << '\t' << maxExtScore.strand << '\t' << 
+			myBatch << refreads.name(cid) << '\t' << reads.name(rid) << '\t' << count << '\t' << maxExtScore.score << '\t' << ov << '\t' << maxExtScore.strand << '\t' << 
 				begpV << '\t' << endpV << '\t' << read2len << '\t' << begpH << '\t' << endpH << '\t' << read1len << endl;
 		}
 		else
@@ -484,8 +717,8 @@ void PostAlignDecision(const seqAnResult& maxExtScore,
 				toOriginalCoordinates(begpH, endpH, read1len);
 
 			// PAF format is the output format used by minimap/minimap2: https://github.com/lh3/miniasm/blob/master/PAF.md
-			myBatch << read2.nametag << '\t' << read2len << '\t' << begpV << '\t' << endpV << '\t' << pafstrand << '\t' << 
-				read1.nametag << '\t' << read1len << '\t' << begpH << '\t' << endpH << '\t' << maxExtScore.score << '\t' << ov << '\t' << mapq << endl;
+			myBatch << refreads.name(cid) << '\t' << read2len << '\t' << begpV << '\t' << endpV << '\t' << pafstrand << '\t' << 
+				reads.name(rid) << '\t' << read1len << '\t' << begpH << '\t' << endpH << '\t' << maxExtScore.score << '\t' << ov << '\t' << mapq << endl;
 		}
 		++outputted;
 		numBasesAlignedTrue += (endpV-begpV);
@@ -496,63 +729,352 @@ void PostAlignDecision(const seqAnResult& maxExtScore,
 	}
 }
 
-template <typename IT, typename FT>
-auto RunPairWiseAlignments(IT start, IT end, IT offset, IT * colptrC, IT * rowids, FT * values, const readVector_& reads, const readVector_& refreads,
-	char* filename, const BELLApars& bpars, const double& ratiophi)
-{
+/*
+ Per-thread alignment counters, aligned to a cache line so that threads
+ updating their own entry do not false-share; reduced once after the loop
+ */
+struct alignas(64) alignStats_ {
 	size_t alignedpairs = 0;
 	size_t alignedbases = 0;
 	size_t totalreadlen = 0;
-	size_t totaloutputt = 0;
-	size_t totsuccbases = 0;
-	size_t totfailbases = 0;
+	size_t outputted    = 0;
+	size_t succbases    = 0;
+	size_t failbases    = 0;
+};
+
+/*
+ Rejected candidates per reason, see FilterCandidates
+ */
+struct filterStats_ {
+	size_t fewshared    = 0;	// fewer than minShared k-mers
+	size_t fewsupport   = 0;	// fewer than minSupport k-mers on the best diagonal bin
+	size_t shortoverlap = 0;	// estimated overlap shorter than minOverlap
+	size_t qgram        = 0;	// fewer k-mers on the best bin than the q-gram lemma requires
+};
+
+/*
+ Pre-alignment filter of the nonzeros of columns [start, end) of C, rowids and values hold
+ [colptrC[start], colptrC[end]). A pair is dropped if it shares too few k-mers, if its best diagonal
+ bin has too few of them, if the overlap estimated from its seed is too short, or (useQgram) if the
+ bin has fewer k-mers than an overlap of that length shares at the error rate by the q-gram lemma.
+ With the defaults nothing is checked
+
+ Output:
+	rowids and values compacted in place, colptr[j-start] is the first kept nonzero of column j
+	(colptr has end-start+1 entries, colptr[0] = 0)
+ */
+template <typename IT, typename FT>
+filterStats_ FilterCandidates(IT start, IT end, const uint64_t * colptrC, IT * rowids, FT * values, IT * colptr,
+	const ReadStore& reads, const ReadStore& refreads, const BELLApars& bpars)
+{
+	filterStats_ rejected;
+	uint64_t begnz = colptrC[start];
+	colptr[0] = 0;
+
+	bool active = (bpars.minShared > 1 || bpars.minSupport > 1 || bpars.minOverlap > 0 || bpars.useQgram);
+	if(!active)
+	{
+		for(IT j = start; j < end; ++j)
+			colptr[j-start+1] = colptrC[j+1] - begnz;
+		return rejected;
+	}
+
+	// pairs of two reads with errorRate each differ by about this fraction of their bases
+	double divergence = 1.0 - (1.0 - bpars.errorRate) * (1.0 - bpars.errorRate);
+	size_t fewshared = 0, fewsupport = 0, shortoverlap = 0, qgram = 0;
+
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:fewshared,fewsupport,shortoverlap,qgram)
+	for(IT j = start; j < end; ++j)
+	{
+		int seq2len = refreads.length(j);
+		IT kept = colptrC[j] - begnz;	// compacted within the column first
+		for(IT i = colptrC[j] - begnz; i < colptrC[j+1] - begnz; ++i)
+		{
+			const FT& val = values[i];
+			if(val.count < bpars.minShared)
+			{
+				fewshared++;
+				continue;
+			}
+			int support = val.support();
+			if(support < bpars.minSupport)
+			{
+				fewsupport++;
+				continue;
+			}
+			int overlap = binoverlap(val, reads.length(rowids[i]), seq2len, bpars.kmerSize);
+			if(overlap < bpars.minOverlap)
+			{
+				shortoverlap++;
+				continue;
+			}
+			if(bpars.useQgram && support < qgramlemma(overlap, divergence, bpars.kmerSize))
+			{
+				qgram++;
+				continue;
+			}
+			rowids[kept] = rowids[i];
+			values[kept] = values[i];
+			++kept;
+		}
+		colptr[j-start+1] = kept - (colptrC[j] - begnz);
+	}
+
+	// then the columns are moved down, in order (each one only moves to lower addresses)
+	for(IT j = start; j < end; ++j)
+	{
+		IT from = colptrC[j] - begnz;
+		IT count = colptr[j-start+1];
+		colptr[j-start+1] = colptr[j-start] + count;
+		if(from != colptr[j-start])
+		{
+			std::copy(rowids + from, rowids + from + count, rowids + colptr[j-start]);
+			std::copy(values + from, values + from + count, values + colptr[j-start]);
+		}
+	}
+
+	rejected.fewshared    = fewshared;
+	rejected.fewsupport   = fewsupport;
+	rejected.shortoverlap = shortoverlap;
+	rejected.qgram        = qgram;
+	return rejected;
+}
+
+/*
+ Split the nonzeros [colptr[0], colptr[end-start]) of columns [start, end) into work units of roughly equal
+ alignment cost. The cost of a candidate pair is estimated from the lengths of the
+ two reads (xdrop work grows with the length of the overlap, which is bounded by them).
+ Columns heavier than a unit are split in nonzero ranges of equal size, light columns
+ are packed together, so a single repetitive read cannot serialize the stage.
+
+ Output:
+	unitptr[u] is the first nonzero of unit u, unitptr[numUnits] = colptr[end-start]
+ */
+template <typename IT>
+std::vector<IT> CostBalancedUnits(IT start, IT end, const IT * colptr, const IT * rowids,
+	const ReadStore& reads, const ReadStore& refreads, int numUnits, bool skipAlignment)
+{
+	IT ncols = end - start;
+	std::vector<size_t> colcost(ncols, 0);
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for(IT j = start; j < end; ++j)
+	{
+		size_t cost = 0;
+		if(skipAlignment)	// overlap estimation only, every pair costs the same
+		{
+			cost = colptr[j-start+1] - colptr[j-start];
+		}
+		else
+		{
+			size_t seq2len = refreads.length(j);
+			for (IT i = colptr[j-start]; i < colptr[j-start+1]; ++i)
+				cost += reads.length(rowids[i]) + seq2len;
+		}
+		colcost[j-start] = cost;
+	}
+
+	size_t totalcost = std::accumulate(colcost.begin(), colcost.end(), static_cast<size_t>(0));
+	size_t unitcost  = std::max(totalcost / std::max(numUnits, 1), static_cast<size_t>(1));
+
+	std::vector<IT> unitptr;
+	unitptr.push_back(colptr[0]);
+
+	size_t sofar = 0;	// cost accumulated in the currently open unit
+	for(IT j = start; j < end; ++j)
+	{
+		size_t cost = colcost[j-start];
+		IT nnzcol = colptr[j-start+1] - colptr[j-start];
+		if(cost > unitcost && nnzcol > 1)	// heavy column: close the open unit and split the column
+		{
+			if(unitptr.back() != colptr[j-start])
+				unitptr.push_back(colptr[j-start]);
+
+			IT pieces = std::min(static_cast<IT>((cost + unitcost - 1) / unitcost), nnzcol);
+			for(IT p = 1; p < pieces; ++p)
+				unitptr.push_back(colptr[j-start] + (nnzcol * p) / pieces);
+
+			unitptr.push_back(colptr[j-start+1]);
+			sofar = 0;
+		}
+		else
+		{
+			sofar += cost;
+			if(sofar >= unitcost)
+			{
+				unitptr.push_back(colptr[j-start+1]);
+				sofar = 0;
+			}
+		}
+	}
+	if(unitptr.back() != colptr[end-start])
+		unitptr.push_back(colptr[end-start]);
+
+	return unitptr;
+}
+
+#ifdef __SIMD__
+/*
+ Aligns the nonzeros [first, last) of a work unit with BatchXDrop: XDROP_BATCHPAIRS pairs are decoded at a time
+ and their left and right extensions share the SIMD lanes, instead of one extension across the lanes (xavierAlign).
+ j is the column of C holding nonzero first. The pairs are then decided in nonzero order, like RunPairWiseAlignments
+ */
+template <typename IT, typename FT>
+void BatchAlignUnit(IT first, IT last, IT j, IT start, const IT * colptr, const IT * rowids, const FT * values,
+	const ReadStore& reads, const ReadStore& refreads, const BELLApars& bpars, double ratiophi,
+	stringstream& myBatch, alignStats_& mystats)
+{
+	BatchXDrop xdrop(1, -1, -1, bpars.xDrop);
+
+	// kept across batches, so that the decoded reads reuse their buffers
+	std::vector<std::string> rows(XDROP_BATCHPAIRS), cols;
+	std::vector<int> colof(XDROP_BATCHPAIRS), seedi(XDROP_BATCHPAIRS), seedj(XDROP_BATCHPAIRS);
+	std::vector<bool> twin(XDROP_BATCHPAIRS);
+	std::vector<XDropJob> jobs;
+	std::vector<XDropResult> results;
+
+	for(IT b = first; b < last; b += XDROP_BATCHPAIRS)
+	{
+		int npairs = std::min<IT>(XDROP_BATCHPAIRS, last - b);
+		std::vector<IT> colids;
+
+		// the row of a pair is decoded on the strand of its seed, the column once per column
+		for(int p = 0; p < npairs; ++p)
+		{
+			while(b + p >= colptr[j-start+1]) ++j;
+			if(colids.empty() || colids.back() != j)
+			{
+				if(colids.size() == cols.size()) cols.emplace_back();
+				refreads.seq(j, cols[colids.size()]);
+				colids.push_back(j);
+			}
+			colof[p] = colids.size() - 1;
+
+			IT rid = rowids[b + p];
+			pair<int, int> kmer = values[b + p].choose();	// seed of the best supported diagonal bin
+			seedi[p] = kmer.first;
+			seedj[p] = kmer.second;
+
+			reads.seq(rid, rows[p]);
+			twin[p] = seedTwin(rows[p], cols[colof[p]], seedi[p], seedj[p], bpars.kmerSize);
+			if(twin[p])
+			{
+				reads.twin(rid, rows[p]);
+				seedi[p] = reads.length(rid) - seedi[p] - bpars.kmerSize;
+			}
+		}
+
+		jobs.clear();
+		for(int p = 0; p < npairs; ++p)
+			xavierJobs(rows[p], cols[colof[p]], seedi[p], seedj[p], bpars.kmerSize, jobs);
+		xdrop.run(jobs, results);
+
+		for(int p = 0; p < npairs; ++p)
+		{
+			IT rid = rowids[b + p];
+			IT cid = colids[colof[p]];
+			bool passed = false;
+
+			xavierResult maxExtScore = xavierBatchResult(seedi[p], seedj[p], bpars.kmerSize, twin[p], results[2*p], results[2*p+1]);
+
+			mystats.alignedpairs++;
+			mystats.totalreadlen += reads.length(rid) + refreads.length(cid);
+			PostAlignDecision(maxExtScore, reads, rid, refreads, cid, bpars, ratiophi, values[b + p].count, myBatch,
+				mystats.outputted, mystats.succbases, mystats.failbases, passed);
+			mystats.alignedbases += getEndPositionV(maxExtScore.seed)-getBeginPositionV(maxExtScore.seed);
+		}
+	}
+}
+#endif
 
+// aligns the nonzeros of columns [start, end) of C, column j has [colptr[j-start], colptr[j-start+1]) of rowids and values.
+// The output lines go to vss (one stream per unit, in order)
+template <typename IT, typename FT>
+auto RunPairWiseAlignments(IT start, IT end, const IT * colptr, IT * rowids, FT * values, const ReadStore& reads, const ReadStore& refreads,
+	vector<stringstream>& vss, const BELLApars& bpars, const double& ratiophi)
+{
 	int numThreads = 1;
 #pragma omp parallel
 	{
 		numThreads = omp_get_num_threads();
 	}
 
-	vector<stringstream> vss(numThreads); // any chance of false sharing here? depends on how stringstream is implemented. optimize later if needed...
-//#pragma omp parallel for schedule(dynamic)
-	for(IT j = start; j < end; ++j)	// for (end-start) columns of A^T A (one block)
-	{
-		size_t numAlignmentsThread		= 0;
-		size_t numBasesAlignedThread	= 0;
-		size_t readLengthsThread		= 0;
-		size_t numBasesAlignedTrue		= 0;
-		size_t numBasesAlignedFalse		= 0;
+	// many more units than threads, so that dynamic scheduling can even out the tail
+	std::vector<IT> unitptr = CostBalancedUnits(start, end, colptr, rowids, reads, refreads,
+		numThreads * UNITSPERTHREAD, bpars.skipAlignment);
+	int numUnits = unitptr.size() - 1;
+
+	// one buffer per unit (not per thread): buffers are written in unit order, so the output
+	// is the same regardless of the number of threads and of which thread ran which unit
+	vss.clear();
+	vss.resize(numUnits);
 
-		size_t outputted = 0;
+	// one cache line per thread: std::allocator only aligns to 16 bytes before C++17
+	alignStats_* stats;
+	if(posix_memalign((void**)&stats, alignof(alignStats_), numThreads * sizeof(alignStats_)) != 0)
+	{
+		fprintf(stderr, "Could not allocate the alignment counters\n");
+		exit(1);
+	}
+	for(int t = 0; t < numThreads; ++t)
+		new (&stats[t]) alignStats_();
 
+#pragma omp parallel for schedule(dynamic)
+	for(int u = 0; u < numUnits; ++u)
+	{
 		int ithread = omp_get_thread_num();
-		for (IT i = colptrC[j]; i < colptrC[j+1]; ++i)  // all nonzeros in that column of A^T A
+		alignStats_& mystats = stats[ithread];
+
+		// column of C holding the first nonzero of this unit
+		IT j = start + (std::upper_bound(colptr, colptr + (end-start) + 1, unitptr[u]) - colptr) - 1;
+
+	#ifdef __SIMD__
+		if(bpars.batchAlign && !bpars.skipAlignment)
 		{
-			unsigned int rid = rowids[i-offset];	// row id
-			unsigned int cid = j;					// column id
-			const string& seq1 = reads[rid].seq;	// get reference for readibility
-			const string& seq2 = refreads[cid].seq;	// get reference for readibility
-			unsigned int seq1len = seq1.length();
-			unsigned int seq2len = seq2.length();
-			spmatPtr_ val = values[i-offset];
+			BatchAlignUnit(unitptr[u], unitptr[u+1], j, start, colptr, rowids, values, reads, refreads, bpars, ratiophi,
+				vss[u], mystats);
+			continue;
+		}
+	#endif
 
-			if(!bpars.skipAlignment) // fix -z to not print 
+		// reads decoded from the read stores: the column once per column, the row once per pair
+		// (xavierAlign reads its reverse complement in place)
+		std::string seq1, seq2;
+		IT decodedcol = end;
+
+		for (IT i = unitptr[u]; i < unitptr[u+1]; ++i)  // all nonzeros of this unit of A^T A
+		{
+			while(i >= colptr[j-start+1]) ++j;	// skip to the column of the current nonzero (empty columns too)
+
+			IT rid = rowids[i];	// row id
+			IT cid = j;					// column id
+			unsigned int seq1len = reads.length(rid);
+			unsigned int seq2len = refreads.length(cid);
+			const FT& val = values[i];
+
+			if(!bpars.skipAlignment) // fix -z to not print
 			{
-				numAlignmentsThread++;
-				readLengthsThread = readLengthsThread + seq1len + seq2len;
+				mystats.alignedpairs++;
+				mystats.totalreadlen += seq1len + seq2len;
 			#ifdef __SIMD__
 				xavierResult maxExtScore;
 			#else
 				seqAnResult maxExtScore;
 			#endif
-			
+
 				bool passed = false;
 
 				//	GG: number of matching kmer into the majority voted bin
 				// unsigned short int matches = val->chain();
-				unsigned short int overlap;
-				pair<int, int> kmer = val->pos[0];	// GGGG: @David it's using the first common k-mer you might wanna do something smarter here
+				pair<int, int> kmer = val.choose();	// seed of the best supported diagonal bin
 				int i = kmer.first, j = kmer.second;
+
+				reads.seq(rid, seq1);
+				if(decodedcol != cid)
+				{
+					refreads.seq(cid, seq2);
+					decodedcol = cid;
+				}
 				//	GG: nucleotide alignment
 			#ifdef __SIMD__
 				maxExtScore = xavierAlign(seq1, seq2, seq1len, i, j, bpars.xDrop, bpars.kmerSize);
@@ -560,88 +1082,101 @@ auto RunPairWiseAlignments(IT start, IT end, IT offset, IT * colptrC, IT * rowid
 				maxExtScore = alignSeqAn(seq1, seq2, seq1len, i, j, bpars.xDrop, bpars.kmerSize);
 			#endif
 
-				PostAlignDecision(maxExtScore, reads[rid], reads[cid], bpars, ratiophi, val->count, vss[ithread], 
-					outputted, numBasesAlignedTrue, numBasesAlignedFalse, passed); //, matches);
+				PostAlignDecision(maxExtScore, reads, rid, refreads, cid, bpars, ratiophi, val.count, vss[u],
+					mystats.outputted, mystats.succbases, mystats.failbases, passed); //, matches);
 			#ifdef __SIMD__
-				numBasesAlignedThread += getEndPositionV(maxExtScore.seed)-getBeginPositionV(maxExtScore.seed);
+				mystats.alignedbases += getEndPositionV(maxExtScore.seed)-getBeginPositionV(maxExtScore.seed);
 			#else
-				numBasesAlignedThread += endPositionV(maxExtScore.seed)-beginPositionV(maxExtScore.seed);
+				mystats.alignedbases += endPositionV(maxExtScore.seed)-beginPositionV(maxExtScore.seed);
 			#endif
 			}
 			else // if skipAlignment == false do alignment, else save just some info on the pair to file
 			{
-				// pair<int, int> kmer = val->choose();
-				pair<int, int> kmer = val->pos[0];	// GGGG: @David it's using the first common k-mer you might wanna do something smarter here
+				pair<int, int> kmer = val.choose();	// seed of the best supported diagonal bin
 				int i = kmer.first, j = kmer.second;
 
-				int overlap = overlapop(reads[rid].seq, refreads[cid].seq, i, j, bpars.kmerSize);
-				vss[ithread] << refreads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val->count << '\t' <<
+				int overlap = overlapop(reads, rid, refreads, cid, i, j, bpars.kmerSize);
+				vss[u] << refreads.name(cid) << '\t' << reads.name(rid) << '\t' << val.count << '\t' <<
 						overlap << '\t' << seq2len << '\t' << seq1len << endl;
-				++outputted;
-				// vss[ithread] << reads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val->count << '\t' << 
-				// 		seq2len << '\t' << seq1len << std::endl;
-				// ++outputted;
+				mystats.outputted++;
 			}
-		} // all nonzeros in that column of A^T A
-	#pragma omp critical
-		{
-			alignedpairs += numAlignmentsThread;
-			alignedbases += numBasesAlignedThread;
-			totalreadlen += readLengthsThread;
-			totaloutputt += outputted;
-			totsuccbases += numBasesAlignedTrue;
-			totfailbases += numBasesAlignedFalse;
-		}
-	} // all columns from start...end (omp for loop)
-	double outputting = omp_get_wtime();
+		} // all nonzeros of this unit
+	} // all units of columns start...end (omp for loop)
 
-	int64_t* bytes = new int64_t[numThreads];
-	for(int i = 0; i < numThreads; ++i)
+	alignStats_ total;
+	for(int t = 0; t < numThreads; ++t)
 	{
-		vss[i].seekg(0, ios::end);
-		bytes[i] = vss[i].tellg();
-		vss[i].seekg(0, ios::beg);
+		total.alignedpairs += stats[t].alignedpairs;
+		total.alignedbases += stats[t].alignedbases;
+		total.totalreadlen += stats[t].totalreadlen;
+		total.outputted    += stats[t].outputted;
+		total.succbases    += stats[t].succbases;
+		total.failbases    += stats[t].failbases;
 	}
-	int64_t bytestotal = std::accumulate(bytes, bytes+numThreads, static_cast<int64_t>(0));
-	std::ofstream ofs(filename, std::ios::binary | std::ios::app);
+	free(stats);
 
-	std::string str1 = std::to_string((double)bytestotal/(double)(1024 * 1024));
-	std::string str2 = " MB";
-	std::string OutputSize = str1 + str2;
-	printLog(OutputSize);
+	return make_tuple(total.alignedpairs, total.alignedbases, total.totalreadlen, total.outputted, total.succbases, total.failbases);
+}
 
-	ofs.seekp(bytestotal - 1);
-	ofs.write("", 1); // this will likely create a sparse file so the actual disks won't spin yet
-	ofs.close();
+// appends the streams of a stage to filename in order, returns the bytes written
+int64_t WriteAlignments(vector<stringstream>& vss, char* filename)
+{
+	int numUnits = vss.size();
 
-	#pragma omp parallel
+	// offset of each unit in this stage's output, after whatever previous stages wrote
+	std::vector<int64_t> bytes(numUnits+1, 0);
+	for(int u = 0; u < numUnits; ++u)
 	{
-		int ithread = omp_get_thread_num();	
+		vss[u].seekp(0, ios::end);
+		bytes[u+1] = bytes[u] + vss[u].tellp();
+	}
+	int64_t bytestotal = bytes[numUnits];
+
+	struct stat filestat;
+	int64_t fileoffset = (stat(filename, &filestat) == 0) ? filestat.st_size : 0;
+
+	if(bytestotal > 0)
+	{
+		std::ofstream ofs(filename, std::ios::binary | std::ios::app);	// make sure the file exists before threads open it for update
+		ofs.close();
 
-		FILE *ffinal;
-		if ((ffinal = fopen(filename, "rb+")) == NULL)	// then everyone fills it
+		#pragma omp parallel
 		{
-			fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
+			int ithread = omp_get_thread_num();
+			int nthreads = omp_get_num_threads();
+
+			// contiguous range of units per thread, written with a single seek
+			int ubeg = ((int64_t)numUnits * ithread) / nthreads;
+			int uend = ((int64_t)numUnits * (ithread+1)) / nthreads;
+
+			if(bytes[uend] > bytes[ubeg])
+			{
+				FILE *ffinal;
+				if ((ffinal = fopen(filename, "rb+")) == NULL)	// then everyone fills it
+				{
+					fprintf(stderr, "File %s failed to open at thread %d\n", filename, ithread);
+					exit(1);
+				}
+				fseek (ffinal, fileoffset + bytes[ubeg], SEEK_SET);
+				for(int u = ubeg; u < uend; ++u)
+				{
+					std::string text = vss[u].str();
+					fwrite(text.c_str(), 1, text.length(), ffinal);
+				}
+				fflush(ffinal);
+				fclose(ffinal);
+			}
 		}
-		int64_t bytesuntil = std::accumulate(bytes, bytes+ithread, static_cast<int64_t>(0));
-		fseek (ffinal, bytesuntil, SEEK_SET);
-		std::string text = vss[ithread].str();
-		fwrite(text.c_str(),1, bytes[ithread] ,ffinal);
-		fflush(ffinal);
-		fclose(ffinal);
 	}
 
-	delete [] bytes;
-	double timeoutputt = omp_get_wtime()-outputting;
-
-	return make_tuple(alignedpairs, alignedbases, totalreadlen, totaloutputt, totsuccbases, totfailbases, timeoutputt);
+	return bytestotal;
 }
 
 /**
   * Sparse multithreaded GEMM.
  **/
-template <typename IT, typename NT, typename FT, typename MultiplyOperation, typename AddOperation>
-void HashSpGEMM(const CSC<IT,NT>& A, const CSC<IT,NT>& B, MultiplyOperation multop, AddOperation addop, const readVector_& reads, const readVector_& refreads,
+template <typename IT, typename NTA, typename NTB, typename FT, typename MultiplyOperation, typename AddOperation>
+void HashSpGEMM(const CSC<IT,NTA>& A, const CSC<IT,NTB>& B, MultiplyOperation multop, AddOperation addop, const ReadStore& reads, const ReadStore& refreads,
 	FT& getvaluetype, char* filename, const BELLApars& bpars, const double& ratiophi)
 {
 	double free_memory = estimateMemory(bpars);
@@ -657,24 +1192,42 @@ void HashSpGEMM(const CSC<IT,NT>& A, const CSC<IT,NT>& B, MultiplyOperation mult
 		numThreads = omp_get_num_threads();
 	}
 
-	IT* flopC = estimateFLOP(A, B, true);
-	IT* flopptr = prefixsum<IT>(flopC, B.cols, numThreads);
-	IT flops = flopptr[B.cols];
+	// the counters of C are 64-bit whatever IT is, a stage only holds as many nonzeros as IT counts
+	uint64_t* flopC = estimateFLOP(A, B, true);
+	uint64_t* flopptr = prefixsum<uint64_t>(flopC, B.cols, numThreads);
+	uint64_t flops = flopptr[B.cols];
 
 	std::string FLOPs = std::to_string(flops);
 	printLog(FLOPs);
 
-	IT* colnnzC = estimateNNZ_Hash(A, B, flopC, true);
-	IT* colptrC = prefixsum<IT>(colnnzC, B.cols, numThreads);	// colptrC[i] = rolling sum of nonzeros in C[1...i]
+	uint64_t* colnnzC = estimateNNZ_Hash(A, B, flopC, flopptr, true);
+	uint64_t* colptrC = prefixsum<uint64_t>(colnnzC, B.cols, numThreads);	// colptrC[i] = rolling sum of nonzeros in C[1...i]
 	delete [] colnnzC;
-	delete [] flopptr;
 	delete [] flopC;
-	IT nnzc = colptrC[B.cols];
+	uint64_t nnzc = colptrC[B.cols];
 	double compression_ratio = (double)flops / nnzc;
 
-	uint64_t required_memory = safety_net * nnzc * (sizeof(FT)+sizeof(IT));	// required memory to form the output
-	int stages = std::ceil((double) required_memory/ free_memory); 	// form output in stages 
-	uint64_t nnzcperstage = free_memory / (safety_net * (sizeof(FT)+sizeof(IT)));
+	// bytes per nonzero while a stage is alive: the per-column vectors of LocalSpGEMM (grown by doubling) next to
+	// the combined arrays, and the text of its alignments. A model until the first stages are measured
+	double formcost = 3 * (sizeof(FT)+sizeof(IT));
+	std::atomic<uint64_t> textbytes(0), textnnz(0);	// measured on the stages aligned so far
+
+	// few flops per nonzero of C: little to merge, sorting the expanded products beats probing a table (--spgemm forces one)
+	auto pickESC = [&](double stageflops, double stagennz)
+	{
+		return bpars.spgemmKernel == "esc" || (bpars.spgemmKernel == "auto" && stageflops < ESC_MAXCOMPRESSION * stagennz);
+	};
+	// bytes per flop of the workspace of LocalSpGEMM_ESC (keys, tmpkeys, perm, tmpperm, products), alive next to the
+	// vectors of the stage. Not in formcost: it goes with the flops of a stage, not with its nonzeros
+	const double esccost = 2 * sizeof(uint64_t) + 2 * sizeof(size_t) + sizeof(FT);
+
+	// at most PIPELINE_DEPTH stages alive at once, one at a time on a single thread: forming the next stage while
+	// this one is aligned would only take turns on the same core
+	int depth = (numThreads > 1) ? PIPELINE_DEPTH : 1;
+	double stagebudget = free_memory / depth;
+	double modelcost = safety_net * (formcost + TEXTPERNONZERO + (pickESC(flops, nnzc) ? esccost * compression_ratio : 0));
+	uint64_t required_memory = modelcost * nnzc;	// required memory to form the output
+	int stages = std::ceil((double) required_memory / stagebudget); 	// form output in stages, sized as they go
 
 	//std::cout << nnzc << std::endl;
 
@@ -690,60 +1243,187 @@ void HashSpGEMM(const CSC<IT,NT>& A, const CSC<IT,NT>& B, MultiplyOperation mult
 	printLog(RequiredMemory);
 	printLog(RequiredStages);
 
-	IT * colStart = new IT[stages+1];	// one array is enough to set stage boundaries	              
-	colStart[0] = 0;
-
-	for(int i = 1; i < stages; ++i)	// colsPerStage is no longer fixed (helps with potential load imbalance)
+	// a stage of C, formed by the SpGEMM thread and aligned by this one
+	struct StageC
 	{
-		// std::upper_bound returns an iterator pointing to the first element 
-		// in the range [first, last) that is greater than value, or last if no such element is found
-		auto upper = std::upper_bound(colptrC, colptrC+B.cols+1, i*nnzcperstage ); 
-		colStart[i]  = upper - colptrC - 1;	// we don't want the element that exceeds our budget, we want the one just before that
+		IT first, last;		// columns of C
+		IT* colptr;			// of the pairs left by FilterCandidates, colptr[0] = 0
+		IT* rowids;
+		FT* values;
+		filterStats_ rejected;
+		bool useESC;
+		double spgemmtime;
+	};
+	// the output text of a stage, written by the output thread
+	struct StageText
+	{
+		std::unique_ptr<vector<stringstream>> vss;
+	};
+
+	// SpGEMM of stage b+1 and output of stage b-1 run while stage b is aligned: at most depth stages
+	// of C are alive at once, which stagebudget accounts for
+	StageQueue<StageC> formed(depth);
+	StageQueue<StageText> aligned(PIPELINE_DEPTH);
+	int64_t outputbytes = 0;
+	double outputtime = 0;
+
+	// while a stage is formed and another one aligned, the threads are split between the two teams, not given twice.
+	// Alignment takes most of the time, unless it is skipped (--spgemm-threads sets the SpGEMM share). The first stage
+	// is formed, and the stages left once the last one is formed are aligned, by all the threads
+	int spgemmThreads = numThreads, alignThreads = numThreads;
+	if(depth > 1)
+	{
+		spgemmThreads = bpars.spgemmThreads > 0 ? bpars.spgemmThreads : (bpars.skipAlignment ? numThreads - 1 : numThreads / 4);
+		spgemmThreads = std::max(1, std::min(spgemmThreads, numThreads - 1));
+		alignThreads = numThreads - spgemmThreads;
 	}
-	colStart[stages] = B.cols;
+	std::atomic<bool> formedall(false);	// no SpGEMM left to run next to the alignment
 
-	for(int b = 0; b < stages; ++b) 
+	std::string ThreadsSplit = "SpGEMM " + std::to_string(spgemmThreads) + ", alignment " + std::to_string(alignThreads);
+	printLog(ThreadsSplit);
+
+	std::thread spgemm([&]()
 	{
-		double alnlenl = omp_get_wtime();
+		IT first = 0;
+		bool formmeasured = false;
+		while(first < B.cols)
+		{
+			formed.reserve();
+			double alnlenl = omp_get_wtime();
+			omp_set_num_threads(first == 0 ? numThreads : spgemmThreads);	// of this thread only, nothing is aligned yet for the first stage
 
-		vector<IT> * RowIdsofC = new vector<IT>[colStart[b+1]-colStart[b]];    // row ids for each column of C (bunch of cols)
-		vector<FT> * ValuesofC = new vector<FT>[colStart[b+1]-colStart[b]];    // values for each column of C (bunch of cols)
+			// as many columns as the budget holds at the cost measured so far (at least one)
+			double textcost = (textnnz > 0) ? (double)textbytes / textnnz : TEXTPERNONZERO;
+			auto lastFor = [&](double costpernz)
+			{
+				uint64_t budgetnnz = std::max<uint64_t>(1, stagebudget / (safety_net * costpernz));
+				budgetnnz = std::min<uint64_t>(budgetnnz, std::numeric_limits<IT>::max());	// the stage arrays are indexed with IT
+				uint64_t target = std::min<uint64_t>(colptrC[first] + budgetnnz, colptrC[B.cols]);
+				// std::upper_bound returns an iterator pointing to the first element 
+				// in the range [first, last) that is greater than value, or last if no such element is found
+				IT last = std::upper_bound(colptrC + first, colptrC + B.cols + 1, target) - colptrC - 1;
+				return (last <= first) ? first + 1 : last;	// a column over the budget on its own
+			};
+			IT last = lastFor(formcost + textcost);
+			double stageflops = flopptr[last] - flopptr[first];
+			double stagennz = colptrC[last] - colptrC[first];
+			bool useESC = pickESC(stageflops, stagennz);
+			if(useESC && stagennz > 0)
+			{
+				// the ESC workspace takes its share of the budget: fewer columns
+				last = lastFor(formcost + textcost + esccost * stageflops / stagennz);
+				stageflops = flopptr[last] - flopptr[first];
+				stagennz = colptrC[last] - colptrC[first];
+				useESC = pickESC(stageflops, stagennz);
+			}
 
-		LocalSpGEMM(colStart[b], colStart[b+1], A, B, multop, addop, RowIdsofC, ValuesofC, colptrC, true);
+			vector<IT> * RowIdsofC = new vector<IT>[last-first];    // row ids for each column of C (bunch of cols)
+			vector<FT> * ValuesofC = new vector<FT>[last-first];    // values for each column of C (bunch of cols)
 
-		double alnlen2 = omp_get_wtime();
-	
-		std::string ColumnsRange = "[" + std::to_string(colStart[b]) + " - " + std::to_string(colStart[b+1]) + "]";
+			if(useESC)
+				LocalSpGEMM_ESC(first, last, A, B, multop, addop, RowIdsofC, ValuesofC, flopptr, true);
+			else
+				LocalSpGEMM(first, last, A, B, multop, addop, RowIdsofC, ValuesofC, colptrC, flopptr, true);
+
+			uint64_t endnz = colptrC[last];
+			uint64_t begnz = colptrC[first];
+
+			// what the stage takes at its peak, vectors and combined arrays together
+			double formbytes = (double)(endnz-begnz) * (sizeof(IT)+sizeof(FT)) + (double)(last-first) * (sizeof(vector<IT>)+sizeof(vector<FT>));
+			for(IT i=first; i<last; ++i)
+				formbytes += RowIdsofC[i-first].capacity() * sizeof(IT) + ValuesofC[i-first].capacity() * sizeof(FT);
+			if(endnz > begnz)
+			{
+				formcost = formmeasured ? std::max(formcost, formbytes / (endnz-begnz)) : formbytes / (endnz-begnz);
+				formmeasured = true;
+			}
+
+			IT * rowids = new IT[endnz-begnz];
+			FT * values = new FT[endnz-begnz];
+			for(IT i=first; i<last; ++i) // combine step
+			{
+				IT loccol = i-first;
+				IT locnz = colptrC[i]-begnz;
+				copy(RowIdsofC[loccol].begin(), RowIdsofC[loccol].end(), rowids + locnz);
+				copy(ValuesofC[loccol].begin(), ValuesofC[loccol].end(), values + locnz);
+			}
+			delete [] RowIdsofC;
+			delete [] ValuesofC;
+
+			// pairs unlikely to pass PostAlignDecision never reach the alignment
+			IT * colptr = new IT[last-first+1];
+			filterStats_ rejected = FilterCandidates(first, last, colptrC, rowids, values, colptr, reads, refreads, bpars);
+
+			if(last == B.cols) formedall = true;
+			formed.push(StageC{first, last, colptr, rowids, values, rejected, useESC, omp_get_wtime()-alnlenl});
+			first = last;
+		}
+		formed.close();
+	});
+
+	std::thread output([&]()
+	{
+		omp_set_num_threads(spgemmThreads);	// short bursts of writes, next to both teams
+		StageText text;
+		while(aligned.pop(text))
+		{
+			double outputting = omp_get_wtime();
+			outputbytes += WriteAlignments(*text.vss, filename);
+			outputtime  += omp_get_wtime()-outputting;
+			text.vss.reset();
+			aligned.release();
+		}
+	});
+
+	StageC stage;
+	int stagesdone = 0;
+	while(formed.pop(stage))
+	{
+		std::string ColumnsRange = "[" + std::to_string(stage.first) + " - " + std::to_string(stage.last) + "]";
 		printLog(ColumnsRange);
+
+		std::string SpGEMMKernel = stage.useESC ? "ESC" : "hash";
+		printLog(SpGEMMKernel);
 	
-		std::string OverlapTime = std::to_string(alnlen2-alnlenl) + " seconds";
+		std::string OverlapTime = std::to_string(stage.spgemmtime) + " seconds";
 		printLog(OverlapTime);
 
-		IT endnz = colptrC[colStart[b+1]];
-		IT begnz = colptrC[colStart[b]];
-
-		IT * rowids = new IT[endnz-begnz];
-		FT * values = new FT[endnz-begnz];
-		for(IT i=colStart[b]; i<colStart[b+1]; ++i) // combine step
+		size_t PairsFiltered = stage.rejected.fewshared + stage.rejected.fewsupport + stage.rejected.shortoverlap + stage.rejected.qgram;
+		printLog(PairsFiltered);
+		if(PairsFiltered > 0)
 		{
-			IT loccol = i-colStart[b];
-			IT locnz = colptrC[i]-begnz;
-			copy(RowIdsofC[loccol].begin(), RowIdsofC[loccol].end(), rowids + locnz);
-			copy(ValuesofC[loccol].begin(), ValuesofC[loccol].end(), values + locnz);
+			std::string FilteredBy = "shared " + std::to_string(stage.rejected.fewshared) + ", chain support " + std::to_string(stage.rejected.fewsupport) +
+				", overlap " + std::to_string(stage.rejected.shortoverlap) + ", q-gram " + std::to_string(stage.rejected.qgram);
+			printLog(FilteredBy);
 		}
-		delete [] RowIdsofC;
-		delete [] ValuesofC;
+
+		double alnlen2 = omp_get_wtime();
 
 		// GG: all paralelism moved to GPU we can do better
-		tuple<size_t, size_t, size_t, size_t, size_t, size_t, double> alignstats; // (alignedpairs, alignedbases, totalreadlen, outputted, alignedtrue, alignedfalse, timeoutputt)
-		alignstats = RunPairWiseAlignments(colStart[b], colStart[b+1], begnz, colptrC, rowids, values, reads, refreads, filename, bpars, ratiophi);
+		tuple<size_t, size_t, size_t, size_t, size_t, size_t> alignstats; // (alignedpairs, alignedbases, totalreadlen, outputted, alignedtrue, alignedfalse)
+		StageText text{std::unique_ptr<vector<stringstream>>(new vector<stringstream>())};
+		omp_set_num_threads(formedall ? numThreads : alignThreads);
+		alignstats = RunPairWiseAlignments(stage.first, stage.last, stage.colptr, stage.rowids, stage.values, reads, refreads, *text.vss, bpars, ratiophi);
+
+		delete [] stage.colptr;
+		delete [] stage.rowids;
+		delete [] stage.values;
+		formed.release();
+
+		// output text per nonzero, for the size of the next stages
+		for(stringstream& ss : *text.vss)
+		{
+			ss.seekp(0, ios::end);
+			textbytes += ss.tellp();
+		}
+		textnnz += colptrC[stage.last] - colptrC[stage.first];
+		++stagesdone;
 
 		if(!bpars.skipAlignment)
 		{
-			double elapsed = omp_get_wtime()-alnlen2;
-			double aligntime = elapsed-get<6>(alignstats); // substracting outputting time
+			double aligntime = omp_get_wtime()-alnlen2;
 		
-			std::string ColumnsRange = "[" + std::to_string(colStart[b]) + " - " + std::to_string(colStart[b+1]) + "]";
+			std::string ColumnsRange = "[" + std::to_string(stage.first) + " - " + std::to_string(stage.last) + "]";
 			printLog(ColumnsRange);
 		
 			std::string AlignmentTime = std::to_string(aligntime) + " seconds";
@@ -769,14 +1449,25 @@ void HashSpGEMM(const CSC<IT,NT>& A, const CSC<IT,NT>& B, MultiplyOperation mult
 
 		int LinesOutputted = get<3>(alignstats);
 		printLog(LinesOutputted);
-		std::string OutputtingTime = std::to_string(get<6>(alignstats)) + " seconds";
-		printLog(OutputtingTime);
 
-		delete [] rowids;
-		delete [] values;
-	} // for(int b = 0; b < states; ++b)
+		aligned.reserve();
+		aligned.push(std::move(text));
+	}
+	aligned.close();
+	spgemm.join();
+	output.join();
+	omp_set_num_threads(numThreads);
+
+	std::string StagesFormed = std::to_string(stagesdone);
+	printLog(StagesFormed);
+
+	// written in the background: only the totals
+	std::string OutputSize = std::to_string((double)outputbytes/(double)(1024 * 1024)) + " MB";
+	printLog(OutputSize);
+	std::string OutputtingTime = std::to_string(outputtime) + " seconds";
+	printLog(OutputtingTime);
 	delete [] colptrC;
-	delete [] colStart;
+	delete [] flopptr;
 }
 
 
@@ -862,11 +1553,11 @@ void PostAlignDecisionGPU(const loganResult& maxExtScore, const readType_& read1
 	}
 }
 
-// (unsigned int, unsigned int, unsigned int, unsigned int *, unsigned int *, spmatPtr_ *,  
+// (unsigned int, unsigned int, unsigned int, unsigned int *, unsigned int *, spmatVal_ *,  
 // 		const readVector_, const BELLApars, char *, double)
 template <typename IT, typename FT>
 std::tuple<uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, double>
-RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids, FT * values, const readVector_& reads, 
+RunPairWiseAlignmentsGPU(IT start, IT end, uint64_t offset, uint64_t * colptrC, IT * rowids, FT * values, const readVector_& reads, 
 	const BELLApars& bpars, char* filename, double ratiophi)
 {
 	stringstream ss;
@@ -882,10 +1573,10 @@ RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids,
 	for(IT j = start; j < end; ++j)					//	acculate sequences for GPU batch alignment
 	{
 		count++;
-		for (IT i = colptrC[j]; i < colptrC[j+1]; ++i)
+		for (uint64_t i = colptrC[j]; i < colptrC[j+1]; ++i)
 		{
-			unsigned int rid = rowids[i-offset];	// row id
-			unsigned int cid = j;					// column id
+			IT rid = rowids[i-offset];	// row id
+			IT cid = j;					// column id
 
 			const string& seq1 = reads[rid].seq;	// get reference for readibility
 			const string& seq2 = reads[cid].seq;	// get reference for readibility
@@ -893,7 +1584,7 @@ RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids,
 			unsigned short int seq1len = seq1.length();
 			unsigned short int seq2len = seq2.length();
 
-			spmatPtr_ val = values[i-offset];
+			const FT& val = values[i-offset];
 
 			if(!bpars.skipAlignment) // fix -z to not print 
 			{
@@ -902,7 +1593,7 @@ RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids,
 				//	GG: number of matching kmer into the majority voted bin
 				// unsigned short int matches = val->chain();
 
-				pair<int, int> kmer = val->choose();
+				pair<int, int> kmer = val.choose();
 				int i = kmer.first, j = kmer.second;
 
 				std::string strand = "n";
@@ -937,13 +1628,13 @@ RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids,
 			}
 			else // if skipAlignment == false do alignment, else save just some info on the pair to file
 			{
-				pair<int, int> kmer = val->choose();
+				pair<int, int> kmer = val.choose();
 				int i = kmer.first, j = kmer.second;
 
 				int overlap = overlapop(reads[rid].seq, reads[cid].seq, i, j, bpars.kmerSize);
-				// vss[ithread] << reads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val->count << '\t' << 
+				// vss[ithread] << reads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val.count << '\t' << 
 				// 		seq2len << '\t' << seq1len << endl;
-				ss << reads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val->count << '\t' <<
+				ss << reads[cid].nametag << '\t' << reads[rid].nametag << '\t' << val.count << '\t' <<
 						overlap << '\t' << seq2len << '\t' << seq1len << endl;
 				++outputted;
 			}
@@ -975,7 +1666,7 @@ RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids,
 			// uint64_t numBasesAlignedTrue   = 0;
 			// uint64_t numBasesAlignedFalse  = 0;
 
-			for (IT i = colptrC[j]; i < colptrC[j+1]; ++i)	// all nonzeros in that column of A^T A
+			for (uint64_t i = colptrC[j]; i < colptrC[j+1]; ++i)	// all nonzeros in that column of A^T A
 			{
 				unsigned int rid = rowids[i-offset];		// row id
 				unsigned int cid = j;						// column id
@@ -986,7 +1677,7 @@ RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids,
 				unsigned short int seq1len = seq1.length();
 				unsigned short int seq2len = seq2.length();
 
-				spmatPtr_ val = values[i-offset];
+				const FT& val = values[i-offset];
 
 				alignedpairs++;
 				totalreadlen = totalreadlen + seq1len + seq2len;
@@ -995,7 +1686,7 @@ RunPairWiseAlignmentsGPU(IT start, IT end, IT offset, IT * colptrC, IT * rowids,
 				bool passed = false;
 				loganResult maxExtScore = maxExtScoreL[idx];
 
-				PostAlignDecisionGPU(maxExtScore, reads[rid], reads[cid], bpars, ratiophi, val->count, 
+				PostAlignDecisionGPU(maxExtScore, reads[rid], reads[cid], bpars, ratiophi, val.count, 
 					ss, totaloutputt, totsuccbases, totfailbases, passed);
 
 				idx++;	// pairs aligned
@@ -1072,19 +1763,18 @@ void HashSpGEMMGPU(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation
 		numThreads = omp_get_num_threads();
 	}
 
-	IT* flopC = estimateFLOP(A, B, true);
-	IT* flopptr = prefixsum<IT>(flopC, B.cols, numThreads);
-	IT flops = flopptr[B.cols];
+	uint64_t* flopC = estimateFLOP(A, B, true);
+	uint64_t* flopptr = prefixsum<uint64_t>(flopC, B.cols, numThreads);
+	uint64_t flops = flopptr[B.cols];
 
 	std::string FLOPs = std::to_string(flops);
 	printLog(FLOPs);
 
-	IT* colnnzC = estimateNNZ_Hash(A, B, flopC, true);
-	IT* colptrC = prefixsum<IT>(colnnzC, B.cols, numThreads);	// colptrC[i] = rolling sum of nonzeros in C[1...i]
+	uint64_t* colnnzC = estimateNNZ_Hash(A, B, flopC, flopptr, true);
+	uint64_t* colptrC = prefixsum<uint64_t>(colnnzC, B.cols, numThreads);	// colptrC[i] = rolling sum of nonzeros in C[1...i]
 	delete [] colnnzC;
-	delete [] flopptr;
 	delete [] flopC;
-	IT nnzc = colptrC[B.cols];
+	uint64_t nnzc = colptrC[B.cols];
 	double compression_ratio = (double)flops / nnzc;
 
 
@@ -1124,7 +1814,7 @@ void HashSpGEMMGPU(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation
 		vector<IT> * RowIdsofC = new vector<IT>[colStart[b+1]-colStart[b]];    // row ids for each column of C (bunch of cols)
 		vector<FT> * ValuesofC = new vector<FT>[colStart[b+1]-colStart[b]];    // values for each column of C (bunch of cols)
 
-		LocalSpGEMM(colStart[b], colStart[b+1], A, B, multop, addop, RowIdsofC, ValuesofC, colptrC, true);
+		LocalSpGEMM(colStart[b], colStart[b+1], A, B, multop, addop, RowIdsofC, ValuesofC, colptrC, flopptr, true);
 
 		double alnlen2 = omp_get_wtime();
 	
@@ -1134,8 +1824,8 @@ void HashSpGEMMGPU(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation
 		std::string OverlapTime = std::to_string(alnlen2-alnlenl) + " seconds";
 		printLog(OverlapTime);
 
-		IT endnz = colptrC[colStart[b+1]];
-		IT begnz = colptrC[colStart[b]];
+		uint64_t endnz = colptrC[colStart[b+1]];
+		uint64_t begnz = colptrC[colStart[b]];
 
 		IT * rowids = new IT[endnz-begnz];
 		FT * values = new FT[endnz-begnz];
@@ -1193,6 +1883,7 @@ void HashSpGEMMGPU(const CSC<IT,NT> & A, const CSC<IT,NT> & B, MultiplyOperation
 	} //for(int b = 0; b < states; ++b)
 
 	delete [] colptrC;
+	delete [] flopptr;
 	delete [] colStart;
 }
 
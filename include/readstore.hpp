@@ -0,0 +1,262 @@
+#ifndef _BELLA_READSTORE_H_
+#define _BELLA_READSTORE_H_
+
+#include <stdint.h>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <omp.h>
+
+/* Short description:
+ *  - All the reads (or reference chunks) of a run in one arena: bases packed 2 bits each (A0 C1 G2 T3),
+ *    32 per word, plus offset tables indexed by read id. No std::string per read, and no sort by read id:
+ *    ids are given in append order
+ *  - Every read starts on a word, so the reads of a block are packed in parallel without races
+ *  - Bytes other than A/C/G/T (N, IUPAC codes, lower case) are packed as A and kept in a side list,
+ *    so seq() gives back the input exactly
+ *  - The reverse complement is decoded straight from the packed words when it is needed (twin()),
+ *    equal() compares k bases of two reads in place, a word at a time
+ *  */
+
+class ReadStore {
+ public:
+	ReadStore() : nreads(0), maxlen(0)
+	{
+		wordoff.push_back(0);
+		nameoff.push_back(0);
+		excoff.push_back(0);
+	}
+
+	size_t size() const { return nreads; }
+	unsigned int length(size_t id) const { return lens[id]; }
+	unsigned int maxLength() const { return maxlen; }
+	std::string name(size_t id) const { return std::string(names.data() + nameoff[id], nameoff[id+1] - nameoff[id]); }
+
+	// append n reads, the i-th is named name(i) and has sequence seq(i): anything with data() and length()
+	template <typename NameF, typename SeqF>
+	void append(size_t n, NameF name, SeqF seq)
+	{
+		size_t first = nreads;
+		lens.resize(first + n);
+		wordoff.resize(first + n + 1);
+		nameoff.resize(first + n + 1);
+		excoff.resize(first + n + 1);
+
+		const uint8_t* codes = strictCodes();
+	#pragma omp parallel for
+		for(size_t i = 0; i < n; ++i)
+		{
+			auto s = seq(i);
+			size_t len = s.length(), nexc = 0;
+			for(size_t j = 0; j < len; ++j)
+				nexc += (codes[(unsigned char)s.data()[j]] > 3);
+			lens[first + i] = len;
+			// sizes for now, offsets after the prefix sum
+			wordoff[first + i + 1] = (len + 31) / 32;
+			nameoff[first + i + 1] = name(i).length();
+			excoff [first + i + 1] = nexc;
+		}
+		for(size_t i = first; i < first + n; ++i)
+		{
+			maxlen = std::max(maxlen, lens[i]);
+			wordoff[i + 1] += wordoff[i];
+			nameoff[i + 1] += nameoff[i];
+			excoff [i + 1] += excoff[i];
+		}
+		words.resize(wordoff[first + n]);
+		names.resize(nameoff[first + n]);
+		exceptions.resize(excoff[first + n]);
+
+	#pragma omp parallel for
+		for(size_t i = 0; i < n; ++i)
+		{
+			auto s = seq(i);
+			auto nm = name(i);
+			const char* p = s.data();
+			size_t len = s.length();
+			uint64_t* w = words.data() + wordoff[first + i];
+			std::pair<uint32_t, char>* e = exceptions.data() + excoff[first + i];
+
+			for(size_t b = 0; b < len; b += 32)
+			{
+				uint64_t packed = 0;
+				size_t m = std::min<size_t>(32, len - b);
+				for(size_t j = 0; j < m; ++j)
+				{
+					uint8_t c = codes[(unsigned char)p[b + j]];
+					if(c > 3)
+					{
+						*e++ = std::make_pair((uint32_t)(b + j), p[b + j]);
+						c = 0;
+					}
+					packed |= (uint64_t)c << (2 * j);
+				}
+				w[b / 32] = packed;
+			}
+			std::copy(nm.data(), nm.data() + nm.length(), names.begin() + nameoff[first + i]);
+		}
+		nreads += n;
+	}
+
+	// sequence of read id into out
+	void seq(size_t id, std::string& out) const
+	{
+		static const std::array<uint32_t, 256> quad = quadTable("ACGT");
+		size_t len = lens[id];
+		out.resize((len + 3) & ~(size_t)3);	// 4 bases per byte of the words
+		const uint8_t* bytes = (const uint8_t*)(words.data() + wordoff[id]);
+		for(size_t b = 0; b < len; b += 4)
+			memcpy(&out[b], &quad[bytes[b / 4]], 4);
+		out.resize(len);
+		for(size_t x = excoff[id]; x < excoff[id+1]; ++x)
+			out[exceptions[x].first] = exceptions[x].second;
+	}
+
+	std::string seq(size_t id) const
+	{
+		std::string out;
+		seq(id, out);
+		return out;
+	}
+
+	// reverse complement of read id into out, what reversecomplement() of align.hpp gives for A/C/G/T
+	void twin(size_t id, std::string& out) const
+	{
+		static const std::array<uint32_t, 256> quad = twinQuadTable();
+		size_t len = lens[id];
+		size_t padded = (len + 3) & ~(size_t)3;
+		out.resize(padded);
+		const uint8_t* bytes = (const uint8_t*)(words.data() + wordoff[id]);
+		for(size_t b = 0; b < len; b += 4)
+			memcpy(&out[padded - b - 4], &quad[bytes[b / 4]], 4);
+		out.erase(0, padded - len);	// complements of the padding bases
+		for(size_t x = excoff[id]; x < excoff[id+1]; ++x)
+			out[len - 1 - exceptions[x].first] = complement(exceptions[x].second);
+	}
+
+	// same as comparing the k bytes at pos of read id with the k bytes at opos of read oid of o
+	bool equal(size_t id, size_t pos, const ReadStore& o, size_t oid, size_t opos, unsigned int k) const
+	{
+		if(hasException(id, pos, k) || o.hasException(oid, opos, k))
+		{
+			for(unsigned int j = 0; j < k; ++j)
+				if(at(id, pos + j) != o.at(oid, opos + j))
+					return false;
+			return true;
+		}
+		for(unsigned int j = 0; j < k; j += 32)
+		{
+			unsigned int m = std::min(32U, k - j);
+			uint64_t mask = (m == 32) ? ~0ULL : ((1ULL << (2 * m)) - 1);
+			if(((bits(id, pos + j, m) ^ o.bits(oid, opos + j, m)) & mask) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	// byte at position pos of read id
+	char at(size_t id, size_t pos) const
+	{
+		static const char bases[4] = {'A', 'C', 'G', 'T'};
+		auto first = exceptions.begin() + excoff[id], last = exceptions.begin() + excoff[id+1];
+		auto e = std::lower_bound(first, last, pos, byPosition);
+		if(e != last && e->first == pos)
+			return e->second;
+		return bases[(words[wordoff[id] + pos / 32] >> (2 * (pos % 32))) & 3];
+	}
+
+	// memory footprint in bytes
+	size_t bytes() const
+	{
+		return words.size() * sizeof(uint64_t) + names.size() + exceptions.size() * sizeof(std::pair<uint32_t, char>) +
+			lens.size() * sizeof(uint32_t) + (wordoff.size() + nameoff.size() + excoff.size()) * sizeof(size_t);
+	}
+
+ private:
+	// 2-bit code of every byte: A 0, C 1, G 2, T 3, anything else (lower case too) 4
+	static const uint8_t* strictCodes()
+	{
+		static const std::array<uint8_t, 256> table = []()
+		{
+			std::array<uint8_t, 256> t;
+			t.fill(4);
+			t['A'] = 0; t['C'] = 1; t['G'] = 2; t['T'] = 3;
+			return t;
+		}();
+		return table.data();
+	}
+
+	// the 4 bases packed in every byte, as 4 chars
+	static std::array<uint32_t, 256> quadTable(const char* bases)
+	{
+		std::array<uint32_t, 256> t;
+		for(int b = 0; b < 256; ++b)
+		{
+			char q[4] = {bases[b & 3], bases[(b >> 2) & 3], bases[(b >> 4) & 3], bases[(b >> 6) & 3]};
+			memcpy(&t[b], q, 4);
+		}
+		return t;
+	}
+
+	// the 4 bases packed in every byte, complemented and in reverse order
+	static std::array<uint32_t, 256> twinQuadTable()
+	{
+		static const char comp[4] = {'T', 'G', 'C', 'A'};
+		std::array<uint32_t, 256> t;
+		for(int b = 0; b < 256; ++b)
+		{
+			char q[4] = {comp[(b >> 6) & 3], comp[(b >> 4) & 3], comp[(b >> 2) & 3], comp[b & 3]};
+			memcpy(&t[b], q, 4);
+		}
+		return t;
+	}
+
+	static char complement(char c)
+	{
+		switch(c)
+		{
+			case 'a': return 't';
+			case 'c': return 'g';
+			case 'g': return 'c';
+			case 't': return 'a';
+			default:  return c;	// N and other codes are their own complement here
+		}
+	}
+
+	static bool byPosition(const std::pair<uint32_t, char>& e, size_t pos) { return e.first < pos; }
+
+	// true if read id has a byte in the side list in [pos, pos+k)
+	bool hasException(size_t id, size_t pos, unsigned int k) const
+	{
+		if(excoff[id] == excoff[id+1]) return false;
+		auto first = exceptions.begin() + excoff[id], last = exceptions.begin() + excoff[id+1];
+		auto e = std::lower_bound(first, last, pos, byPosition);
+		return e != last && e->first < pos + k;
+	}
+
+	// m <= 32 bases from pos of read id, base pos in the low bits
+	uint64_t bits(size_t id, size_t pos, unsigned int m) const
+	{
+		const uint64_t* w = words.data() + wordoff[id] + pos / 32;
+		unsigned int shift = 2 * (pos % 32);
+		uint64_t v = w[0] >> shift;
+		if(shift != 0 && (pos % 32) + m > 32)
+			v |= w[1] << (64 - shift);
+		return v;
+	}
+
+	size_t nreads;
+	uint32_t maxlen;					// longest read so far
+	std::vector<uint64_t> words;		// packed bases, read i in [wordoff[i], wordoff[i+1])
+	std::vector<size_t> wordoff;
+	std::vector<uint32_t> lens;
+	std::vector<char> names;			// read i is named names[nameoff[i], nameoff[i+1])
+	std::vector<size_t> nameoff;
+	std::vector<std::pair<uint32_t, char>> exceptions;	// (position, byte), read i has [excoff[i], excoff[i+1])
+	std::vector<size_t> excoff;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _BELLA_STAGEQUEUE_H_
+#define _BELLA_STAGEQUEUE_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/* Short description:
+ *  - Hands the stages of HashSpGEMM from one thread to the next (SpGEMM -> alignment -> output)
+ *  - At most depth stages are in flight between reserve() and release(): the producer reserves a slot
+ *    before it builds a stage, the consumer releases it once the stage is freed, so the memory
+ *    of at most depth stages is alive whatever the speed of the two sides
+ *  - pop() returns false once close() was called and every stage was taken
+ *  */
+
+template <typename T>
+class StageQueue {
+ public:
+	explicit StageQueue(int depth) : depth(depth), inflight(0), closed(false) {}
+
+	// blocks until fewer than depth stages are in flight
+	void reserve()
+	{
+		std::unique_lock<std::mutex> lock(m);
+		cv.wait(lock, [this]{ return inflight < depth; });
+		++inflight;
+	}
+
+	void release()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			--inflight;
+		}
+		cv.notify_all();
+	}
+
+	void push(T stage)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			ready.push_back(std::move(stage));
+		}
+		cv.notify_all();
+	}
+
+	// no more push()
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			closed = true;
+		}
+		cv.notify_all();
+	}
+
+	bool pop(T& stage)
+	{
+		std::unique_lock<std::mutex> lock(m);
+		cv.wait(lock, [this]{ return !ready.empty() || closed; });
+		if(ready.empty()) return false;
+		stage = std::move(ready.front());
+		ready.pop_front();
+		return true;
+	}
+
+ private:
+	int depth;
+	int inflight;
+	bool closed;
+	std::deque<T> ready;
+	std::mutex m;
+	std::condition_variable cv;
+};
+
+#endif
@@ -2,7 +2,7 @@
 #define _BELLA_SYNCMER_H_
 
 #include "../kmercode/hash_funcs.h"
-#include "../kmercode/Kmer.hpp"
+#include "../kmercode/FixedKmer.hpp"
 #include <queue>
 #include <vector>
 #include <utility>
@@ -46,18 +46,19 @@
 
 const int smerlen = 5; //make it input param
 
-bool isSyncmer(const Kmer& mer, int& kmerlen)
+template <typename KT>
+bool isSyncmer(const KT& mer, int& kmerlen)
 {
     string kmer = mer.toString();
-    Kmer stKmer(kmer.substr(0, smerlen).c_str(), smerlen); // first s-mer of the k-mer
-    Kmer endKmer(kmer.substr(kmerlen - smerlen, smerlen).c_str(), smerlen); // last s-mer of the k-mer
+    Kmer32 stKmer(kmer.substr(0, smerlen).c_str(), smerlen); // first s-mer of the k-mer
+    Kmer32 endKmer(kmer.substr(kmerlen - smerlen, smerlen).c_str(), smerlen); // last s-mer of the k-mer
 
     uint64_t stsmer =  stKmer.hash(); //(kmer >> (2*(31-(smerlen - 1)))) & mask; // first s-mer of the k-mer
     uint64_t endsmer = endKmer.hash();    
     
     for (int i = 1; i < kmerlen - smerlen ; ++i)
     {
-        Kmer tmpsmer(kmer.substr(i, kmerlen).c_str(), smerlen);
+        Kmer32 tmpsmer(kmer.substr(i, kmerlen).c_str(), smerlen);
 
         if(tmpsmer.hash() < stsmer && tmpsmer.hash() < endsmer){
             return false;
@@ -69,7 +70,8 @@ bool isSyncmer(const Kmer& mer, int& kmerlen)
 
 // this is a canonical strand minimizer
 // to avoid strand ambiguity, we advise choosing an odd number for kmer length
-void getSyncmers(int klen, const std::vector<Kmer>& input, std::vector<int>& output)
+template <typename KT>
+void getSyncmers(int klen, const std::vector<KT>& input, std::vector<int>& output)
 { 
     for (size_t i = 0; i < input.size(); ++i)
     {
@@ -0,0 +1,209 @@
+#ifndef BELLA_FIXED_KMER_HPP
+#define BELLA_FIXED_KMER_HPP
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <functional>
+#include <iostream>
+
+#include "Kmer.hpp"
+
+/* Short description:
+ *  - K-mer of at most 32*W bases stored in exactly W 64-bit words, nothing else:
+ *    no length and no rev fields, k is a static property of the type (set_k)
+ *  - FixedKmer<1> (k <= 32) and FixedKmer<2> (k <= 64) are chosen at runtime from
+ *    bpars.kmerSize, see RunBELLA in src/main.cpp
+ *  - Bases are 2-bit (A0 C1 G2 T3), MSB-first and left aligned, same as Kmer,
+ *    so comparing words is comparing strings
+ *  - Branch-free twin/rep with bit tricks and a cheap 64-bit mixer hash
+ *  */
+
+template <size_t W> struct packedKmer_ {};
+template <> struct packedKmer_<1> { typedef uint64_t type; };
+template <> struct packedKmer_<2> { typedef unsigned __int128 type; };
+
+// reverse complement of the 32 bases in x
+inline uint64_t revcomp64(uint64_t x)
+{
+	x = ~x;
+	x = __builtin_bswap64(x);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+	return x;
+}
+
+// MurmurHash3 64-bit finalizer
+inline uint64_t fmix64(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+template <size_t W>
+class FixedKmer {
+ public:
+	static_assert(W == 1 || W == 2, "FixedKmer supports one or two words");
+
+	// k-mer packed right aligned in a single integer (what KmerIterator rolls)
+	typedef typename packedKmer_<W>::type packed_t;
+
+	static const unsigned int MAX_K = 32 * W;
+	static const size_t NUM_WORDS = W;
+	static unsigned int k;
+
+	static void set_k(unsigned int _k)
+	{
+		if(_k <= 32*(W-1) || _k > MAX_K)	// twin() of a two-word k-mer relies on k > 32
+		{
+			fprintf(stderr, "k-mer length %u not supported by a %zu-word k-mer\n", _k, W);
+			exit(1);
+		}
+		k = _k;
+	}
+
+	FixedKmer()
+	{
+		for(size_t i = 0; i < W; ++i) words[i] = 0;
+	}
+
+	// pre: s[0],...,s[len-1] are all 'A','C','G' or 'T' and len <= MAX_K
+	explicit FixedKmer(const char* s, unsigned int len)
+	{
+		for(size_t i = 0; i < W; ++i) words[i] = 0;
+		for(unsigned int i = 0; i < len; ++i)
+		{
+			uint64_t x = (s[i] & 4) >> 1;
+			words[i/32] |= (x + ((x ^ (s[i] & 2)) >> 1)) << (2*(31-(i%32)));
+		}
+	}
+
+	static FixedKmer fromPacked(packed_t p)
+	{
+		FixedKmer km;
+		p <<= (8*sizeof(packed_t) - 2*k);	// left align
+		for(size_t i = 0; i < W; ++i)
+			km.words[i] = (uint64_t)(p >> (64*(W-1-i)));
+		return km;
+	}
+
+	FixedKmer twin() const;
+
+	// lexicographically smaller of itself and its twin
+	FixedKmer rep() const
+	{
+		FixedKmer tw = twin();
+		return (tw < *this) ? tw : *this;
+	}
+
+	uint64_t hash() const
+	{
+		uint64_t h = 0x9E3779B97F4A7C15ULL;
+		for(size_t i = 0; i < W; ++i)
+			h = fmix64(h ^ words[i]);
+		return h;
+	}
+
+	bool operator<(const FixedKmer& o) const
+	{
+		for(size_t i = 0; i < W; ++i)
+			if(words[i] != o.words[i]) return words[i] < o.words[i];
+		return false;
+	}
+	bool operator==(const FixedKmer& o) const
+	{
+		for(size_t i = 0; i < W; ++i)
+			if(words[i] != o.words[i]) return false;
+		return true;
+	}
+	bool operator!=(const FixedKmer& o) const
+	{
+		return !(*this == o);
+	}
+
+	std::string toString() const
+	{
+		static const char bases[4] = {'A', 'C', 'G', 'T'};
+		std::string s(k, 'A');
+		for(unsigned int i = 0; i < k; ++i)
+			s[i] = bases[(words[i/32] >> (2*(31-(i%32)))) & 0x03];
+		return s;
+	}
+
+	// homopolymer-compressed k-mer, padded to k by repeating its last base, canonical
+	FixedKmer hopc() const
+	{
+		std::string hopc = toHOPC(toString());
+		hopc.resize(k, hopc.back());
+		return FixedKmer(hopc.c_str(), k).rep();
+	}
+
+	// i-th 64-bit word, word 0 holds the first 32 bases (see RadixSortKmers)
+	uint64_t getWord(size_t i) const
+	{
+		return words[i];
+	}
+
+	const uint8_t* getBytes() const
+	{
+		return reinterpret_cast<const uint8_t*>(words);
+	}
+	int getNumBytes() const
+	{
+		return sizeof(words);
+	}
+
+ private:
+	uint64_t words[W];
+};
+
+template <size_t W> unsigned int FixedKmer<W>::k = 0;
+
+template <>
+inline FixedKmer<1> FixedKmer<1>::twin() const
+{
+	FixedKmer<1> km;
+	km.words[0] = revcomp64(words[0]) << (64 - 2*k);	// padding moves on top and is shifted out
+	return km;
+}
+
+template <>
+inline FixedKmer<2> FixedKmer<2>::twin() const
+{
+	FixedKmer<2> km;
+	uint64_t hi = revcomp64(words[1]);
+	uint64_t lo = revcomp64(words[0]);
+	unsigned int s = 128 - 2*k;	// 0 <= s < 64 since k > 32 for two words
+	km.words[0] = (hi << s) | ((lo >> 1) >> (63 - s));
+	km.words[1] = lo << s;
+	return km;
+}
+
+typedef FixedKmer<1> Kmer32;
+typedef FixedKmer<2> Kmer64;
+
+namespace std
+{
+	template<size_t W> struct hash<FixedKmer<W>>
+	{
+		typedef std::size_t result_type;
+		result_type operator()(const FixedKmer<W>& km) const
+		{
+			return km.hash();
+		}
+	};
+};
+
+template <size_t W>
+inline std::ostream& operator<<(std::ostream& out, const FixedKmer<W>& km)
+{
+	return out << km.toString();
+}
+
+#endif
@@ -0,0 +1,266 @@
+#ifndef _GZIP_INPUT_H_
+#define _GZIP_INPUT_H_
+
+#include <string>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/*
+ * Compressed input for MappedFASTQ:
+ *  - BGZF (bgzip, samtools): a series of independent gzip members of at most 64KB of text, whose
+ *    compressed size is in the header and uncompressed size in the trailer. Any thread can start
+ *    at any block, so BGZF files are partitioned and inflated in parallel like plain files
+ *  - plain gzip can only be inflated from the start: GzipPipe does it in a background thread and
+ *    hands out chunks made of whole records, the parsing threads take them as they come
+ */
+
+#define GZIP_CHUNK (1 << 22)		// text handed out at once by GzipPipe
+#define GZIP_READBUF (1 << 20)		// zlib input buffer of GzipPipe
+#define GZIP_MAXRATIO 8				// text per compressed byte assumed for plain gzip, when only an estimate is needed
+
+#define BGZF_HEADER 18				// fixed part of a BGZF header, with the 'BC' subfield
+#define BGZF_TRAILER 8				// CRC32 and ISIZE
+
+static inline uint32_t le16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+static inline uint32_t le32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+// true if p (n bytes left in the file) starts a BGZF block, blocksize is its compressed size
+static inline bool bgzf_header(const char* p, size_t n, size_t& blocksize)
+{
+	const unsigned char* u = (const unsigned char*)p;
+	if(n < BGZF_HEADER || u[0] != 0x1f || u[1] != 0x8b || u[2] != 8 || !(u[3] & 4))
+		return false;
+	size_t xlen = le16(u + 10);
+	if(12 + xlen > n) return false;
+	for(size_t x = 12; x + 4 <= 12 + xlen; x += 4 + le16(u + x + 2))
+	{
+		if(u[x] == 'B' && u[x+1] == 'C' && le16(u + x + 2) == 2 && x + 6 <= 12 + xlen)
+		{
+			blocksize = le16(u + x + 4) + 1;
+			return blocksize >= 12 + xlen + BGZF_TRAILER && blocksize <= n;
+		}
+	}
+	return false;
+}
+
+// uncompressed size of the block at p, from its trailer
+static inline size_t bgzf_isize(const char* p, size_t blocksize)
+{
+	return le32((const unsigned char*)p + blocksize - 4);
+}
+
+// uncompressed size of the plain gzip file at p (n bytes). Its trailer only has it modulo 4GB: the text is taken as the
+// largest size with that remainder that compresses no better than GZIP_MAXRATIO, exact when only one size with that
+// remainder is within that ratio. A file of several members only has the size of the last one in its trailer:
+// counted as if it were one member
+static inline size_t gzip_isize(const char* p, size_t n)
+{
+	size_t maxtext = n * GZIP_MAXRATIO;
+	if(n < 18)	// shorter than an empty member
+		return maxtext;
+	size_t isize = le32((const unsigned char*)p + n - 4);
+	if(isize >= maxtext)
+		return isize;
+	return isize + (((maxtext - isize) >> 32) << 32);
+}
+
+// offset of the first BGZF block at or after offset (fsize if none): the header has to match
+// and be followed by another header, so compressed bytes that look like one are skipped
+static inline size_t bgzf_sync(const char* map, size_t fsize, size_t offset)
+{
+	while(offset < fsize)
+	{
+		const char* p = (const char*) memchr(map + offset, 0x1f, fsize - offset);
+		if(!p) return fsize;
+		offset = p - map;
+		size_t bs, next;
+		if(bgzf_header(p, fsize - offset, bs) && ((next = offset + bs) == fsize || bgzf_header(map + next, fsize - next, bs)))
+			return offset;
+		++offset;
+	}
+	return fsize;
+}
+
+// inflate the block at p into out[0, bgzf_isize)
+static inline void bgzf_inflate(const char* p, size_t blocksize, char* out)
+{
+	const unsigned char* u = (const unsigned char*)p;
+	size_t xlen = le16(u + 10);
+	size_t isize = bgzf_isize(p, blocksize);
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	if(inflateInit2(&zs, -15) != Z_OK)	// raw deflate, the header is already parsed
+	{
+		fprintf(stderr, "Could not initialize zlib\n");
+		exit(1);
+	}
+	zs.next_in = (Bytef*)(u + 12 + xlen);
+	zs.avail_in = blocksize - 12 - xlen - BGZF_TRAILER;
+	zs.next_out = (Bytef*)out;
+	zs.avail_out = isize;
+	int ret = inflate(&zs, Z_FINISH);
+	bool ok = (ret == Z_STREAM_END && zs.total_out == isize);
+	inflateEnd(&zs);
+
+	if(!ok || crc32(crc32(0L, Z_NULL, 0), (const Bytef*)out, isize) != le32(u + blocksize - 8))
+	{
+		fprintf(stderr, "Corrupted BGZF block\n");
+		exit(1);
+	}
+}
+
+// length of the prefix of buf made of whole records (same record rules as MappedFASTQ)
+static inline size_t complete_records(const char* buf, size_t n, bool fasta)
+{
+	if(fasta)	// everything before the last header
+	{
+		const char* e = buf + n;
+		const char* h;
+		while((h = (const char*) memrchr(buf, '>', e - buf)) != NULL)
+		{
+			if(h == buf) return 0;
+			if(h[-1] == '\n') return h - buf;
+			e = h;
+		}
+		return 0;
+	}
+
+	size_t p = 0, whole = 0;
+	while(true)
+	{
+		while(p < n && (buf[p] == '\n' || buf[p] == '\r')) ++p;	// blank lines
+		for(int lines = 0; lines < 4; ++lines)
+		{
+			const char* nl = (const char*) memchr(buf + p, '\n', n - p);
+			if(!nl) return whole;
+			p = (nl - buf) + 1;
+		}
+		whole = p;
+	}
+}
+
+class GzipPipe
+{
+public:
+	GzipPipe(const char* filename, int consumers) : maxqueued(consumers + 2), done(false), stop(false)
+	{
+		gz = gzopen(filename, "rb");
+		if(gz == NULL)
+		{
+			fprintf(stderr, "Could not open %s\n", filename);
+			exit(1);
+		}
+		gzbuffer(gz, GZIP_READBUF);
+		producer = std::thread(&GzipPipe::run, this);
+	}
+
+	~GzipPipe()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			stop = true;
+		}
+		cv.notify_all();
+		producer.join();
+		gzclose(gz);
+	}
+
+	// next chunk of whole records, NULL once the file is over
+	std::shared_ptr<std::string> next()
+	{
+		std::unique_lock<std::mutex> lock(m);
+		cv.wait(lock, [this]{ return !ready.empty() || done; });
+		if(ready.empty()) return nullptr;
+		std::shared_ptr<std::string> chunk = ready.front();
+		ready.pop_front();
+		cv.notify_all();
+		return chunk;
+	}
+
+	// the threads of a team that open the same file share one pipe: the first one creates it,
+	// the last one (team-th) removes it from the table, so the next pass starts a new one
+	static std::shared_ptr<GzipPipe> attach(const char* filename, int team)
+	{
+		static std::mutex tablelock;
+		static std::map<std::string, std::pair<std::shared_ptr<GzipPipe>, int>> opening;
+
+		std::lock_guard<std::mutex> lock(tablelock);
+		auto& entry = opening[filename];
+		if(!entry.first)
+			entry.first = std::make_shared<GzipPipe>(filename, team);
+		std::shared_ptr<GzipPipe> pipe = entry.first;
+		if(++entry.second == team)
+			opening.erase(filename);
+		return pipe;
+	}
+
+private:
+	void run()
+	{
+		std::string carry;		// incomplete record at the end of the previous chunk
+		bool fasta = false, first = true, eof = false;
+
+		while(!eof)
+		{
+			std::shared_ptr<std::string> chunk = std::make_shared<std::string>();
+			chunk->swap(carry);
+
+			size_t target = GZIP_CHUNK, whole;
+			while(true)
+			{
+				while(chunk->size() < target && !eof)
+				{
+					size_t old = chunk->size();
+					chunk->resize(target);
+					int n = gzread(gz, &(*chunk)[old], target - old);
+					if(n < 0)
+					{
+						int err;
+						fprintf(stderr, "Could not decompress: %s\n", gzerror(gz, &err));
+						exit(1);
+					}
+					chunk->resize(old + n);
+					eof = (n == 0);
+				}
+				if(first && !chunk->empty())
+				{
+					fasta = ((*chunk)[0] == '>');
+					first = false;
+				}
+				whole = eof ? chunk->size() : complete_records(chunk->data(), chunk->size(), fasta);
+				if(whole > 0 || eof) break;
+				target *= 2;	// a record longer than the chunk
+			}
+			carry.assign(chunk->data() + whole, chunk->size() - whole);
+			chunk->resize(whole);
+
+			std::unique_lock<std::mutex> lock(m);
+			cv.wait(lock, [this]{ return ready.size() < maxqueued || stop; });
+			if(stop) return;
+			if(!chunk->empty()) ready.push_back(chunk);
+			done = eof;
+			cv.notify_all();
+		}
+	}
+
+	gzFile gz;
+	size_t maxqueued;
+	bool done;			// the producer pushed its last chunk
+	bool stop;			// the consumers are gone
+	std::deque<std::shared_ptr<std::string>> ready;
+	std::mutex m;
+	std::condition_variable cv;
+	std::thread producer;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef BELLA_KMER_ITERATOR_HPP
+#define BELLA_KMER_ITERATOR_HPP
+
+#include <stdint.h>
+#include <cstddef>
+#include <array>
+
+#include "FixedKmer.hpp"
+
+/* Short description:
+ *  - Stream the k-mers of a sequence by shifting one base per step instead of
+ *    calling substr() and re-encoding k bases at every position
+ *  - Keep the forward and the reverse-complement words in step, so the canonical
+ *    k-mer (Kmer::rep()) is a single comparison
+ *  - Skip every window that contains a base other than A/C/G/T (upper or lower case)
+ *
+ *  - KT is a FixedKmer: the words are rolled in KT::packed_t (64 or 128 bits)
+ *
+ *  Usage:
+ *	KmerIterator<KT> it(seq.data(), seq.length(), k);
+ *	while(it.next()) { KT lexsmall = it.rep(); int j = it.pos(); ... }
+ *  */
+
+template <typename KT>
+class KmerIterator {
+	typedef typename KT::packed_t packed_t;
+
+ public:
+	KmerIterator(const char* seq, size_t len, unsigned int k) : s(seq), len(len), k(k), i(0), valid(0), fw(0), rc(0)
+	{
+		mask  = (2*k < 8*sizeof(packed_t)) ? ((((packed_t)1) << (2*k)) - 1) : ~((packed_t)0);
+		shift = 2*(k-1);
+		codes = baseCodes();
+	}
+
+	// advance to the next window without N's, return false when the sequence is over
+	bool next()
+	{
+		while(i < len)
+		{
+			packed_t c = codes[(unsigned char)s[i++]];
+			if(c > 3)	// not a nucleotide: no k-mer can span this position
+			{
+				valid = 0;
+				continue;
+			}
+			fw = ((fw << 2) | c) & mask;
+			rc = (rc >> 2) | ((3 - c) << shift);
+			if(++valid >= k) return true;
+		}
+		return false;
+	}
+
+	// starting position of the current k-mer in the sequence
+	size_t pos() const { return i - k; }
+
+	KT forward() const { return KT::fromPacked(fw); }
+	KT twin() const { return KT::fromPacked(rc); }
+
+	// lexicographically smaller of forward() and twin(), same as forward().rep()
+	KT rep() const { return (rc < fw) ? twin() : forward(); }
+
+	// 2-bit code of every byte: A/a 0, C/c 1, G/g 2, T/t 3, anything else 4
+	static const uint8_t* baseCodes()
+	{
+		static const std::array<uint8_t, 256> table = []()
+		{
+			std::array<uint8_t, 256> t;
+			t.fill(4);
+			t['A'] = t['a'] = 0;
+			t['C'] = t['c'] = 1;
+			t['G'] = t['g'] = 2;
+			t['T'] = t['t'] = 3;
+			return t;
+		}();
+		return table.data();
+	}
+
+ private:
+	const char* s;
+	size_t len;
+	unsigned int k;
+	size_t i;			// next base to read
+	unsigned int valid;	// number of consecutive nucleotides ending at i-1
+	packed_t fw, rc;	// forward and reverse-complement words, right aligned
+	packed_t mask;
+	unsigned int shift;
+	const uint8_t* codes;
+};
+
+#endif
@@ -0,0 +1,478 @@
+#ifndef _MAPPED_FASTQ_H_
+#define _MAPPED_FASTQ_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "common.h"
+#include "GzipInput.h"
+
+using namespace std;
+
+/*
+ * Drop-in replacement of ParallelFASTQ that doesn't copy anything:
+ *  - the file is mmap'ed once, fill_block returns views (pointer + length) into the mapping
+ *    for the name (with its '@' or '>', cut at the first blank), the sequence and the quality
+ *  - lines are found with memchr, which glibc vectorizes (SSE2/AVX2)
+ *  - like open_fq, open() gives the calling thread its own byte range of the file (MYTHREAD of THREADS),
+ *    both ends moved forward to the next record start, so threads parse disjoint sets of records
+ *  - FASTA is accepted too: no quality, and a sequence spread over several lines is joined
+ *    into a buffer owned by the reader (valid until the next fill_block)
+ *  - gzip input (see GzipInput.h): a BGZF file is split between threads by blocks and every thread
+ *    inflates its own blocks, a plain gzip file is inflated by a GzipPipe shared by the threads
+ *  - views are valid until the reader is deleted for plain files, until the next fill_block for gzip
+ */
+
+class SeqView
+{
+public:
+	SeqView() : ptr(NULL), len(0) {}
+	SeqView(const char* p, size_t n) : ptr(p), len(n) {}
+
+	const char* data() const { return ptr; }
+	size_t length() const { return len; }
+	size_t size() const { return len; }
+	bool empty() const { return len == 0; }
+	const char& operator[](size_t i) const { return ptr[i]; }
+	const char* begin() const { return ptr; }
+	const char* end() const { return ptr + len; }
+
+	string str() const { return string(ptr, len); }
+	string substr(size_t pos, size_t n = string::npos) const
+	{
+		if(pos > len) pos = len;
+		return string(ptr + pos, std::min(n, len - pos));
+	}
+
+private:
+	const char* ptr;
+	size_t len;
+};
+
+class MappedFASTQ
+{
+public:
+	MappedFASTQ(void) : fd(-1), map(NULL), fsize(0), mode(PLAIN), buf(NULL), avail(0), final(true),
+		pos(0), end_read(0), fasta(false), nrecords(0) {}
+
+	~MappedFASTQ()
+	{
+		close();
+	}
+
+	void open(const char *filename, bool cached_io, long knownSize = -1)
+	{
+		close();
+		fd = ::open(filename, O_RDONLY);
+		struct stat st;
+		if(fd == -1 || fstat(fd, &st) != 0)
+		{
+			fprintf(stderr, "Could not open %s: %s\n", filename, strerror(errno));
+			exit(1);
+		}
+		fsize = st.st_size;
+		if(fsize > 0)
+		{
+			map = (const char*) mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(map == MAP_FAILED)
+			{
+				fprintf(stderr, "Could not mmap %s: %s\n", filename, strerror(errno));
+				exit(1);
+			}
+		}
+
+		size_t bs;
+		if(fsize >= 2 && (unsigned char)map[0] == 0x1f && (unsigned char)map[1] == 0x8b)
+		{
+			if(bgzf_header(map, fsize, bs))
+				open_bgzf();
+			else
+			{
+				close();
+				mode = GZIP;
+				pipe = GzipPipe::attach(filename, THREADS);
+			}
+			return;
+		}
+
+		mode = PLAIN;
+		buf = map;
+		avail = fsize;
+		final = true;
+		fasta = (fsize > 0 && map[0] == '>');
+
+		// my partition of the file, same split as open_fq
+		size_t block = (fsize + THREADS - 1) / THREADS;
+		size_t start = std::min(block * MYTHREAD, fsize);
+		pos = (start == 0) ? 0 : resync(start);
+		end_read = resync(std::min(block * (MYTHREAD + 1), fsize));
+
+		if(end_read > pos)
+			madvise((void*)(map + (pos & ~(size_t)(getpagesize() - 1))), end_read - (pos & ~(size_t)(getpagesize() - 1)), MADV_SEQUENTIAL);
+	}
+
+	void close()
+	{
+		if(map && map != MAP_FAILED) munmap((void*)map, fsize);
+		if(fd != -1) ::close(fd);
+		map = NULL;
+		fd = -1;
+		fsize = pos = end_read = avail = 0;
+		buf = NULL;
+		final = true;
+		text.clear();
+		chunk.reset();
+		pipe.reset();
+	}
+
+	// bytes of text in a file, without inflating it: exact for plain and BGZF files (the block trailers
+	// have the sizes), from the trailer too for plain gzip, see gzip_isize
+	static size_t text_size(const char* filename)
+	{
+		int f = ::open(filename, O_RDONLY);
+		struct stat st;
+		if(f == -1 || fstat(f, &st) != 0)
+		{
+			fprintf(stderr, "Could not open %s: %s\n", filename, strerror(errno));
+			exit(1);
+		}
+		size_t n = st.st_size, total = n, bs;
+		const char* m = (n >= 2) ? (const char*) mmap(NULL, n, PROT_READ, MAP_PRIVATE, f, 0) : NULL;
+		if(m && m != MAP_FAILED)
+		{
+			if((unsigned char)m[0] == 0x1f && (unsigned char)m[1] == 0x8b)
+			{
+				if(bgzf_header(m, n, bs))
+				{
+					madvise((void*)m, n, MADV_RANDOM);	// only the headers and trailers are read
+					total = 0;
+					for(size_t c = 0; c < n; c += bs)
+					{
+						if(!bgzf_header(m + c, n - c, bs))
+						{
+							fprintf(stderr, "Invalid BGZF block at offset %zu\n", c);
+							exit(1);
+						}
+						total += bgzf_isize(m + c, bs);
+					}
+				}
+				else total = gzip_isize(m, n);
+			}
+			munmap((void*)m, n);
+		}
+		::close(f);
+		return total;
+	}
+
+	// same contract as ParallelFASTQ::fill_block: returns the number of records, 0 at the end of my partition
+	size_t fill_block(vector<SeqView> & ids, vector<SeqView> & seqs, vector<SeqView> & quals, size_t maxMemoryUsed)
+	{
+		size_t memUsed = 0, avgMemPerRead = 0;
+		size_t records_read = 0;
+		ids.clear();
+		seqs.clear();
+		quals.clear();
+		joined.clear();
+
+		if(mode == BGZF)	// the views of the previous block are gone, inflate the next one
+		{
+			compact();
+			while(!final && end_read == NOPOS && avail - pos < maxMemoryUsed)
+				inflate_blocks(maxMemoryUsed - (avail - pos));
+		}
+
+		SeqView id, seq, qual;
+		while(memUsed + avgMemPerRead < maxMemoryUsed)
+		{
+			if(mode == GZIP && pos >= end_read && (records_read > 0 || !next_chunk()))
+				break;
+
+			int got = fasta ? next_fasta(id, seq) : next_fastq(id, seq, qual);
+			if(got == MORE && records_read == 0 && mode == BGZF)
+			{
+				inflate_blocks(maxMemoryUsed);	// a record longer than what is inflated
+				continue;
+			}
+			if(got != RECORD)
+				break;
+
+			ids.push_back(id);
+			seqs.push_back(seq);
+			quals.push_back(fasta ? SeqView() : qual);
+			records_read++;
+			nrecords++;
+			memUsed += id.length() + seq.length() + qual.length() + 3 * sizeof(char*);
+			avgMemPerRead = memUsed / records_read;
+		}
+		return records_read;
+	}
+
+	int64_t getTotalRecordsRead() { return nrecords; }
+
+private:
+	enum Mode { PLAIN, BGZF, GZIP };
+	enum Status { RECORD, END, MORE };	// MORE: the record goes past the text inflated so far
+	static const size_t NOPOS = (size_t)-1;
+
+	// next = first byte after the line starting at p, false if its end is not inflated yet
+	bool line_end(size_t p, size_t& next) const
+	{
+		if(p < avail)
+		{
+			const char* nl = (const char*) memchr(buf + p, '\n', avail - p);
+			if(nl)
+			{
+				next = (nl - buf) + 1;
+				return true;
+			}
+		}
+		next = avail;
+		return final;
+	}
+
+	// length of the line starting at p, without "\n" or "\r\n"
+	size_t line_length(size_t p, size_t next) const
+	{
+		size_t e = next;
+		while(e > p && (buf[e-1] == '\n' || buf[e-1] == '\r')) --e;
+		return e - p;
+	}
+
+	// first record starting on a line after the one holding offset: for FASTQ a '@' line followed by a '+'
+	// line two lines later (a quality line can start with '@' but is followed by a header and a sequence).
+	// Only the text from offset on is read, so two threads on both sides of a boundary agree. NOPOS if more text is needed
+	size_t resync(size_t offset) const
+	{
+		size_t p, l1, l2;
+		if(!line_end(offset, p)) return NOPOS;
+		while(p < avail)
+		{
+			if(fasta)
+			{
+				if(buf[p] == '>') return p;
+			}
+			else if(buf[p] == '@')
+			{
+				if(!line_end(p, l1) || !line_end(l1, l2)) return NOPOS;
+				if(l2 >= avail || buf[l2] == '+') return p;
+			}
+			if(!line_end(p, p)) return NOPOS;
+		}
+		return final ? avail : NOPOS;
+	}
+
+	SeqView name_view(size_t p, size_t next) const
+	{
+		size_t n = line_length(p, next);
+		size_t cut = 0;
+		while(cut < n && buf[p + cut] != ' ' && buf[p + cut] != '\t') ++cut;	// drop the comment
+		return SeqView(buf + p, cut);
+	}
+
+	int next_fastq(SeqView& id, SeqView& seq, SeqView& qual)
+	{
+		while(pos < end_read && pos < avail && (buf[pos] == '\n' || buf[pos] == '\r')) ++pos;	// blank lines
+		if(pos >= end_read) return END;
+		if(pos >= avail) return final ? END : MORE;
+		if(buf[pos] != '@')
+			fprintf(stderr, "Invalid FASTQ at offset %zu, expected read name (@)\n", pos);
+
+		size_t l1, l2, l3, l4;
+		if(!line_end(pos, l1) || !line_end(l1, l2) || !line_end(l2, l3) || !line_end(l3, l4))
+			return MORE;
+		if(l2 < avail && buf[l2] != '+')
+			fprintf(stderr, "Invalid FASTQ at offset %zu, expected '+'\n", l2);
+
+		id   = name_view(pos, l1);
+		seq  = SeqView(buf + l1, line_length(l1, l2));
+		qual = SeqView(buf + l3, line_length(l3, l4));
+		pos  = l4;
+		return RECORD;
+	}
+
+	int next_fasta(SeqView& id, SeqView& seq)
+	{
+		while(pos < end_read && pos < avail && buf[pos] != '>')
+			if(!line_end(pos, pos)) return MORE;
+		if(pos >= end_read) return END;
+		if(pos >= avail) return final ? END : MORE;
+
+		size_t l1;
+		if(!line_end(pos, l1)) return MORE;
+
+		// sequence lines up to the next header
+		size_t p = l1, nlines = 0, firstlen = 0;
+		while(p < avail && buf[p] != '>')
+		{
+			size_t next;
+			if(!line_end(p, next)) return MORE;
+			if(nlines++ == 0) firstlen = line_length(p, next);
+			p = next;
+		}
+		if(p >= avail && !final) return MORE;	// the next line could still be sequence
+
+		id = name_view(pos, l1);
+		if(nlines <= 1)
+			seq = SeqView(buf + l1, firstlen);
+		else	// multi-line FASTA: the only copy
+		{
+			joined.emplace_back();
+			string& s = joined.back();
+			for(size_t q = l1; q < p; )
+			{
+				size_t next;
+				line_end(q, next);
+				s.append(buf + q, line_length(q, next));
+				q = next;
+			}
+			seq = SeqView(s.data(), s.length());
+		}
+		pos = p;
+		return RECORD;
+	}
+
+	// BGZF: my partition is the blocks starting in my byte range of the compressed file, text holds
+	// their inflated content from pos on; my records are the ones starting in it (same rule as plain files)
+	void open_bgzf()
+	{
+		mode = BGZF;
+		size_t block = (fsize + THREADS - 1) / THREADS;
+		cnext = bgzf_sync(map, fsize, std::min(block * MYTHREAD, fsize));
+		cend  = bgzf_sync(map, fsize, std::min(block * (MYTHREAD + 1), fsize));
+		started = (cnext == 0);
+		owned_end = end_read = NOPOS;
+		pos = 0;
+		buf = text.data();
+		avail = 0;
+		final = (cnext >= fsize);
+
+		// FASTA or FASTQ, from the first block of the file
+		size_t bs;
+		if(bgzf_header(map, fsize, bs))
+		{
+			std::string first(bgzf_isize(map, bs), '\0');
+			bgzf_inflate(map, bs, &first[0]);
+			fasta = (!first.empty() && first[0] == '>');
+		}
+		if(cnext < cend)
+			madvise((void*)(map + (cnext & ~(size_t)(getpagesize() - 1))), cend - (cnext & ~(size_t)(getpagesize() - 1)), MADV_SEQUENTIAL);
+	}
+
+	// append the next blocks, about want bytes of text, inflated in parallel outside of a parallel region
+	void inflate_blocks(size_t want)
+	{
+		if(final) return;
+
+		vector<size_t> offsets, outoffsets;
+		size_t base = text.size(), total = 0, c = cnext, bs;
+		while(c < fsize && (total < want || offsets.empty()))
+		{
+			if(c >= cend && owned_end == NOPOS) owned_end = base + total;
+			if(!bgzf_header(map + c, fsize - c, bs))
+			{
+				fprintf(stderr, "Invalid BGZF block at offset %zu\n", c);
+				exit(1);
+			}
+			offsets.push_back(c);
+			outoffsets.push_back(base + total);
+			total += bgzf_isize(map + c, bs);
+			c += bs;
+		}
+		if(c >= cend && owned_end == NOPOS) owned_end = base + total;
+
+		text.resize(base + total);
+		#pragma omp parallel for schedule(dynamic) if(!omp_in_parallel())
+		for(size_t b = 0; b < offsets.size(); ++b)
+		{
+			size_t blocksize;
+			bgzf_header(map + offsets[b], fsize - offsets[b], blocksize);
+			bgzf_inflate(map + offsets[b], blocksize, &text[outoffsets[b]]);
+		}
+		cnext = c;
+		buf = text.data();
+		avail = text.size();
+		final = (cnext >= fsize);
+
+		// my first and last records, once there is enough text to find them
+		if(!started)
+		{
+			size_t s = resync(0);
+			if(s == NOPOS) return inflate_blocks(want);
+			pos = s;
+			started = true;
+		}
+		if(owned_end != NOPOS && end_read == NOPOS)
+		{
+			size_t e = resync(owned_end);
+			if(e == NOPOS) return inflate_blocks(want);
+			end_read = e;
+		}
+	}
+
+	// drop the text before pos
+	void compact()
+	{
+		if(!started || pos == 0) return;
+		text.erase(0, pos);
+		if(owned_end != NOPOS) owned_end = (owned_end > pos) ? owned_end - pos : 0;
+		if(end_read != NOPOS) end_read = (end_read > pos) ? end_read - pos : 0;
+		pos = 0;
+		buf = text.data();
+		avail = text.size();
+	}
+
+	// plain gzip: take the next chunk of records from the pipe
+	bool next_chunk()
+	{
+		chunk = pipe->next();
+		if(!chunk) return false;
+		buf = chunk->data();
+		avail = end_read = chunk->size();
+		final = true;
+		pos = 0;
+		size_t p = 0;
+		while(p < avail && (buf[p] == '\n' || buf[p] == '\r')) ++p;
+		fasta = (p < avail && buf[p] == '>');
+		return true;
+	}
+
+	int fd;
+	const char* map;
+	size_t fsize;
+	Mode mode;
+
+	// text being parsed: the mapping, inflated BGZF blocks or a chunk of the gzip pipe
+	const char* buf;
+	size_t avail;
+	bool final;			// nothing comes after buf[avail-1]
+	size_t pos;			// next record of my partition
+	size_t end_read;	// first byte after my partition, NOPOS if not inflated yet
+	bool fasta;
+	int64_t nrecords;
+	deque<string> joined;	// multi-line FASTA sequences of the current block
+
+	// BGZF
+	string text;
+	size_t cnext;		// next block to inflate
+	size_t cend;		// first block after my partition
+	size_t owned_end;	// end of the text of my blocks
+	bool started;		// pos is my first record
+
+	// plain gzip
+	std::shared_ptr<GzipPipe> pipe;
+	std::shared_ptr<std::string> chunk;
+};
+
+#endif
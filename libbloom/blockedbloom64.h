@@ -0,0 +1,129 @@
+#ifndef _BLOCKEDBLOOM64_H
+#define _BLOCKEDBLOOM64_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <atomic>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * Split block bloom filter (as in Impala/Parquet):
+ *  - the filter is an array of 256-bit blocks (8 x 32-bit words, 32-byte aligned),
+ *    a key only touches the one block picked by the high bits of its 64-bit hash
+ *  - the low 32 bits of the hash, times 8 odd salts, set one bit in each word of the block:
+ *    no other hash function is computed
+ *  - words are updated with atomic fetch-or, so concurrent inserts never lose bits;
+ *    check_add tells whether all 8 bits were already set. Two threads inserting the
+ *    same new key at the same time may both see it as new (never the other way around)
+ *  - with AVX2 the 8 probe masks are built and tested in one register
+ */
+
+#define BLOCKEDBLOOM_WORDS 8
+#define BLOCKEDBLOOM_PREFETCH 8	// keys in flight in check_add_batch
+
+class BlockedBloom64
+{
+public:
+	// entries: expected distinct keys, error: target false positive rate
+	BlockedBloom64(int64_t entries, double error)
+	{
+		// bits per key of a standard filter with 8 probes, plus some slack for the blocking
+		double bpe = -(double)BLOCKEDBLOOM_WORDS / log(1.0 - pow(error, 1.0 / BLOCKEDBLOOM_WORDS)) * 1.15;
+		nblocks = (uint64_t)ceil((double)(entries > 0 ? entries : 1) * bpe / 256.0);
+		if(nblocks == 0) nblocks = 1;
+
+		if(posix_memalign((void**)&blocks, 64, nblocks * sizeof(Block)) != 0)
+		{
+			fprintf(stderr, "Could not allocate a bloom filter of %lu blocks\n", (unsigned long)nblocks);
+			exit(1);
+		}
+		#pragma omp parallel for
+		for(uint64_t b = 0; b < nblocks; ++b)
+			for(int w = 0; w < BLOCKEDBLOOM_WORDS; ++w)
+				blocks[b].words[w].store(0, std::memory_order_relaxed);
+	}
+
+	~BlockedBloom64()
+	{
+		free(blocks);
+	}
+
+	// true if the key was (probably) already in the filter, the key is in the filter afterwards
+	bool check_add(uint64_t hash)
+	{
+		Block& block = blocks[blockof(hash)];
+		uint32_t mask[BLOCKEDBLOOM_WORDS];
+		if(contains(block, (uint32_t)hash, mask))
+			return true;
+
+		bool present = true;
+		for(int w = 0; w < BLOCKEDBLOOM_WORDS; ++w)
+		{
+			uint32_t old = block.words[w].fetch_or(mask[w], std::memory_order_relaxed);
+			present &= ((old & mask[w]) == mask[w]);
+		}
+		return present;
+	}
+
+	// present[i] = check_add(hashes[i]), with the blocks of the next keys prefetched
+	void check_add_batch(const uint64_t* hashes, size_t n, uint8_t* present)
+	{
+		for(size_t i = 0; i < n && i < BLOCKEDBLOOM_PREFETCH; ++i)
+			__builtin_prefetch(&blocks[blockof(hashes[i])], 1);
+		for(size_t i = 0; i < n; ++i)
+		{
+			if(i + BLOCKEDBLOOM_PREFETCH < n)
+				__builtin_prefetch(&blocks[blockof(hashes[i + BLOCKEDBLOOM_PREFETCH])], 1);
+			present[i] = check_add(hashes[i]);
+		}
+	}
+
+	int64_t bits() const { return nblocks * 256; }
+	int hashes() const { return BLOCKEDBLOOM_WORDS; }
+
+private:
+	struct alignas(32) Block
+	{
+		std::atomic<uint32_t> words[BLOCKEDBLOOM_WORDS];
+	};
+
+	uint64_t blockof(uint64_t hash) const
+	{
+		return (uint64_t)(((unsigned __int128)hash * nblocks) >> 64);	// high bits of the hash
+	}
+
+	// fills mask[] with the bit of the key in every word, true if all of them are set
+	static bool contains(const Block& block, uint32_t key, uint32_t* mask)
+	{
+	#ifdef __AVX2__
+		const __m256i salts = _mm256_setr_epi32(0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+			0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U);
+		__m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(key), salts), 27);
+		__m256i m = _mm256_sllv_epi32(_mm256_set1_epi32(1), bits);
+		_mm256_storeu_si256((__m256i*)mask, m);
+		// the words are only read here, a concurrent fetch_or can just add bits
+		__m256i b = _mm256_load_si256((const __m256i*)&block);
+		return _mm256_testc_si256(b, m);
+	#else
+		static const uint32_t salts[BLOCKEDBLOOM_WORDS] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+			0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+		bool all = true;
+		for(int w = 0; w < BLOCKEDBLOOM_WORDS; ++w)
+		{
+			mask[w] = 1U << ((key * salts[w]) >> 27);
+			all &= ((block.words[w].load(std::memory_order_relaxed) & mask[w]) == mask[w]);
+		}
+		return all;
+	#endif
+	}
+
+	Block* blocks;
+	uint64_t nblocks;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include "../include/common/common.h"
 #include "../include/common/transpose.h"
 #include <algorithm>
+#include <atomic>
 #include <numeric>
 #include <vector>
 #include <fstream>
@@ -478,6 +479,154 @@ CSC<IT,NT>::CSC(vector<tuple<IT,IT,NT>> & tuple, IT m, IT n, AddOperation addop,
 	MergeDuplicates(addop, needsort);
 }
 
+//! this version takes the tuples (row, col, value) in the per-thread buckets they were made in, there is no concatenated copy:
+//! - all the tuples with the same col have to be contiguous and in the same bucket (one sequence per thread, as SeqToTuples makes them)
+//! - the buckets are counted and scattered in parallel, and each one is freed once it is scattered
+//! - without transpose, a column comes from one bucket and keeps its order: duplicates are merged by MergeDuplicates, as above
+//! - with transpose the output is n x m and tuple (i,j,v) goes to row j of column i: this is the transpose of the m x n matrix,
+//!   built without the m x n one. Duplicates are merged with addop inside the buckets, before the scatter, and rowids are sorted
+//!   within each column afterwards, so the result does not depend on the number of threads
+//! - values are converted from VT to NT: the buckets can carry wider values than the matrix keeps
+template <class IT, class NT>
+template <typename VT, typename AddOperation>
+CSC<IT,NT>::CSC(vector<vector<tuple<IT,IT,VT>>> & buckets, IT m, IT n, AddOperation addop, bool transpose): rows(transpose? n : m), cols(transpose? m : n)
+{
+	const IT minHashTableSize = 16;
+	const IT hashScale = 107;
+	int nbuckets = buckets.size();
+	IT nnzBeforeMerge = 0;
+	for(int t = 0; t < nbuckets; ++t)
+		nnzBeforeMerge += buckets[t].size();
+
+	// with transpose, merge duplicates in place, segment by segment (a segment has the tuples of one col), first occurrences keep their order
+	if(transpose)
+	{
+	#pragma omp parallel for schedule(dynamic)
+		for(int t = 0; t < nbuckets; ++t)
+		{
+			vector<tuple<IT,IT,VT>> & bucket = buckets[t];
+			std::vector<pair<IT,size_t>> globalHashVec;	// row id and where its tuple is now
+			size_t out = 0;
+			for(size_t beg = 0, end = 0; beg < bucket.size(); beg = end)
+			{
+				IT cid = get<1>(bucket[beg]);
+				while(end < bucket.size() && get<1>(bucket[end]) == cid)
+					++end;
+
+				size_t ht_size = minHashTableSize;
+				while(ht_size < end - beg) //ht_size is set as 2^n
+				{
+					ht_size <<= 1;
+				}
+				globalHashVec.assign(ht_size, make_pair((IT) -1, (size_t) 0));
+
+				for(size_t j = beg; j < end; ++j)
+				{
+					IT key = get<0>(bucket[j]);
+					IT hash = (key*hashScale) & (ht_size-1);
+					while(globalHashVec[hash].first != key && globalHashVec[hash].first != (IT) -1)
+					{
+						hash = (hash+1) & (ht_size-1);
+					}
+					if(globalHashVec[hash].first == key)	// duplicate, out <= j so bucket[j] is still there
+					{
+						VT & merged = get<2>(bucket[globalHashVec[hash].second]);
+						merged = addop(get<2>(bucket[j]), merged);
+					}
+					else
+					{
+						globalHashVec[hash] = make_pair(key, out);
+						bucket[out++] = bucket[j];
+					}
+				}
+			}
+			bucket.resize(out);
+		}
+	}
+
+	nnz = 0;
+	for(int t = 0; t < nbuckets; ++t)
+		nnz += buckets[t].size();
+
+	colptr = new IT[cols+1]();
+	rowids = new IT[nnz];
+	values = new NT[nnz];
+
+	std::atomic<IT> * work = new std::atomic<IT>[cols];	// column counts, then insertion points
+#pragma omp parallel for
+	for(IT i = 0; i < cols; ++i)
+	{
+		work[i].store(0, std::memory_order_relaxed);
+	}
+
+#pragma omp parallel for schedule(dynamic)
+	for(int t = 0; t < nbuckets; ++t)
+	{
+		for(auto & tp : buckets[t])
+		{
+			work[transpose? get<0>(tp) : get<1>(tp)].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	for(IT i = 0; i < cols; ++i)
+	{
+		colptr[i] = work[i].load(std::memory_order_relaxed);
+	}
+	colptr[cols] = CumulativeSum (colptr, cols);
+
+#pragma omp parallel for
+	for(IT i = 0; i < cols; ++i)
+	{
+		work[i].store(colptr[i], std::memory_order_relaxed);
+	}
+
+	// without transpose a column comes from a single bucket, so its tuples keep their order
+#pragma omp parallel for schedule(dynamic)
+	for(int t = 0; t < nbuckets; ++t)
+	{
+		for(auto & tp : buckets[t])
+		{
+			IT rid = transpose? get<1>(tp) : get<0>(tp);
+			IT cid = transpose? get<0>(tp) : get<1>(tp);
+			IT loc = work[cid].fetch_add(1, std::memory_order_relaxed);
+			rowids[loc] = rid;
+			values[loc] = get<2>(tp);
+		}
+		vector<tuple<IT,IT,VT>>().swap(buckets[t]);	// remove memory of the bucket
+	}
+	delete [] work;
+
+	if(!transpose)
+	{
+		MergeDuplicates(addop, false);
+	}
+	else
+	{
+		IT nnzAfterMerge = nnz;
+		printLog(nnzBeforeMerge);
+		printLog(nnzAfterMerge);
+
+	#pragma omp parallel
+		{
+			vector<pair<IT,NT>> tosort;
+		#pragma omp for schedule(dynamic)
+			for(IT i = 0; i < cols; ++i)
+			{
+				tosort.clear();
+				for(IT j = colptr[i]; j < colptr[i+1]; ++j)
+				{
+					tosort.push_back(make_pair(rowids[j], values[j]));
+				}
+				sort(tosort.begin(), tosort.end());	// row ids are unique after the merge
+				for(IT j = colptr[i]; j < colptr[i+1]; ++j)
+				{
+					rowids[j] = tosort[j-colptr[i]].first;
+					values[j] = tosort[j-colptr[i]].second;
+				}
+			}
+		}
+	}
+}
+
 // Construct a Csc object from parallel arrays
 template <class IT, class NT>
 CSC<IT,NT>::CSC(IT * ri, IT * ci, NT * val, IT mynnz, IT m, IT n):nnz(mynnz),rows(m),cols(n)
@@ -40,10 +40,12 @@
 
 #include "../kmercode/hash_funcs.h"
 #include "../kmercode/Kmer.hpp"
+#include "../kmercode/KmerIterator.hpp"
 #include "../kmercode/Buffer.h"
 #include "../kmercode/common.h"
 #include "../kmercode/fq_reader.h"
 #include "../kmercode/ParallelFASTQ.h"
+#include "../kmercode/MappedFASTQ.h"
 #include "../kmercode/bound.hpp"
 
 #include "../include/common/utility.h"
@@ -53,220 +55,169 @@
 #include "../include/common/IO.h"
 #include "../include/overlap.hpp"
 #include "../include/align.hpp"
+#include "../include/mphf.hpp"
+#include "../include/readstore.hpp"
 
 #define LSIZE 16000
 #define ITERS 10
 
-#define KMERINDEX uint32_t		
-// #define KMERINDEX uint64_t 	// Uncomment to for large genomes and comment out line 60
-  
-using namespace std;
-
-int main (int argc, char *argv[]) {
-	//
-	// Program name and purpose
-	//
-	cxxopts::Options options("BELLA", "Long Read to Long Read Aligner and Overlapper");
+#define INDEX32_MAXTEXT ((size_t)1 << 32)	// bytes of input text up to which 32-bit indices are enough
 
-	//
-	// Setup the input files
-	//
-	options.add_options()
-	("f, fastq", "List of Fastq(s) (required)", 	cxxopts::value<std::string>())
-	("o, output", "Output Filename (required)", 	cxxopts::value<std::string>())
-	("k, kmer", "K-mer Length", 	 	cxxopts::value<int>()->default_value("17"))
-	("x, xdrop", "SeqAn X-Drop", 		cxxopts::value<int>()->default_value("7"))
-	("e, error", "Error Rate", 			cxxopts::value<double>()->default_value("0.15"))
-	("estimate", "Estimate Error Rate from Data", 			cxxopts::value<bool>()->default_value("false"))
-	("c, chunks", "Size of Chunks for Reference Genome", 			cxxopts::value<int>()->default_value("100000"))
-	("skip-alignment", "Overlap Only", 	cxxopts::value<bool>()->default_value("false"))
-	("m, memory", "Total RAM of the System in MB", 			cxxopts::value<int>()->default_value("8000"))
-	("score-deviation", "Deviation from the Mean Alignment Score [0,1]", 	cxxopts::value<double>()->default_value("0.1"))
-	("b, bin-size", "Bin Size for Binning Algorithm", 		cxxopts::value<int>()->default_value("500"))
-	("paf", "Output in PAF format", 	cxxopts::value<bool>()->default_value("false"))
-	("g, gpus", "GPUs Available", 		cxxopts::value<int>()->default_value("1")) // this must work only if compiled with bella-gpu
-	("split-count", "K-mer Counting Split Count", 			cxxopts::value<int>()->default_value("1"))
-	("hopc", "Use HOPC representation", cxxopts::value<bool>()->default_value("false"))
-	("w, window", "Window Size for Minimizer Selection", 	cxxopts::value<int>()->default_value("0"))
-	("s, syncmer", "Enable Syncmer Selection", 				cxxopts::value<bool>()->default_value("false"))
-	("u, upper-freq", "K-mer Frequency Upper Bound", 		cxxopts::value<int>()->default_value("8"))
-	("l, lower-freq", "K-mer Frequency Lower Bound", 		cxxopts::value<int>()->default_value("2"))
-	("h, help", "Usage")
-	;
+using namespace std;
 
-	auto result = options.parse(argc, argv);
+/*
+ K-mer ids of a batch of k-mers, found[i] tells whether seqkmers[i] is a reliable k-mer.
+ DictT is the CuckooDict from counting or its frozen copy (--mphf), see include/mphf.hpp
+ */
+template <typename KmerT, typename IT>
+void LookupKmers(const CuckooDict<KmerT, IT>& dict, const vector<KmerT>& seqkmers, vector<IT>& ids, vector<uint8_t>& found)
+{
+	for(size_t i = 0; i < seqkmers.size(); ++i)
+		found[i] = dict.find(seqkmers[i], ids[i]);
+}
 
-    if (result.count("help"))
-    {
-      std::cout << options.help() << std::endl;
-      exit(0);
-    }
+template <typename KmerT, typename IT>
+void LookupKmers(const FrozenKmerDict<KmerT, IT>& dict, const vector<KmerT>& seqkmers, vector<IT>& ids, vector<uint8_t>& found)
+{
+	dict.findBatch(seqkmers.data(), seqkmers.size(), ids.data(), found.data());
+}
 
-	char *inputfofn = NULL;	
-	if(result.count("fastq")) inputfofn = strdup(result["fastq"].as<std::string>().c_str());
-	else
+/*
+ Append a (kmer_id, seqid, position) tuple for every reliable k-mer (or minimizer) of seq,
+ shared by the read and the reference parsing
+ */
+template <typename KmerT, typename IT, typename DictT>
+void SeqToTuples(const char* seq, size_t len, IT seqid, const DictT& dict, const BELLApars& bpars,
+	vector<tuple<IT, IT, unsigned int>>& tuples)
+{
+	vector<KmerT> seqkmers;		// canonical (or HOPC) k-mers
+	vector<int> seqpos;			// their position in the sequence (windows with N's are skipped)
+
+	KmerIterator<KmerT> kmers(seq, len, bpars.kmerSize);
+	while(kmers.next())
 	{
-      std::cout << options.help() << std::endl;
-      exit(0);		
+		// remember to use only ::rep() when building kmerdict as well
+		if(bpars.useHOPC && !bpars.useMinimizer)
+			seqkmers.emplace_back(kmers.forward().hopc());
+		else
+			seqkmers.emplace_back(kmers.rep());
+		seqpos.push_back(kmers.pos());
 	}
 
-	char *OutputFile = NULL;	
-	if(result.count("output"))
+	if(bpars.useMinimizer)
 	{
-		char* line1 = strdup(result["output"].as<std::string>().c_str());
-		char* line2 = strdup(".out");
+		std::vector< int > seqminimizers;    // <index_in_seqkmers>
+		getMinimizers(bpars.windowLen, seqkmers, seqminimizers);
 
-		unsigned int len1 = strlen(line1);
-		unsigned int len2 = strlen(line2);
+		for(size_t m = 0; m < seqminimizers.size(); ++m)	// minimizers are increasing, compact in place
+		{
+			seqkmers[m] = seqkmers[seqminimizers[m]];
+			seqpos[m] = seqpos[seqminimizers[m]];
+		}
+		seqkmers.resize(seqminimizers.size());
+		seqpos.resize(seqminimizers.size());
+	}
 
-		OutputFile = (char*)malloc(len1 + len2 + 1);
-		if (!OutputFile) abort();
+	vector<IT> ids(seqkmers.size());	// kmer_id
+	vector<uint8_t> found(seqkmers.size());
+	LookupKmers(dict, seqkmers, ids, found);
 
-		memcpy(OutputFile,  line1, len1);
-		memcpy(OutputFile + len1,  line2, len2);
-		OutputFile[len1 + len2] = '\0';
-
-		delete line1, line2;
-		
-		remove(OutputFile);
-	}
-	else
+	for(size_t m = 0; m < seqkmers.size(); ++m)
 	{
-      std::cout << options.help() << std::endl;
-      exit(0);		
+		if(found[m])
+			tuples.emplace_back(std::make_tuple(ids[m], seqid, seqpos[m]));	// transtuples.push_back(col_id,row_id,kmerpos)
 	}
+}
 
-	BELLApars bpars;	
+/*
+ Sparse matrices and overlap detection, instantiated once per width of the k-mer positions kept in the matrices:
+ RPT for the reads and CPT for the reference chunks, uint16_t unless a sequence is longer than 65,535 bases.
+ The tuples always carry 32-bit positions, they fit in the padding of the tuple
+ */
+template <typename RPT, typename CPT, typename IT>
+void OverlapDetection(vector<vector<tuple<IT, IT, unsigned int>>>& alltranstuples, vector<vector<tuple<IT, IT, unsigned int>>>& allreferencetuples,
+	IT nkmer, IT numReads, IT numChunks, const ReadStore& reads, const ReadStore& refreads, BELLApars& bpars, char* OutputFile, double ratiophi)
+{
+	// ====================== //
+	// Sparse Matrix Creation //
+	// ====================== //
+	
+	double matcreat = omp_get_wtime();
+	// the (kmer, read) tuples give the read x kmer matrix directly: the kmer x read one was only there to be transposed
+	// the per-thread tuples are scattered in place and freed, they are not concatenated first
+	CSC<IT, RPT> spmat(alltranstuples, nkmer, numReads,
+							[] (const unsigned int& p1, const unsigned int& p2) 
+							{
+								return p1;
+							}, true);	// transpose: the read x kmer matrix, rowids sorted within each column
 
-	bpars.kmerSize 	= result["kmer"].as<int>();
-	bpars.xDrop 	= result["xdrop"].as<int>();
-	bpars.errorRate = result["error"].as<double>();
-	bpars.chunkSize = result["chunks"].as<int>();
+	std::string SparseMatrixCreationTime = std::to_string(omp_get_wtime() - matcreat) + " seconds";
+	printLog(SparseMatrixCreationTime);
 
-	bpars.estimateErr 	= result["estimate"].as<bool>();
-	bpars.skipAlignment = result["skip-alignment"].as<bool>();
-	bpars.totalMemory 	= result["memory"].as<int>();
+	double createrefmat = omp_get_wtime();
 
-	#ifdef LINUX || OSX // in include/overlap.hpp
-		bpars.userDefMem = false;
-	#endif
+	CSC<IT, CPT> refmat(allreferencetuples, nkmer, numChunks,
+							[](const unsigned int& p1, const unsigned int& p2)
+							{
+								return p1;
+							}, false);
 
-	bpars.deltaChernoff = result["score-deviation"].as<double>();
-	if(bpars.deltaChernoff > 1.0 || bpars.deltaChernoff < 0.0)
-	{
-      std::cout << options.help() << std::endl;
-      exit(0);		
-	}
+	std::string RefMatTime = std::to_string(omp_get_wtime() - createrefmat) + " seconds";
+	printLog(RefMatTime);
 
-	bpars.binSize 	 = result["bin-size"].as<int>();
-	bpars.outputPaf	 = result["paf"].as<bool>();
-	bpars.numGPU 	 = result["gpus"].as<int>();
-	bpars.SplitCount = result["split-count"].as<int>();
-	bpars.useHOPC	 = result["hopc"].as<bool>();
+	// ==================================================== //
+	// Sparse Matrix Multiplication (aka Overlap Detection) //
+	// ==================================================== //
+		
+	spmatVal_ getvaluetype;
+	HashSpGEMM(
+		spmat, refmat, 
+		// n-th k-mer positions on read i and on read j
+	    [&bpars, &reads, &refreads] (const unsigned int& begpH, const unsigned int& begpV, 
+	        const IT& id1, const IT& id2)
+		{
+			spmatVal_ value; // this is now just count and a few diagonal bins, no heap allocation
 
-	bpars.windowLen  = result["window"].as<int>();
-	if(bpars.windowLen != 0)
-		bpars.useMinimizer = true;
+			// GG: function in chain.h
+			multiop(value, reads, id1, refreads, id2, begpH, begpV, bpars.kmerSize);
 
-	bpars.useSyncmer = result["syncmer"].as<bool>();
-	if(bpars.useSyncmer)
-		bpars.useMinimizer = false;
+			return value;
+		},
+	    [&bpars] (spmatVal_& m1, spmatVal_& m2)
+		{
+			// m1 is the new product, m2 what has been accumulated so far for this pair (see LocalSpGEMM)
+			// GG: function in chain.h
+			chainop(m1, m2, bpars.binSize);
 
-	int reliableUpperBound	= result["upper-freq"].as<int>();	
-	int reliableLowerBound	= result["lower-freq"].as<int>(); 
+			return m2;
+		},
+	    reads, refreads, getvaluetype, OutputFile, bpars, ratiophi);
+}
 
+/*
+ Everything after option parsing, instantiated once per k-mer type and index width:
+ KmerT is Kmer32 (one 64-bit word) for k <= 32 and Kmer64 (two words) for k <= 64,
+ IT (k-mer ids, read ids, nonzero counts of the matrices) is uint32_t or uint64_t
+ */
+template <typename KmerT, typename IT>
+int RunBELLA(BELLApars& bpars, vector<filedata>& allfiles, char* OutputFile, int reliableLowerBound, int reliableUpperBound)
+{
 	// ================ //
 	//   Declarations   //
 	// ================ //
 
-	vector<filedata> allfiles = GetFiles(inputfofn);
-	std::string all_inputs_gerbil = std::string(inputfofn); 
 	double ratiophi;
-	Kmer::set_k(bpars.kmerSize);
+	KmerT::set_k(bpars.kmerSize);
 	unsigned int upperlimit = 10000000; // in bytes
 	Kmers kmervect;
-	vector<string> seqs;
-	vector<string> quals;
-	vector<string> nametags;
-	readVector_ reads;
-	readVector_ refreads;
+	vector<SeqView> seqs;
+	vector<SeqView> quals;
+	vector<SeqView> nametags;
+	ReadStore reads;		// 2-bit packed, indexed by read id
+	ReadStore refreads;		// reference chunks, indexed by chunk id
 	Kmers kmersfromreads;
 
 	// vector<tuple<unsigned int, unsigned int, unsigned short int>> occurrences;	// 32 bit, 32 bit, 16 bit (read, kmer, position)
-	vector<tuple<KMERINDEX, KMERINDEX, unsigned short int>> transtuples;	// 32 bit, 32 bit, 16 bit (kmer, read, position)
-	vector<tuple<KMERINDEX, KMERINDEX, unsigned short int>> referencetuples; //32 bit, 32 bit, 16 bit (kmer, chunk, postion)
-
-	// ================== //
-	// Parameters Summary //
-	// ================== //
-    
-#ifdef PRINT
-    printLog(OutputFile);
-
-    std::string kmerSize = std::to_string(bpars.kmerSize);
-    printLog(kmerSize);
-
-    std::string GPUs = "DISABLED";
-    printLog(GPUs);
-
-	std::string ChunkSize = std::to_string(bpars.chunkSize);
-	printLog(ChunkSize);
-
-	std::string UserDefinedMemory = std::to_string(bpars.totalMemory) + " MB";
-	printLog(UserDefinedMemory);
-
-    std::string OutputPAF = std::to_string(bpars.outputPaf);
-    printLog(OutputPAF);
-
-    std::string BinSize = std::to_string(bpars.binSize);
-    printLog(BinSize);
-    
-    std::string DeltaChernoff = std::to_string(bpars.deltaChernoff);
-    printLog(DeltaChernoff);
-
-    std::string RunPairwiseAlignment = std::to_string(!bpars.skipAlignment);
-    printLog(RunPairwiseAlignment);
-
-	if(bpars.useHOPC)
-	{
-		std::string HOPC = "ENABLED";
-		printLog(HOPC);
-	}
-	else 
-	{
-		std::string HOPC = "DISABLED";
-		printLog(HOPC);
-	}
-
-    std::string xDrop = std::to_string(bpars.xDrop);
-    printLog(xDrop);
-
-    std::string KmerSplitCount = std::to_string(bpars.SplitCount);
-    printLog(KmerSplitCount);
-
-	if(bpars.useMinimizer)
-	{
-		std::string useMinimizer = "ENABLED";
-		printLog(useMinimizer);
-		std::string minimizerWindow = std::to_string(bpars.windowLen);
-    	printLog(minimizerWindow);
-	}
- 	else if(bpars.useSyncmer)
-	{
-		std::string useSyncmer = "ENABLED";
-		printLog(useSyncmer);
-		std::string minimizerWindow = "0";
-    	printLog(minimizerWindow);
-	}
-	else
-	{
-		std::string useKmer = "ENABLED";
-		printLog(useKmer);
-		std::string minimizerWindow = "0";
-    	printLog(minimizerWindow);
-	}
-
-#endif
 
 	double all;
 
@@ -282,17 +233,13 @@ int main (int argc, char *argv[]) {
 
 	printLog(numThreads);
 
-	// GG: reads global
-	vector<readVector_> allreads(MAXTHREADS);
-	vector<readVector_> allrefchunks(MAXTHREADS);
-
 	all = omp_get_wtime();
 
 	// ================ //
 	//  K-mer Counting  //
 	// ================ //
 
-	CuckooDict<KMERINDEX> countsreliable;
+	CuckooDict<KmerT, IT> countsreliable;
 
 	if(bpars.useSyncmer)
 	{
@@ -304,12 +251,51 @@ int main (int argc, char *argv[]) {
     	MinimizerCount(allfiles, countsreliable, reliableLowerBound, reliableUpperBound,
             upperlimit, bpars);
     }
+	else if(!bpars.tmpDir.empty() && !bpars.useHOPC)	// a HOPC k-mer doesn't have the minimizer of its k-mer: no binning
+	{
+		DiskCount(allfiles, countsreliable, reliableLowerBound, reliableUpperBound,
+			upperlimit, bpars);
+	}
+	else if(bpars.useSortCount)
+	{
+		SortCount(allfiles, countsreliable, reliableLowerBound, reliableUpperBound,
+			upperlimit, bpars);
+	}
 	else
 	{
     	SplitCount(allfiles, countsreliable, reliableLowerBound, reliableUpperBound,
                upperlimit, bpars);
 	}
 
+	// the reliable set is read-only from now on: optionally freeze it into a minimal perfect hash,
+	// k-mer ids are then reassigned by the MPHF
+	std::unique_ptr<FrozenKmerDict<KmerT, IT>> frozenreliable;
+	if(bpars.useMPHF)
+	{
+		double freezebeg = omp_get_wtime();
+
+		vector<KmerT> reliablekmers;
+		reliablekmers.reserve(countsreliable.size());
+		{
+			auto lt = countsreliable.lock_table();
+			for (const auto &it : lt)
+				reliablekmers.push_back(it.first);
+		}
+		countsreliable.clear();
+
+		frozenreliable.reset(new FrozenKmerDict<KmerT, IT>(reliablekmers));
+		std::vector<KmerT>().swap(reliablekmers);
+
+		std::string MPHFSize = std::to_string((double)frozenreliable->bytes()/(1024 * 1024)) + " MB";
+		printLog(MPHFSize);
+		int MPHFLevels = frozenreliable->numLevels();
+		printLog(MPHFLevels);
+		size_t MPHFFallback = frozenreliable->numFallback();
+		printLog(MPHFFallback);
+		std::string MPHFConstructionTime = std::to_string(omp_get_wtime() - freezebeg) + " seconds";
+		printLog(MPHFConstructionTime);
+	}
+
 	double errorRate;
 
 	if(bpars.useHOPC)
@@ -340,15 +326,15 @@ int main (int argc, char *argv[]) {
 	double parsefastq = omp_get_wtime();
 
 	// vector<vector<tuple<unsigned int, unsigned int, unsigned short int>>> alloccurrences(MAXTHREADS);
-	vector<vector<tuple<KMERINDEX, KMERINDEX, unsigned short int>>> alltranstuples(MAXTHREADS);
+	vector<vector<tuple<IT, IT, unsigned int>>> alltranstuples(MAXTHREADS);
 
-	unsigned int numReads = 0; // numReads needs to be global (not just per file)
+	IT numReads = 0; // numReads needs to be global (not just per file)
 
 	assert(allfiles.size() >= 2);
 
 	for(auto itr=allfiles.begin(); itr!=allfiles.end()-1; itr++)
 	{
-		ParallelFASTQ *pfq = new ParallelFASTQ();
+		MappedFASTQ *pfq = new MappedFASTQ();
 		pfq->open(itr->filename, false, itr->filesize);
 
 		unsigned int fillstatus = 1;
@@ -357,74 +343,18 @@ int main (int argc, char *argv[]) {
 			fillstatus = pfq->fill_block(nametags, seqs, quals, upperlimit);
 			unsigned int nreads = seqs.size();
 
+			// save reads for seeded alignment, read numReads+i is the i-th of the block
+			reads.append(nreads,
+				[&nametags](size_t i) { return SeqView(nametags[i].data() + 1, nametags[i].length() - 1); },	// removing "@"
+				[&seqs](size_t i) { return seqs[i]; });
+
 		#pragma omp parallel for
 			for(int i=0; i<nreads; i++) 
 			{
-				// remember that the last valid position is length()-1
-				int len = seqs[i].length();
-
-				readType_ temp;
-				nametags[i].erase(nametags[i].begin());	// removing "@"
-				temp.nametag = nametags[i];
-				temp.seq = seqs[i];    					// save reads for seeded alignment
-				temp.readid = numReads+i;
-				allreads[MYTHREAD].push_back(temp);
-                
-                if(bpars.useMinimizer)
-                {
-                    vector<Kmer> seqkmers;
-                    std::vector< int > seqminimizers;    // <position_in_read>
-                    for(int j = 0; j <= len - bpars.kmerSize; j++)   // AB: optimize this sliding-window parsing ala HipMer
-                    {
-                        std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-                        Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-                        seqkmers.emplace_back(mykmer);
-                    }
-
-                    getMinimizers(bpars.windowLen, seqkmers, seqminimizers);
-
-                    for(auto minpos: seqminimizers)
-                    {
-                        std::string strminkmer = seqs[i].substr(minpos, bpars.kmerSize);
-                        Kmer myminkmer(strminkmer.c_str(), strminkmer.length());
-                        
-						myminkmer = myminkmer.rep();
-                        
-                        KMERINDEX idx; // kmer_id
-                        auto found = countsreliable.find(myminkmer,idx);
-                        if(found)
-                        {
-                            alltranstuples[MYTHREAD].emplace_back(std::make_tuple(idx, numReads+i, minpos));
-                        }
-                    }
-                }
-                else
-                {
-                    for(int j = 0; j <= len - bpars.kmerSize; j++)
-                    {
-                        std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-                        Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-                        // remember to use only ::rep() when building kmerdict as well
-                        Kmer lexsmall;
-                        if (bpars.useHOPC)
-                        {
-                            lexsmall = mykmer.hopc();
-                        }
-                        else
-                        {
-                            // remember to use only ::rep() when building kmerdict as well
-                            lexsmall = mykmer.rep();
-                        }
-
-                        KMERINDEX idx; // kmer_id
-                        auto found = countsreliable.find(lexsmall,idx);
-                        if(found)
-                        {
-                            //alloccurrences[MYTHREAD].emplace_back(std::make_tuple(numReads+i, idx, j)); // vector<tuple<numReads,kmer_id,kmerpos>>
-                            alltranstuples[MYTHREAD].emplace_back(std::make_tuple(idx, numReads+i, j)); // transtuples.push_back(col_id,row_id,kmerpos)
-                        }
-                    }
-                }
+				if(bpars.useMPHF)
+					SeqToTuples<KmerT, IT>(seqs[i].data(), seqs[i].length(), numReads+i, *frozenreliable, bpars, alltranstuples[MYTHREAD]);
+				else
+					SeqToTuples<KmerT, IT>(seqs[i].data(), seqs[i].length(), numReads+i, countsreliable, bpars, alltranstuples[MYTHREAD]);
 			} // for(int i=0; i<nreads; i++)
 			numReads += nreads;
 		} //while(fillstatus) 
@@ -433,60 +363,44 @@ int main (int argc, char *argv[]) {
 	} // for all files
 
 
-	KMERINDEX readcount = 0;
-	KMERINDEX tuplecount = 0;
+	IT tuplecount = 0;
 
 	for(int t=0; t<MAXTHREADS; ++t)
 	{
-		readcount  += allreads[t].size();
 		tuplecount += alltranstuples[t].size();
 	}
 
 // #define WRITEDATAMATRIX
 #ifdef WRITEDATAMATRIX
-    WriteToDisk(alltranstuples, countsreliable, readcount, tuplecount);
+    WriteToDisk(alltranstuples, countsreliable, (IT)reads.size(), tuplecount);
 #endif
 
-	reads.resize(readcount);
-	//occurrences.resize(tuplecount);
-	transtuples.resize(tuplecount);
-
-	unsigned int readssofar = 0;
-	unsigned int tuplesofar = 0;
-
-	for(int t=0; t<MAXTHREADS; ++t)
-	{
-		copy(allreads[t].begin(), allreads[t].end(), reads.begin()+readssofar);
-		readssofar += allreads[t].size();
-
-		//copy(alloccurrences[t].begin(), alloccurrences[t].end(), occurrences.begin() + tuplesofar);
-		copy(alltranstuples[t].begin(), alltranstuples[t].end(), transtuples.begin() + tuplesofar);
-		tuplesofar += alltranstuples[t].size();
-	}
+	printLog(tuplecount);
 
-	std::sort(reads.begin(), reads.end());	// bool operator in global.h: sort by readid
-
-	std::vector<string>().swap(seqs);		// free memory of seqs  
-	std::vector<string>().swap(quals);		// free memory of quals
-	std::vector<string>().swap(nametags);
+	std::vector<SeqView>().swap(seqs);		// free memory of seqs  
+	std::vector<SeqView>().swap(quals);		// free memory of quals
+	std::vector<SeqView>().swap(nametags);
 
 	std::string fastqParsingTime = std::to_string(omp_get_wtime() - parsefastq) + " seconds";
 	printLog(fastqParsingTime);
 	printLog(numReads);
 
+	std::string ReadStoreSize = std::to_string((double)reads.bytes() / (1024 * 1024)) + " MB";
+	printLog(ReadStoreSize);
+
 	// ======================== //
 	// Reference Genome Parsing //
 	// ======================== //
 
 	double ref_parsing = omp_get_wtime();
 
-	vector<vector<tuple<KMERINDEX, KMERINDEX, unsigned short int>>> allreferencetuples(MAXTHREADS);
+	vector<vector<tuple<IT, IT, unsigned int>>> allreferencetuples(MAXTHREADS);
 
 	auto itr = allfiles.end()-1;
 
-	unsigned int numChunks = 0;
+	IT numChunks = 0;
 
-	ParallelFASTQ *pfq = new ParallelFASTQ();
+	MappedFASTQ *pfq = new MappedFASTQ();
 	pfq->open(itr->filename, false, itr->filesize);
 	
 
@@ -494,258 +408,378 @@ int main (int argc, char *argv[]) {
 	while(fillstatus)
 	{
 		fillstatus = pfq->fill_block(nametags, seqs, quals, upperlimit);
-		std::vector<std::string> chunks;
-		std::vector<std::vector<std::string>> allchunks(MAXTHREADS);
+		std::vector<SeqView> chunks;									// views into the chromosomes of this block
+		std::vector<std::pair<unsigned int, unsigned int>> chunkof;		// chromosome and chunk number of every chunk
 
 		unsigned int numChromosomes = seqs.size();
-		unsigned int nChunks = 0;
 
 		for(unsigned int k = 0; k < numChromosomes; ++k){
 
-			double chrom_read_len = seqs[k].length();
-			nametags[k].erase(nametags[k].begin());	// removing "@"
-
+			size_t chrom_read_len = seqs[k].length();
 			unsigned int numbChunksPerChrom = (chrom_read_len/bpars.chunkSize)+1;
 
-		//#pragma omp parallel for
 			for (unsigned int i = 0; i < numbChunksPerChrom; ++i)
 			{
-				if((i+1) * bpars.chunkSize < chrom_read_len){
-
-					allchunks[MYTHREAD].push_back(seqs[k].substr(i * bpars.chunkSize, bpars.chunkSize));		
-					readType_ temp;
-					temp.nametag = nametags[k] + "_" + std::to_string(i);
-					temp.seq = seqs[k].substr(i * bpars.chunkSize, bpars.chunkSize);    					// save reads for seeded alignment
-					temp.readid = nChunks + i;
-					allrefchunks[MYTHREAD].push_back(temp);
-
-				}
-
-				else{
-					allchunks[MYTHREAD].push_back(seqs[k].substr(i * bpars.chunkSize, chrom_read_len - (i * bpars.chunkSize)));
-					readType_ temp;
-					temp.nametag = nametags[k] + "_" + std::to_string(i);
-					temp.seq = seqs[k].substr(i * bpars.chunkSize, chrom_read_len - (i * bpars.chunkSize));    					// save reads for seeded alignment
-					temp.readid = nChunks + i;
-					allrefchunks[MYTHREAD].push_back(temp);
-				}
-				
+				size_t begin = (size_t)i * bpars.chunkSize;
+				size_t len = ((size_t)(i+1) * bpars.chunkSize < chrom_read_len) ? bpars.chunkSize : chrom_read_len - begin;
+				chunks.push_back(SeqView(seqs[k].data() + begin, len));
+				chunkof.push_back(std::make_pair(k, i));
 			}
-			nChunks += numbChunksPerChrom;
-			
 		}
+		unsigned int nChunks = chunks.size();
 
-
-		KMERINDEX refchunkscount = 0;
-		for(int t=0; t<MAXTHREADS; ++t)
-		{
-			refchunkscount += allchunks[t].size();
-		}
-
-		chunks.resize(refchunkscount);
-		
-		unsigned int refseqssofar = 0;
-		for(int t=0; t<MAXTHREADS; ++t)
-		{
-			copy(allchunks[t].begin(), allchunks[t].end(), chunks.begin() + refseqssofar);
-			refseqssofar += allchunks[t].size();
-		}
+		// save chunks for seeded alignment, chunk numChunks+i is the i-th of the block
+		refreads.append(nChunks,
+			[&nametags, &chunkof](size_t i) { return nametags[chunkof[i].first].substr(1) + "_" + std::to_string(chunkof[i].second); },	// removing "@"
+			[&chunks](size_t i) { return chunks[i]; });
 
 	#pragma omp parallel for
 		for(int i=0; i<nChunks; i++) 
 		{
-			// remember that the last valid position is length()-1
-			int len = chunks[i].length();
-
-			if(bpars.useMinimizer)
-			{
-				vector<Kmer> seqkmers;
-				std::vector< int > seqminimizers;    // <position_in_read>
-				for(int j = 0; j <= len - bpars.kmerSize; j++)   // AB: optimize this sliding-window parsing ala HipMer
-				{
-					std::string kmerstrfromfastq = chunks[i].substr(j, bpars.kmerSize);
-					Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-					seqkmers.emplace_back(mykmer);
-				}
-
-				getMinimizers(bpars.windowLen, seqkmers, seqminimizers);
-
-				for(auto minpos: seqminimizers)
-				{
-					std::string strminkmer = chunks[i].substr(minpos, bpars.kmerSize);
-					Kmer myminkmer(strminkmer.c_str(), strminkmer.length());
-					
-					myminkmer = myminkmer.rep();
-					
-					KMERINDEX idx; // kmer_id
-					auto found = countsreliable.find(myminkmer,idx);
-					if(found)
-					{
-						allreferencetuples[MYTHREAD].emplace_back(std::make_tuple(idx,numChunks + i, minpos));
-					}
-				}
-			}
+			if(bpars.useMPHF)
+				SeqToTuples<KmerT, IT>(chunks[i].data(), chunks[i].length(), numChunks + i, *frozenreliable, bpars, allreferencetuples[MYTHREAD]);
 			else
-			{
-				for(int j = 0; j <= len - bpars.kmerSize; j++)
-				{
-					std::string kmerstrfromfastq = chunks[i].substr(j, bpars.kmerSize);
-					Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
-					// remember to use only ::rep() when building kmerdict as well
-					Kmer lexsmall;
-					if (bpars.useHOPC)
-					{
-						lexsmall = mykmer.hopc();
-					}
-					else
-					{
-						// remember to use only ::rep() when building kmerdict as well
-						lexsmall = mykmer.rep();
-					}
-
-					KMERINDEX idx; // kmer_id
-					auto found = countsreliable.find(lexsmall,idx);
-					if(found)
-					{
-						//alloccurrences[MYTHREAD].emplace_back(std::make_tuple(numReads+i, idx, j)); // vector<tuple<numReads,kmer_id,kmerpos>>
-						allreferencetuples[MYTHREAD].emplace_back(std::make_tuple(idx, numChunks + i, j)); // transtuples.push_back(col_id,row_id,kmerpos)
-					}
-				}
-			}
+				SeqToTuples<KmerT, IT>(chunks[i].data(), chunks[i].length(), numChunks + i, countsreliable, bpars, allreferencetuples[MYTHREAD]);
 		} // for(int i=0; i<nreads; i++)
 		numChunks += nChunks;
 	} //while(fillstatus) 
 	delete pfq;
 
 
-	KMERINDEX refreadscount = 0;
-	KMERINDEX reftuplecount = 0;
+	IT refreadscount = refreads.size();
+	IT reftuplecount = 0;
 
 	for(int t=0; t<MAXTHREADS; ++t)
 	{
 		reftuplecount += allreferencetuples[t].size();
-		refreadscount += allrefchunks[t].size();
 	}
 
-	referencetuples.resize(reftuplecount);
-	refreads.resize(refreadscount);
-
 	printLog(numChunks);
 	printLog(refreadscount);
+	printLog(reftuplecount);
 
-
-	unsigned int reftuplesofar = 0;
-	unsigned int refreadssofar= 0;
-
-	for(int t=0; t<MAXTHREADS; ++t)
-	{
-		//copy(alloccurrences[t].begin(), alloccurrences[t].end(), occurrences.begin() + tuplesofar);
-		copy(allreferencetuples[t].begin(), allreferencetuples[t].end(), referencetuples.begin() + reftuplesofar);
-		reftuplesofar += allreferencetuples[t].size();
-
-		copy(allrefchunks[t].begin(), allrefchunks[t].end(), refreads.begin()+refreadssofar);
-		refreadssofar += allrefchunks[t].size();
-	}
-
-	std::vector<string>().swap(seqs);		// free memory of seqs  
-	std::vector<string>().swap(quals);		// free memory of quals
+	std::vector<SeqView>().swap(seqs);		// free memory of seqs  
+	std::vector<SeqView>().swap(quals);		// free memory of quals
 
 	std::string ReferenceParsingTime = std::to_string(omp_get_wtime() - ref_parsing) + " seconds";
 	printLog(ReferenceParsingTime);
 	printLog(numChunks);
 
-	// ====================== //
-	// Sparse Matrix Creation //
-	// ====================== //
-	
-	unsigned int nkmer = countsreliable.size();
+	IT nkmer = bpars.useMPHF ? frozenreliable->size() : countsreliable.size();
 	
 	// to help the parsing script
     //cout << nkmer << endl;
 	printLog(nkmer);
+
+	// positions are k-mer starts, so they are shorter than the sequences
+	bool wideReadPos  = reads.maxLength() > std::numeric_limits<unsigned short int>::max();
+	bool wideChunkPos = refreads.maxLength() > std::numeric_limits<unsigned short int>::max();
+	std::string ReadPositions  = wideReadPos  ? "32-bit" : "16-bit";
+	std::string ChunkPositions = wideChunkPos ? "32-bit" : "16-bit";
+	printLog(ReadPositions);
+	printLog(ChunkPositions);
+
+	if(wideReadPos && wideChunkPos)
+		OverlapDetection<unsigned int, unsigned int>(alltranstuples, allreferencetuples, nkmer, numReads, numChunks, reads, refreads, bpars, OutputFile, ratiophi);
+	else if(wideReadPos)
+		OverlapDetection<unsigned int, unsigned short int>(alltranstuples, allreferencetuples, nkmer, numReads, numChunks, reads, refreads, bpars, OutputFile, ratiophi);
+	else if(wideChunkPos)
+		OverlapDetection<unsigned short int, unsigned int>(alltranstuples, allreferencetuples, nkmer, numReads, numChunks, reads, refreads, bpars, OutputFile, ratiophi);
+	else
+		OverlapDetection<unsigned short int, unsigned short int>(alltranstuples, allreferencetuples, nkmer, numReads, numChunks, reads, refreads, bpars, OutputFile, ratiophi);
+
+	double totaltime = omp_get_wtime()-all;
+
+    std::string TotalRuntime = std::to_string(totaltime) + " seconds";   
+    printLog(TotalRuntime);
 	
-	double matcreat = omp_get_wtime();
-	CSC<KMERINDEX, unsigned short int> transpmat(transtuples, nkmer, numReads,
-							[] (unsigned short int& p1, unsigned short int& p2) 
-							{
-								return p1;
-							}, false);	// hashspgemm doesn't require sorted rowids within each column
-	// remove memory of transtuples
-	std::vector<tuple<KMERINDEX, KMERINDEX, unsigned short int>>().swap(transtuples);
+	cout << totaltime << endl;
 
-	std::string TransposeSparseMatrixCreationTime = std::to_string(omp_get_wtime() - matcreat) + " seconds";
-	printLog(TransposeSparseMatrixCreationTime);
+	return 0;
+}
 
+int main (int argc, char *argv[]) {
+	//
+	// Program name and purpose
+	//
+	cxxopts::Options options("BELLA", "Long Read to Long Read Aligner and Overlapper");
 
-	double transbeg = omp_get_wtime();	
-	CSC<KMERINDEX, unsigned short int> spmat = transpmat.Transpose();
-	std::string ReTransposeTime = std::to_string(omp_get_wtime() - transbeg) + " seconds";
-	printLog(ReTransposeTime);
+	//
+	// Setup the input files
+	//
+	options.add_options()
+	("f, fastq", "List of Fastq(s) (required)", 	cxxopts::value<std::string>())
+	("o, output", "Output Filename (required)", 	cxxopts::value<std::string>())
+	("k, kmer", "K-mer Length", 	 	cxxopts::value<int>()->default_value("17"))
+	("x, xdrop", "SeqAn X-Drop", 		cxxopts::value<int>()->default_value("7"))
+	("batch-xdrop", "Extend Many Seeds at once, one per SIMD Lane", 	cxxopts::value<bool>()->default_value("false"))
+	("simd", "Xavier Instruction Set: avx2, avx512bw, sse4.2 or auto (the widest of this CPU)", 	cxxopts::value<std::string>()->default_value("avx2"))
+	("e, error", "Error Rate", 			cxxopts::value<double>()->default_value("0.15"))
+	("estimate", "Estimate Error Rate from Data", 			cxxopts::value<bool>()->default_value("false"))
+	("c, chunks", "Size of Chunks for Reference Genome", 			cxxopts::value<int>()->default_value("100000"))
+	("skip-alignment", "Overlap Only", 	cxxopts::value<bool>()->default_value("false"))
+	("m, memory", "Total RAM BELLA can use in MB [measured, container limits included]", 			cxxopts::value<int>()->default_value("8000"))
+	("score-deviation", "Deviation from the Mean Alignment Score [0,1]", 	cxxopts::value<double>()->default_value("0.1"))
+	("b, bin-size", "Bin Size for Binning Algorithm", 		cxxopts::value<int>()->default_value("500"))
+	("chain-support", "Minimum K-mers on the Best Diagonal Bin to Align a Pair", 	cxxopts::value<int>()->default_value("1"))
+	("min-shared", "Minimum Shared K-mers to Align a Pair", 	cxxopts::value<int>()->default_value("1"))
+	("min-overlap", "Minimum Estimated Overlap Length to Align a Pair", 	cxxopts::value<int>()->default_value("0"))
+	("qgram", "Align only Pairs Sharing the K-mers the Q-gram Lemma Requires at the Error Rate", 	cxxopts::value<bool>()->default_value("false"))
+	("paf", "Output in PAF format", 	cxxopts::value<bool>()->default_value("false"))
+	("g, gpus", "GPUs Available", 		cxxopts::value<int>()->default_value("1")) // this must work only if compiled with bella-gpu
+	("split-count", "K-mer Counting Split Count", 			cxxopts::value<int>()->default_value("1"))
+	("sort-count", "Count K-mers by Sorting (instead of Bloom Filter + Hash Table)", 	cxxopts::value<bool>()->default_value("false"))
+	("tmp-dir", "Count K-mers in Minimizer Bins under this Directory (reads the input once, bins = split-count or 64)", 	cxxopts::value<std::string>())
+	("hopc", "Use HOPC representation", cxxopts::value<bool>()->default_value("false"))
+	("mphf", "Freeze Reliable K-mers into a Minimal Perfect Hash", cxxopts::value<bool>()->default_value("false"))
+	("index64", "64-bit K-mer and Read Indices (default: only if the input needs them)", cxxopts::value<bool>()->default_value("false"))
+	("spgemm", "Overlap Matrix Kernel: auto, hash or esc", 	cxxopts::value<std::string>()->default_value("auto"))
+	("spgemm-threads", "Threads Forming the Overlap Matrix while the Others Align (default: a quarter)", 	cxxopts::value<int>()->default_value("0"))
+	("w, window", "Window Size for Minimizer Selection", 	cxxopts::value<int>()->default_value("0"))
+	("s, syncmer", "Enable Syncmer Selection", 				cxxopts::value<bool>()->default_value("false"))
+	("u, upper-freq", "K-mer Frequency Upper Bound", 		cxxopts::value<int>()->default_value("8"))
+	("l, lower-freq", "K-mer Frequency Lower Bound", 		cxxopts::value<int>()->default_value("2"))
+	("h, help", "Usage")
+	;
 
-	double createrefmat = omp_get_wtime();
+	auto result = options.parse(argc, argv);
 
-	CSC<KMERINDEX, unsigned short int> refmat(referencetuples, nkmer, numChunks,
-							[](unsigned short int& p1, unsigned short int& p2)
-							{
-								return p1;
-							}, false);
-	std::vector<tuple<KMERINDEX, KMERINDEX, unsigned short int>>().swap(referencetuples);
+    if (result.count("help"))
+    {
+      std::cout << options.help() << std::endl;
+      exit(0);
+    }
 
-	std::string RefMatTime = std::to_string(omp_get_wtime() - createrefmat) + " seconds";
-	printLog(RefMatTime);
+	char *inputfofn = NULL;	
+	if(result.count("fastq")) inputfofn = strdup(result["fastq"].as<std::string>().c_str());
+	else
+	{
+      std::cout << options.help() << std::endl;
+      exit(0);		
+	}
 
-	// ==================================================== //
-	// Sparse Matrix Multiplication (aka Overlap Detection) //
-	// ==================================================== //
+	char *OutputFile = NULL;	
+	if(result.count("output"))
+	{
+		char* line1 = strdup(result["output"].as<std::string>().c_str());
+		char* line2 = strdup(".out");
+
+		unsigned int len1 = strlen(line1);
+		unsigned int len2 = strlen(line2);
+
+		OutputFile = (char*)malloc(len1 + len2 + 1);
+		if (!OutputFile) abort();
+
+		memcpy(OutputFile,  line1, len1);
+		memcpy(OutputFile + len1,  line2, len2);
+		OutputFile[len1 + len2] = '\0';
+
+		delete line1, line2;
 		
-	spmatPtr_ getvaluetype(make_shared<spmatRefType_>());
-	HashSpGEMM(
-		spmat, refmat, 
-		// n-th k-mer positions on read i and on read j
-	    [&bpars, &reads, &refreads] (const unsigned short int& begpH, const unsigned short int& begpV, 
-	        const unsigned int& id1, const unsigned int& id2)
-		{
-			spmatPtr_ value(make_shared<spmatRefType_>()); // this is now just count and a vec of pair position
+		remove(OutputFile);
+	}
+	else
+	{
+      std::cout << options.help() << std::endl;
+      exit(0);		
+	}
 
-			// GGGG: Code using David's types
-			value->count = 1;
+	BELLApars bpars;	
 
-			pair<unsigned short int, unsigned short int> mypair = std::make_pair(begpH, begpV); 
-			value->pos.push_back(mypair);
+	bpars.kmerSize 	= result["kmer"].as<int>();
+	bpars.xDrop 	= result["xdrop"].as<int>();
+	bpars.batchAlign = result["batch-xdrop"].as<bool>();
+	if(result.count("simd"))
+		xavierSelect(result["simd"].as<std::string>());	// otherwise avx2, or the widest of a CPU without it
+	bpars.errorRate = result["error"].as<double>();
+	bpars.chunkSize = result["chunks"].as<int>();
 
-			/* GGGG: BELLA's default code
-			// std::string& read1 = reads[id1].seq;
-			// std::string& read2 = reads[id2].seq;
+	bpars.estimateErr 	= result["estimate"].as<bool>();
+	bpars.skipAlignment = result["skip-alignment"].as<bool>();
+	bpars.totalMemory 	= result["memory"].as<int>();
 
-			// GG: function in chain.h
-			// multiop(value, read1, read2, begpH, begpV, bpars.kmerSize);
-			*/
+	bpars.userDefMem	= (result.count("memory") > 0);	// otherwise measured, see estimateMemory() in include/overlap.hpp
 
-			return value;
-		},
-	    [&bpars, &reads, &refreads] (spmatPtr_& m1, spmatPtr_& m2)
-		{
-			// GGGG: Code using David's types
-			m1->count = m1->count + m2->count;
-			m1->pos.insert(m1->pos.end(), m2->pos.begin(), m2->pos.end());
+	bpars.deltaChernoff = result["score-deviation"].as<double>();
+	if(bpars.deltaChernoff > 1.0 || bpars.deltaChernoff < 0.0)
+	{
+      std::cout << options.help() << std::endl;
+      exit(0);		
+	}
 
-			/* GGGG: BELLA's default code
-			// GG: after testing correctness, these variables can be removed
+	bpars.binSize 	 = result["bin-size"].as<int>();
+	bpars.minSupport = result["chain-support"].as<int>();
+	bpars.minShared  = result["min-shared"].as<int>();
+	bpars.minOverlap = result["min-overlap"].as<int>();
+	bpars.useQgram   = result["qgram"].as<bool>();
+	bpars.outputPaf	 = result["paf"].as<bool>();
+	bpars.numGPU 	 = result["gpus"].as<int>();
+	bpars.SplitCount = result["split-count"].as<int>();
+	bpars.useSortCount = result["sort-count"].as<bool>();
+	if(result.count("tmp-dir")) bpars.tmpDir = result["tmp-dir"].as<std::string>();
+	bpars.useHOPC	 = result["hopc"].as<bool>();
+	bpars.useMPHF	 = result["mphf"].as<bool>();
+	bpars.useIndex64 = result["index64"].as<bool>();
+	bpars.spgemmThreads = result["spgemm-threads"].as<int>();
+	bpars.spgemmKernel = result["spgemm"].as<std::string>();
+	if(bpars.spgemmKernel != "auto" && bpars.spgemmKernel != "hash" && bpars.spgemmKernel != "esc")
+	{
+		fprintf(stderr, "Unknown overlap matrix kernel %s, use auto, hash or esc\n", bpars.spgemmKernel.c_str());
+		exit(1);
+	}
 
-			// GG: function in chain.h
-			// chainop(m1, m2, bpars);
-			*/
+	bpars.windowLen  = result["window"].as<int>();
+	if(bpars.windowLen != 0)
+		bpars.useMinimizer = true;
 
-			return m1;
-		},
-	    reads, refreads, getvaluetype, OutputFile, bpars, ratiophi);
+	bpars.useSyncmer = result["syncmer"].as<bool>();
+	if(bpars.useSyncmer)
+		bpars.useMinimizer = false;
 
-	double totaltime = omp_get_wtime()-all;
+	int reliableUpperBound	= result["upper-freq"].as<int>();	
+	int reliableLowerBound	= result["lower-freq"].as<int>(); 
 
-    std::string TotalRuntime = std::to_string(totaltime) + " seconds";   
-    printLog(TotalRuntime);
-	
-	cout << totaltime << endl;
+	// ================ //
+	//   Declarations   //
+	// ================ //
 
-	return 0;
+	vector<filedata> allfiles = GetFiles(inputfofn);
+	std::string all_inputs_gerbil = std::string(inputfofn); 
+
+	// distinct k-mers (what counting estimates with HyperLogLog), reads and k-mer occurrences (nonzeros of the matrices)
+	// are all bounded by the bases of the input, known before counting: the index width has to be picked before the
+	// k-mer dictionary is made. The overlap matrix is only known later, its counters are 64-bit whatever the index width
+	size_t inputText = 0;
+	for(auto& f : allfiles)
+		inputText += MappedFASTQ::text_size(f.filename);
+	if(inputText >= INDEX32_MAXTEXT)
+		bpars.useIndex64 = true;
+
+	// ================== //
+	// Parameters Summary //
+	// ================== //
+    
+#ifdef PRINT
+    printLog(OutputFile);
+
+    std::string kmerSize = std::to_string(bpars.kmerSize);
+    printLog(kmerSize);
+
+    std::string GPUs = "DISABLED";
+    printLog(GPUs);
+
+	std::string ChunkSize = std::to_string(bpars.chunkSize);
+	printLog(ChunkSize);
+
+	std::string UserDefinedMemory = std::to_string(bpars.totalMemory) + " MB";
+	printLog(UserDefinedMemory);
+
+    std::string OutputPAF = std::to_string(bpars.outputPaf);
+    printLog(OutputPAF);
+
+    std::string BinSize = std::to_string(bpars.binSize);
+    printLog(BinSize);
+
+    std::string ChainSupport = std::to_string(bpars.minSupport);
+    printLog(ChainSupport);
+
+    std::string MinShared = std::to_string(bpars.minShared);
+    printLog(MinShared);
+
+    std::string MinOverlap = std::to_string(bpars.minOverlap);
+    printLog(MinOverlap);
+
+    std::string QgramFilter = std::to_string(bpars.useQgram);
+    printLog(QgramFilter);
+    
+    std::string DeltaChernoff = std::to_string(bpars.deltaChernoff);
+    printLog(DeltaChernoff);
+
+    std::string RunPairwiseAlignment = std::to_string(!bpars.skipAlignment);
+    printLog(RunPairwiseAlignment);
+
+	if(bpars.useHOPC)
+	{
+		std::string HOPC = "ENABLED";
+		printLog(HOPC);
+	}
+	else 
+	{
+		std::string HOPC = "DISABLED";
+		printLog(HOPC);
+	}
+
+	std::string MPHF = bpars.useMPHF ? "ENABLED" : "DISABLED";
+	printLog(MPHF);
+
+	std::string InputText = std::to_string((double)inputText / (1024 * 1024)) + " MB";
+	printLog(InputText);
+	std::string IndexWidth = bpars.useIndex64 ? "64-bit" : "32-bit";
+	printLog(IndexWidth);
+	std::string SpGEMMKernel = bpars.spgemmKernel;
+	printLog(SpGEMMKernel);
+
+    std::string xDrop = std::to_string(bpars.xDrop);
+    printLog(xDrop);
+
+	std::string BatchXDrop = bpars.batchAlign ? "ENABLED" : "DISABLED";
+	printLog(BatchXDrop);
+
+	std::string XavierSIMD = xavierISA();
+	printLog(XavierSIMD);
+
+    std::string KmerSplitCount = std::to_string(bpars.SplitCount);
+    printLog(KmerSplitCount);
+
+	std::string SortCount = bpars.useSortCount ? "ENABLED" : "DISABLED";
+	printLog(SortCount);
+
+	std::string DiskCount = bpars.tmpDir.empty() ? "DISABLED" : (bpars.useHOPC ? "DISABLED (HOPC)" : bpars.tmpDir);
+	printLog(DiskCount);
+
+	if(bpars.useMinimizer)
+	{
+		std::string useMinimizer = "ENABLED";
+		printLog(useMinimizer);
+		std::string minimizerWindow = std::to_string(bpars.windowLen);
+    	printLog(minimizerWindow);
+	}
+ 	else if(bpars.useSyncmer)
+	{
+		std::string useSyncmer = "ENABLED";
+		printLog(useSyncmer);
+		std::string minimizerWindow = "0";
+    	printLog(minimizerWindow);
+	}
+	else
+	{
+		std::string useKmer = "ENABLED";
+		printLog(useKmer);
+		std::string minimizerWindow = "0";
+    	printLog(minimizerWindow);
+	}
+
+#endif
+
+	if(bpars.kmerSize < 1 || bpars.kmerSize > Kmer64::MAX_K)
+	{
+		fprintf(stderr, "k-mer length must be between 1 and %u\n", Kmer64::MAX_K);
+		exit(1);
+	}
+
+	// one and two word k-mers are compiled separately, pick the smallest one that fits k, same for the indices
+	if(bpars.kmerSize <= Kmer32::MAX_K)
+	{
+		if(bpars.useIndex64)
+			return RunBELLA<Kmer32, uint64_t>(bpars, allfiles, OutputFile, reliableLowerBound, reliableUpperBound);
+		else
+			return RunBELLA<Kmer32, uint32_t>(bpars, allfiles, OutputFile, reliableLowerBound, reliableUpperBound);
+	}
+	else
+	{
+		if(bpars.useIndex64)
+			return RunBELLA<Kmer64, uint64_t>(bpars, allfiles, OutputFile, reliableLowerBound, reliableUpperBound);
+		else
+			return RunBELLA<Kmer64, uint32_t>(bpars, allfiles, OutputFile, reliableLowerBound, reliableUpperBound);
+	}
 }
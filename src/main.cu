@@ -40,6 +40,7 @@
 
 #include "../kmercode/hash_funcs.h"
 #include "../kmercode/Kmer.hpp"
+#include "../kmercode/FixedKmer.hpp"
 #include "../kmercode/Buffer.h"
 #include "../kmercode/common.h"
 #include "../kmercode/fq_reader.h"
@@ -180,7 +181,7 @@ int main (int argc, char *argv[]) {
 	vector<filedata> allfiles = GetFiles(inputfofn);
 	std::string all_inputs_gerbil = std::string(inputfofn); 
 	double ratiophi;
-	Kmer::set_k(bpars.kmerSize);
+	Kmer32::set_k(bpars.kmerSize);
 	unsigned int upperlimit = 10000000; // in bytes
 	Kmers kmervect;
 	vector<string> seqs;
@@ -284,7 +285,7 @@ int main (int argc, char *argv[]) {
 	//  K-mer Counting  //
 	// ================ //
 
-	CuckooDict<KMERINDEX> countsreliable;
+	CuckooDict<Kmer32, KMERINDEX> countsreliable;
 
 	if(bpars.useSyncmer)
 	{
@@ -362,12 +363,12 @@ int main (int argc, char *argv[]) {
                 
                 if(bpars.useMinimizer)
                 {
-                    vector<Kmer> seqkmers;
+                    vector<Kmer32> seqkmers;
                     std::vector<int> seqminimizers;    // <position_in_read>
                     for(int j = 0; j <= len - bpars.kmerSize; j++)   // AB: optimize this sliding-window parsing ala HipMer
                     {
                         std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-                        Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
+                        Kmer32 mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
                         seqkmers.emplace_back(mykmer);
                     }
 
@@ -376,7 +377,7 @@ int main (int argc, char *argv[]) {
                     for(auto minpos: seqminimizers)
                     {
                         std::string strminkmer = seqs[i].substr(minpos, bpars.kmerSize);
-                        Kmer myminkmer(strminkmer.c_str(), strminkmer.length());
+                        Kmer32 myminkmer(strminkmer.c_str(), strminkmer.length());
                         
                         KMERINDEX idx; // kmer_id
                         auto found = countsreliable.find(myminkmer,idx);
@@ -391,9 +392,9 @@ int main (int argc, char *argv[]) {
                     for(int j = 0; j <= len - bpars.kmerSize; j++)
                     {
                         std::string kmerstrfromfastq = seqs[i].substr(j, bpars.kmerSize);
-                        Kmer mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
+                        Kmer32 mykmer(kmerstrfromfastq.c_str(), kmerstrfromfastq.length());
                         // remember to use only ::rep() when building kmerdict as well
-                        Kmer lexsmall;
+                        Kmer32 lexsmall;
                         if (bpars.useHOPC)
                         {
                             lexsmall = mykmer.hopc();
@@ -0,0 +1,51 @@
+//===========================================================================
+// Title:  Xavier batch: inter-sequence X-drop seed extension on the CPU
+//===========================================================================
+
+#ifndef XAVIER_BATCH_H
+#define XAVIER_BATCH_H
+
+#include<vector>
+#include<algorithm>
+#include<inttypes.h>
+#include<string.h>
+
+/*
+ * Many extensions at once, one per SIMD lane (LOGAN batches seeds the same way on the GPU):
+ *  - every lane runs an adaptive band of XDROP_BAND cells per anti-diagonal, the band follows
+ *    the best cell of the last anti-diagonal (right or down, as in Xavier)
+ *  - the state is laid out by band cell: vector k holds cell k of the band of every lane, so a
+ *    lane moving right and another moving down only differ by a blend, and the max of an
+ *    anti-diagonal is taken across vectors, with no horizontal reduction
+ *  - scores are 16-bit, relative to a per-lane offset that moves up as the scores grow
+ *  - a lane stops on its own x-drop (or when the band leaves the matrix) and takes the next
+ *    extension of the queue, the others go on
+ *  - the lanes are the int16 lanes of the instruction set Xavier runs (see xavier.h): 32 with
+ *    AVX-512BW, 16 with AVX2, 8 with SSE4.2. batchkernel.h is built once per instruction set
+ */
+
+#define XDROP_BAND 32					// cells per anti-diagonal and lane
+#define XDROP_NINF  (-16384)			// cells outside the matrix or dropped
+#define XDROP_RENORM 8192				// lane scores are moved down past this
+#define XDROP_NOBASE_H 0x100			// bases outside the sequences, never equal
+#define XDROP_NOBASE_V 0x200
+
+// one extension from the corner of the matrix: the bases of H are h[0], h[hstep], ... (hlen of them),
+// hstep = -1 walks a prefix backwards for a left extension. Same for V
+struct XDropJob {
+	const char* h;
+	int hstep;
+	int hlen;
+	const char* v;
+	int vstep;
+	int vlen;
+};
+
+// best score of an extension and the bases of H and V it covers
+struct XDropResult {
+	int score;
+	int hext;
+	int vext;
+};
+
+#endif
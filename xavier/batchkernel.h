@@ -0,0 +1,274 @@
+//===========================================================================
+// Title:  Xavier batch: inter-sequence X-drop seed extension on the CPU
+//===========================================================================
+
+// No include guard: xavier.h includes this file once per instruction set, in the namespace of its int16 lanes
+// (VECTORWIDTH of them, see simdutils.h) and under the matching #pragma GCC target. See batch.h for the layout
+
+typedef int16_t batchVector __attribute__((vector_size(2 * VECTORWIDTH)));	// a band slot (or a flag) of every lane
+typedef int32_t batchWide   __attribute__((vector_size(4 * VECTORWIDTH)));	// positions and absolute scores of every lane
+
+class BatchXDropKernel {
+public:
+	BatchXDropKernel(int match, int mismatch, int gap, int xdrop) : match(match), mismatch(mismatch), gap(gap),
+		xdrop(std::min(xdrop, XDROP_RENORM / 2))
+	{
+		for(int s = 0; s < XDROP_BAND + 2; ++s)
+			bufferA[s] = bufferB[s] = splat(XDROP_NINF);
+	}
+
+	// results[x] is the extension of jobs[x]
+	void run(const std::vector<XDropJob>& jobs, std::vector<XDropResult>& results)
+	{
+		results.resize(jobs.size());
+		size_t next = 0;
+		int running = 0;
+
+		for(int l = 0; l < VECTORWIDTH; ++l)
+		{
+			if(next < jobs.size())
+			{
+				start(l, jobs, next++);
+				++running;
+			}
+			else park(l);
+		}
+
+		while(running > 0)
+		{
+			step();
+			if(!anyLane(finished)) continue;
+
+			for(int l = 0; l < VECTORWIDTH; ++l)
+			{
+				if(!finished[l]) continue;
+
+				XDropResult& r = results[job[l]];
+				r.score = best[l];
+				r.hext  = besti[l];
+				r.vext  = bestj[l];
+				--running;
+
+				if(next < jobs.size())
+				{
+					start(l, jobs, next++);
+					++running;
+				}
+				else park(l);
+			}
+		}
+	}
+
+private:
+	static batchVector splat(int x) { return (batchVector){} + (int16_t)x; }
+
+	// true if any lane of m is set
+	static bool anyLane(const batchVector& m)
+	{
+		uint64_t words[VECTORWIDTH / 4];
+		memcpy(words, &m, sizeof(m));
+		uint64_t any = 0;
+		for(int w = 0; w < VECTORWIDTH / 4; ++w)
+			any |= words[w];
+		return any != 0;
+	}
+
+	// base x of the sequence, or the filler outside it
+	static int16_t base(const char* s, int step, int len, int x, int16_t filler)
+	{
+		return (x >= 0 && x < len) ? (int16_t)(unsigned char)s[(long)x * step] : filler;
+	}
+
+	// anti-diagonal 0 of job x on lane l: only the corner cell, band centered on the main diagonal
+	void start(int l, const std::vector<XDropJob>& jobs, size_t x)
+	{
+		const XDropJob& jb = jobs[x];
+		job[l] = x;
+		// an empty sequence points to a base that can be read, so that step() loads every lane without a test
+		h[l] = (jb.hlen > 0) ? jb.h : &nobase; hstep[l] = jb.hstep; hlen[l] = jb.hlen;
+		v[l] = (jb.vlen > 0) ? jb.v : &nobase; vstep[l] = jb.vstep; vlen[l] = jb.vlen;
+
+		// slot k of anti-diagonal a is the cell (i0 + k, j0 - k), i0 + j0 = a
+		i0[l] = -XDROP_BAND / 2;
+		j0[l] =  XDROP_BAND / 2;
+		dir[l] = 1;
+		prevdir[l] = -1;
+		offset[l] = 0;
+		best[l] = 0;
+		besti[l] = bestj[l] = 0;
+		finished[l] = (jb.hlen == 0 && jb.vlen == 0) ? -1 : 0;
+		live[l] = ~finished[l];
+
+		for(int k = 0; k < XDROP_BAND; ++k)
+		{
+			S1[k + 1][l] = (k == XDROP_BAND / 2) ? 0 : XDROP_NINF;
+			S2[k + 1][l] = XDROP_NINF;
+			// the bases compared at cell (i, j) are H[i-1] and V[j-1]
+			Hc[k][l] = base(jb.h, jb.hstep, jb.hlen, i0[l] + k - 1, XDROP_NOBASE_H);
+			Vc[k][l] = base(jb.v, jb.vstep, jb.vlen, j0[l] - k - 1, XDROP_NOBASE_V);
+		}
+	}
+
+	// a lane with nothing to do: never finished, all its cells dropped
+	void park(int l)
+	{
+		job[l] = -1;
+		live[l] = finished[l] = 0;
+		h[l] = v[l] = &nobase;
+		hstep[l] = vstep[l] = 1;
+		hlen[l] = vlen[l] = 0;
+		i0[l] = j0[l] = 0;
+		dir[l] = prevdir[l] = 1;
+		offset[l] = 0;
+		best[l] = 0;
+		for(int k = 0; k < XDROP_BAND; ++k)
+		{
+			S1[k + 1][l] = S2[k + 1][l] = XDROP_NINF;
+			Hc[k][l] = XDROP_NOBASE_H;
+			Vc[k][l] = XDROP_NOBASE_V;
+		}
+	}
+
+	// next anti-diagonal of every lane
+	void step()
+	{
+		const batchVector ninf = splat(XDROP_NINF), one = splat(1);
+		const batchWide none = (batchWide){} - 1, band = (batchWide){} + XDROP_BAND;
+
+		// -1 on the lanes moving right (next base of H), 0 on the ones moving down (next base of V)
+		batchVector right = (dir > 0);
+		// diagonal predecessor on the anti-diagonal before: one slot up after two moves right, one down after two moves down
+		batchVector diagR = right & (prevdir > 0);
+		batchVector diagD = ~right & (prevdir < 0);
+		prevdir = dir;
+
+		batchWide rightW = __builtin_convertvector(right, batchWide);
+		i0 -= rightW;
+		j0 += rightW + 1;
+
+		// slots inside the matrix: 0 <= i0 + k <= hlen and 0 <= j0 - k <= vlen, within [-1, XDROP_BAND]
+		batchWide lo = (-i0 > j0 - vlen) ? -i0 : j0 - vlen;
+		batchWide hi = (hlen - i0 < j0) ? hlen - i0 : j0;
+		lo = (lo > none) ? lo : none;
+		lo = (lo < band) ? lo : band;
+		hi = (hi < band) ? hi : band;
+		hi = (hi > none) ? hi : none;
+		batchVector vklo = __builtin_convertvector(lo, batchVector);
+		batchVector vkhi = __builtin_convertvector(hi, batchVector);
+		batchVector vthr = live ? __builtin_convertvector(best - offset - xdrop, batchVector) : splat(XDROP_RENORM);
+
+		// the bases entering the band: the indices are computed for all the lanes at once, the loads go lane by lane
+		// (each lane reads its own pair). Outside a sequence a lane reads its first base and drops it below
+		batchWide xH = i0 + (XDROP_BAND - 2), xV = j0 - 1;
+		batchWide inH = (xH >= 0) & (xH < hlen), inV = (xV >= 0) & (xV < vlen);
+		batchWide atH = (inH & xH) * hstep, atV = (inV & xV) * vstep;
+		batchVector newH, newV;
+		for(int l = 0; l < VECTORWIDTH; ++l)
+		{
+			newH[l] = (unsigned char)h[l][atH[l]];
+			newV[l] = (unsigned char)v[l][atV[l]];
+		}
+		newH = __builtin_convertvector(inH, batchVector) ? newH : splat(XDROP_NOBASE_H);
+		newV = __builtin_convertvector(inV, batchVector) ? newV : splat(XDROP_NOBASE_V);
+
+		// the bases of the new anti-diagonal: moving right shifts H by a slot, moving down shifts V
+		for(int k = 0; k < XDROP_BAND - 1; ++k)
+			Hc[k] = right ? Hc[k + 1] : Hc[k];
+		Hc[XDROP_BAND - 1] = right ? newH : Hc[XDROP_BAND - 1];
+		for(int k = XDROP_BAND - 1; k > 0; --k)
+			Vc[k] = right ? Vc[k] : Vc[k - 1];
+		Vc[0] = right ? Vc[0] : newV;
+
+		const batchVector vmatch = splat(match), vmismatch = splat(mismatch), vgap = splat(gap);
+		batchVector antimax = ninf, argmax = splat(0);
+		batchVector above = S2[0];	// slot k - 1 of S2 before it is overwritten
+
+		for(int k = 0; k < XDROP_BAND; ++k)
+		{
+			// S1 and S2 have a dropped cell on each side, slot k is at k + 1
+			batchVector up   = right ? S1[k + 2] : S1[k];
+			batchVector gapF = (S1[k + 1] > up) ? S1[k + 1] : up;
+			batchVector diag = diagR ? S2[k + 2] : (diagD ? above : S2[k + 1]);
+			above = S2[k + 1];
+
+			batchVector score = (Hc[k] == Vc[k]) ? vmatch : vmismatch;
+			batchVector oneF = diag + score;
+			batchVector twoF = gapF + vgap;
+			batchVector cell = oneF > twoF ? oneF : twoF;
+
+			batchVector vk = splat(k);
+			batchVector keep = (vk >= vklo) & (vk <= vkhi) & (cell >= vthr);
+			cell = keep ? cell : ninf;
+
+			argmax  = (cell > antimax) ? vk : argmax;
+			antimax = (cell > antimax) ? cell : antimax;
+			S2[k + 1] = cell;	// S2 becomes the new anti-diagonal
+		}
+		std::swap(S1, S2);
+
+		// x-drop, or the band is past the end of both sequences
+		batchVector dropped = live & (antimax == ninf);
+		finished |= dropped;
+		live &= ~dropped;
+
+		batchWide rel = __builtin_convertvector(antimax, batchWide), k = __builtin_convertvector(argmax, batchWide);
+		batchWide better = __builtin_convertvector(live, batchWide) & (rel + offset > best);
+		best  = better ? rel + offset : best;
+		besti = better ? i0 + k : besti;
+		bestj = better ? j0 - k : bestj;
+
+		// the band goes after the best cell
+		const batchVector middle = splat((XDROP_BAND - 1) / 2);
+		batchVector next = (argmax > middle) ? one : ((argmax < middle) ? -one : -prevdir);
+		dir = live ? next : dir;
+
+		batchVector renorm = live & (antimax > splat(XDROP_RENORM));
+		if(anyLane(renorm))
+		{
+			offset += __builtin_convertvector(renorm, batchWide) & rel;
+			batchVector down = renorm & antimax;
+			for(int s = 1; s <= XDROP_BAND; ++s)
+			{
+				S1[s] -= down;
+				S1[s] = (S1[s] > ninf) ? S1[s] : ninf;
+				S2[s] -= down;
+				S2[s] = (S2[s] > ninf) ? S2[s] : ninf;
+			}
+		}
+	}
+
+	int match, mismatch, gap, xdrop;
+
+	// by band slot, across lanes: S1 and S2 are the last two anti-diagonals, with a dropped cell on each side
+	batchVector bufferA[XDROP_BAND + 2], bufferB[XDROP_BAND + 2];
+	batchVector* S1 = bufferA;
+	batchVector* S2 = bufferB;
+	batchVector Hc[XDROP_BAND], Vc[XDROP_BAND];	// bases compared at each slot of the next anti-diagonal
+
+	// by lane
+	batchVector live, finished;				// -1 while the extension goes on / once it is over, until it is collected
+	batchVector dir, prevdir;				// 1 right (next base of H), -1 down (next base of V)
+	batchWide hstep, hlen, vstep, vlen;
+	batchWide i0, j0;
+	batchWide offset, best, besti, bestj;
+	long job[VECTORWIDTH];
+	const char* h[VECTORWIDTH];
+	const char* v[VECTORWIDTH];
+	const char nobase = 0;
+};
+
+// the extensions of jobs in the lanes of this instruction set, results[x] is the extension of jobs[x]
+void
+XavierBatchXDrop
+(
+	const std::vector<XDropJob>& jobs,
+	std::vector<XDropResult>& results,
+	int match,
+	int mismatch,
+	int gap,
+	int xdrop
+)
+{
+	BatchXDropKernel kernel(match, mismatch, gap, xdrop);
+	kernel.run(jobs, results);
+}
@@ -0,0 +1,635 @@
+//===========================================================================
+// Title:  Xavier: High-Performance X-Drop Adaptive Banded Pairwise Alignment 
+// Author: G. Guidi, E. Younis
+// Date:   29 April 2019
+//===========================================================================
+
+// No include guard: xavier.h includes this file once per instruction set and lane width, inside the namespace
+// of its vector operations (see simdutils.h) and under the matching #pragma GCC target.
+// With XAVIER_WIDER defined (the namespace of the same instruction set with int16 lanes), an extension
+// whose scores do not fit in the lanes is done again in the wider ones, see XavierWiden
+
+const int LOGICALWIDTH = VECTORWIDTH - 1;
+const int MIDDLE       = LOGICALWIDTH / 2;
+
+#ifdef XAVIER_WIDER
+const bool WIDENS = true;
+#else
+const bool WIDENS = false;	// the widest lanes, scores past them saturate
+#endif
+
+// every score of the scheme fits in the headroom above CUTOFF
+inline bool
+fitsLanes(ScoringSchemeX const& scoringScheme)
+{
+	return std::abs(scoreMatch(scoringScheme)) <= HEADROOM && std::abs(scoreMismatch(scoringScheme)) <= HEADROOM &&
+		std::abs(scoreGap(scoringScheme)) <= HEADROOM;
+}
+
+typedef union {
+	vectorType  	simd;
+	elementType 	elem[VECTORWIDTH];
+} vectorUnionType;
+
+void
+printVectorC(vectorType a) {
+
+	vectorUnionType tmp;
+	tmp.simd = a;
+
+	printf("{");
+	for (int i = 0; i < VECTORWIDTH-1; ++i)
+		printf("%c,", tmp.elem[i]);
+	printf("%c}\n", tmp.elem[VECTORWIDTH-1]);
+}
+
+void
+printVectorD(vectorType a) {
+
+	vectorUnionType tmp;
+	tmp.simd = a;
+
+	printf("{");
+	for (int i = 0; i < VECTORWIDTH-1; ++i)
+		printf("%d,", tmp.elem[i]);
+	printf("%d}\n", tmp.elem[VECTORWIDTH-1]);
+}
+
+inline vectorUnionType
+shiftLeft (const vectorType& _a) {
+
+	vectorUnionType b;
+	b.simd = shiftLeftOp(_a);
+	b.elem[VECTORWIDTH - 1] = NINF;
+
+	return b;
+}
+
+inline vectorUnionType
+shiftRight (const vectorType& _a) {
+
+	vectorUnionType b;
+	b.simd = shiftRightOp(_a);
+	b.elem[0] = NINF;
+
+	return b;
+}
+
+class XavierState
+{
+public:
+
+	XavierState
+	(
+		SeedX& _seed,
+	 	XavierView const& hseq,
+		XavierView const& vseq,
+		ScoringSchemeX& scoringScheme,
+		int64_t const &_scoreDropOff
+	) : queryh(hseq), queryv(vseq), scoringScheme(scoringScheme)
+	{
+		seed = _seed;
+		startSeed = _seed;
+
+		hlength = hseq.length + 1;	// + VECTORWIDTH;
+		vlength = vseq.length + 1;	// + VECTORWIDTH;
+
+		if (hlength < VECTORWIDTH || vlength < VECTORWIDTH)
+		{
+			setEndPositionH(seed, hlength);
+			setEndPositionV(seed, vlength);
+			//	GG: main function takes care of this
+			// 	return;
+		}
+
+		matchCost    = scoreMatch(scoringScheme   );
+		mismatchCost = scoreMismatch(scoringScheme);
+		gapCost      = scoreGap(scoringScheme     );
+
+		vmatchCost    = setOp (matchCost   );
+		vmismatchCost = setOp (mismatchCost);
+		vgapCost      = setOp (gapCost     );
+		vzeros        = zeroOp();
+
+		vectorUnionType lane;
+		for (int l = 0; l < VECTORWIDTH; ++l)
+			lane.elem[l] = l;
+		vlast = cmpeqOp(lane.simd, setOp(LOGICALWIDTH));
+
+		hoffset = LOGICALWIDTH;
+		voffset = LOGICALWIDTH;
+
+		bestScore    = 0;
+		currScore    = 0;
+		scoreOffset  = 0;
+		scoreDropOff = _scoreDropOff;
+		xDropCond   = false;
+		overflow    = WIDENS && !fitsLanes(scoringScheme);
+	}
+
+	// i think this can be smaller than 64bit
+	int64_t get_score_offset  ( void ) { return scoreOffset;  }
+	int64_t get_best_score    ( void ) { return bestScore;    }
+	int64_t get_curr_score    ( void ) { return currScore;    }
+	int64_t get_score_dropoff ( void ) { return scoreDropOff; }
+
+	void set_score_offset ( int64_t _scoreOffset ) { scoreOffset = _scoreOffset; }
+	void set_best_score   ( int64_t _bestScore   ) { bestScore   = _bestScore;   }
+	void set_curr_score   ( int64_t _currScore   ) { currScore   = _currScore;   }
+
+	elementType get_match_cost    ( void ) { return matchCost;    }
+	elementType get_mismatch_cost ( void ) { return mismatchCost; }
+	elementType get_gap_cost      ( void ) { return gapCost;      }
+
+	vectorType get_vqueryh ( void ) { return vqueryh.simd; }
+	vectorType get_vqueryv ( void ) { return vqueryv.simd; }
+
+	vectorType get_antiDiag1 ( void ) { return antiDiag1.simd; }
+	vectorType get_antiDiag2 ( void ) { return antiDiag2.simd; }
+	vectorType get_antiDiag3 ( void ) { return antiDiag3.simd; }
+
+	vectorType get_vmatchCost    ( void ) { return vmatchCost;    }
+	vectorType get_vmismatchCost ( void ) { return vmismatchCost; }
+	vectorType get_vgapCost      ( void ) { return vgapCost;      }
+	vectorType get_vzeros        ( void ) { return vzeros;        }
+
+	void update_vqueryh ( uint8_t idx, elementType value ) { vqueryh.elem[idx] = value; }
+	void update_vqueryv ( uint8_t idx, elementType value ) { vqueryv.elem[idx] = value; }
+
+	void update_antiDiag1 ( uint8_t idx, elementType value ) { antiDiag1.elem[idx] = value; }
+	void update_antiDiag2 ( uint8_t idx, elementType value ) { antiDiag2.elem[idx] = value; }
+	void update_antiDiag3 ( uint8_t idx, elementType value ) { antiDiag3.elem[idx] = value; }
+
+	void broadcast_antiDiag1 ( elementType value ) { antiDiag1.simd = setOp( value ); }
+	void broadcast_antiDiag2 ( elementType value ) { antiDiag2.simd = setOp( value ); }
+	void broadcast_antiDiag3 ( elementType value ) { antiDiag3.simd = setOp( value ); }
+
+	void set_antiDiag1 ( vectorType vector ) { antiDiag1.simd = vector; }
+	void set_antiDiag2 ( vectorType vector ) { antiDiag2.simd = vector; }
+	void set_antiDiag3 ( vectorType vector ) { antiDiag3.simd = vector; }
+
+	void moveRight (void)
+	{
+		// (a) shift to the left on query horizontal
+		vqueryh = shiftLeft( vqueryh.simd );
+		vqueryh.elem[LOGICALWIDTH - 1] = queryh[hoffset++];
+
+		// (b) shift left on updated vector 1
+		// this places the right-aligned vector 2 as a left-aligned vector 1
+		antiDiag1.simd = antiDiag2.simd;
+		antiDiag1 = shiftLeft(antiDiag1.simd);
+		antiDiag2.simd = antiDiag3.simd;
+	}
+
+	void moveDown (void)
+	{
+		// (a) shift to the right on query vertical
+		vqueryv = shiftRight(vqueryv.simd);
+		// ==50054==ERROR: AddressSanitizer: heap-buffer-overflow on address 0x60600062b0e0 at pc 
+		// 0x0001019b50f1 bp 0x70000678ba30 sp 0x70000678ba28 READ of size 1 at 0x60600062b0e0 thread T6
+		vqueryv.elem[0] = queryv[voffset++]; 
+
+		// (b) shift to the right on updated vector 2
+		// this places the left-aligned vector 3 as a right-aligned vector 2
+		antiDiag1.simd = antiDiag2.simd;
+		antiDiag2.simd = antiDiag3.simd;
+		antiDiag2 = shiftRight( antiDiag2.simd );
+	}
+
+	// Seed position (define starting position and need to be updated when exiting)
+	SeedX seed;
+	SeedX startSeed;	// as given, for XavierWiden
+
+	// Sequence Lengths
+	unsigned int hlength;
+	unsigned int vlength;
+
+	// Sequences, read in place
+	XavierView queryh;
+	XavierView queryv;
+
+	// Sequence pointers
+	int hoffset;
+	int voffset;
+
+	// Constant Scoring Values
+	ScoringSchemeX scoringScheme;
+	elementType matchCost;
+	elementType mismatchCost;
+	elementType gapCost;
+
+	// Constant Scoring Vectors
+	vectorType vmatchCost;
+	vectorType vmismatchCost;
+	vectorType vgapCost;
+	vectorType vzeros;
+	maskType   vlast;	// the lane after the band, always NINF
+
+	// Computation Vectors
+	vectorUnionType antiDiag1;
+	vectorUnionType antiDiag2;
+	vectorUnionType antiDiag3;
+
+	vectorUnionType vqueryh;
+	vectorUnionType vqueryv;
+
+	// X-Drop Variables
+	int64_t bestScore;
+	int64_t currScore;
+	int64_t scoreOffset;
+	int64_t scoreDropOff;
+	bool xDropCond;
+	bool overflow;	// the band does not fit in the lanes, the extension has to be done in wider ones
+};
+
+void operator+=(XavierState& state1, const XavierState& state2)
+{
+	state1.bestScore = state1.bestScore + state2.bestScore;
+	state1.currScore = state1.currScore + state2.currScore;
+}
+
+void
+XavierPhase1(XavierState& state)
+{
+	myLog("Phase1");
+	// the upper-left triangle of the DP matrix (i + j <= LOGICALWIDTH + 2), one anti-diagonal d = i + j at a time:
+	// lane l holds the cell (l + 1, d - 1 - l). The cells of row 0 (j gaps) come in from lane 0, lane d - 1
+	// is the cell (d, 0) of column 0 (d gaps) and the lanes after it are off the matrix
+	vectorUnionType lane, vh, vv;
+	for(int l = 0; l < VECTORWIDTH; ++l)
+	{
+		lane.elem[l] = l;
+		vh.elem[l] = state.queryh[l];	// H base of row l + 1
+		vv.elem[l] = NINF;
+	}
+	const vectorType ninf = setOp(NINF);
+
+	// x gaps from the corner, saturated like the lanes
+	auto edge = [&state](int x) { return (elementType)std::max((int)NINF, state.get_gap_cost() * x); };
+
+	vectorUnionType antiDiagA, antiDiagB;	// anti-diagonals d - 2 and d - 1
+	antiDiagA.simd = ninf;
+	antiDiagB.simd = ninf;
+	antiDiagB.elem[0] = edge(1);			// d = 1: the cell (1, 0)
+
+	// DPmax tracks maximum value in the triangle for xdrop condition
+	vectorType vDPmax = ninf;
+
+	for(int d = 2; d <= LOGICALWIDTH + 2; ++d)
+	{
+		vv = shiftRight(vv.simd);
+		vv.elem[0] = state.queryv[d - 2];	// V base of column d - 1 - l, on lane l
+
+		vectorUnionType diag = shiftRight(antiDiagA.simd);
+		vectorUnionType up   = shiftRight(antiDiagB.simd);
+		diag.elem[0] = edge(d - 2);
+		up.elem[0]   = edge(d - 1);
+
+		maskType equal  = cmpeqOp(vh.simd, vv.simd);
+		vectorType oneF = addOp(diag.simd, blendvOp(state.get_vmismatchCost(), state.get_vmatchCost(), equal));
+		vectorType twoF = addOp(maxOp(up.simd, antiDiagB.simd), state.get_vgapCost());
+
+		vectorUnionType cells;
+		cells.simd = blendvOp(ninf, maxOp(oneF, twoF), cmpgtOp(setOp(d - 1), lane.simd));
+		vDPmax = maxOp(vDPmax, cells.simd);
+		if(d - 1 < VECTORWIDTH)
+			cells.elem[d - 1] = edge(d);
+
+		antiDiagA = antiDiagB;
+		antiDiagB = cells;
+	}
+
+	int DPmax = std::max(0, (int)hmaxOp(vDPmax));
+	if(WIDENS && DPmax > CUTOFF)
+	{
+		state.overflow = true;
+		return;
+	}
+
+	for(int i = 0; i < LOGICALWIDTH; ++i)
+	{
+		state.update_vqueryh(i, state.queryh[i + 1]);
+		state.update_vqueryv(i, state.queryv[LOGICALWIDTH - i]);
+	}
+
+	state.update_vqueryh(LOGICALWIDTH, NINF);
+	state.update_vqueryv(LOGICALWIDTH, NINF);
+
+	// the last two anti-diagonals of the triangle are antiDiag1 (LOGICALWIDTH + 1) and antiDiag2 (LOGICALWIDTH + 2),
+	// without the cells of column 0 and of column LOGICALWIDTH + 1
+	state.set_antiDiag1(antiDiagA.simd);
+	state.set_antiDiag2(antiDiagB.simd);
+	state.update_antiDiag1(LOGICALWIDTH, NINF);
+	state.update_antiDiag2(0, NINF);
+	state.broadcast_antiDiag3(NINF);
+
+	int antiDiagMax = hmaxOp(state.get_antiDiag1());
+
+	state.set_best_score(DPmax);
+	state.set_curr_score(antiDiagMax);
+
+	if(antiDiagMax < DPmax - state.get_score_dropoff())
+	{
+		state.xDropCond = true;
+
+		setEndPositionH(state.seed, state.hoffset);
+		setEndPositionV(state.seed, state.voffset);
+
+		return;
+	}
+	// antiDiag2 going right, first computation of antiDiag3 is going down
+}
+
+void
+XavierPhase2(XavierState& state)
+{
+	myLog("Phase2");
+	while(state.hoffset < state.hlength && state.voffset < state.vlength)
+	{
+		// antiDiag1F (final)
+		// NOTE: -1 for a match and 0 for a mismatch
+		maskType equal = cmpeqOp(state.get_vqueryh(), state.get_vqueryv());
+		vectorType match = blendvOp(state.get_vmismatchCost(), state.get_vmatchCost(), equal);
+		vectorType antiDiag1F = addOp(match, state.get_antiDiag1());
+
+		// antiDiag2S (shift)
+		vectorUnionType antiDiag2S = shiftLeft(state.get_antiDiag2());
+
+		// antiDiag2M (pairwise max)
+		vectorType antiDiag2M = maxOp(antiDiag2S.simd, state.get_antiDiag2());
+
+		// antiDiag2F (final)
+		vectorType antiDiag2F = addOp(antiDiag2M, state.get_vgapCost());
+
+		// Compute antiDiag3
+		state.set_antiDiag3(maxOp(antiDiag1F, antiDiag2F));
+
+		// we need to have always antiDiag3 left-aligned
+		state.set_antiDiag3(blendvOp(state.get_antiDiag3(), setOp(NINF), state.vlast));
+
+		// x-drop termination, on the max of the anti-diagonal (which the direction below needs anyway)
+		elementType antiDiagBest = hmaxOp(state.get_antiDiag3());
+		state.set_curr_score(antiDiagBest + state.get_score_offset());
+
+		int64_t scoreThreshold = state.get_best_score() - state.get_score_dropoff();
+		if (state.get_curr_score() < scoreThreshold)
+		{
+			state.xDropCond = true;
+			
+			setBeginPositionH(state.seed, 0);
+			setBeginPositionV(state.seed, 0);
+
+			setEndPositionH(state.seed, state.hoffset);
+			setEndPositionV(state.seed, state.voffset);
+			
+			return; // GG: it's a void function and the values are saved in XavierState object
+		}
+
+		// first lane holding the max, the renormalization below may change it
+		elementType max = antiDiagBest;
+
+		if (antiDiagBest > CUTOFF)
+		{
+			elementType min = hminOp(blendvOp(state.get_antiDiag3(), setOp(std::numeric_limits<elementType>::max()), state.vlast));
+			state.set_antiDiag2(subOp(state.get_antiDiag2(), setOp(min)));
+			state.set_antiDiag3(subOp(state.get_antiDiag3(), setOp(min)));
+			state.set_score_offset(state.get_score_offset() + min);
+
+			// the band spans more than CUTOFF: no room left for the next anti-diagonal (or it saturated)
+			max = hmaxOp(state.get_antiDiag3());
+			if (WIDENS && max > CUTOFF)
+			{
+				state.overflow = true;
+				return;
+			}
+		}
+
+		// Update best
+		if (state.get_curr_score() > state.get_best_score())
+			state.set_best_score(state.get_curr_score());
+
+		int maxpos = firstEqualOp(state.get_antiDiag3(), max);
+
+		setEndPositionH(state.seed, state.hoffset);
+		setEndPositionV(state.seed, state.voffset);
+
+		if (maxpos > MIDDLE)
+			state.moveRight();
+		else
+			state.moveDown();
+	}
+}
+
+void
+XavierPhase4(XavierState& state)
+{
+	myLog("Phase4");
+	int dir = state.hoffset >= state.hlength ? goDOWN : goRIGHT;
+
+	for (int i = 0; i < (LOGICALWIDTH - 3); i++)
+	{
+		// antiDiag1F (final)
+		// NOTE: -1 for a match and 0 for a mismatch
+		maskType equal = cmpeqOp(state.get_vqueryh(), state.get_vqueryv());
+		vectorType match = blendvOp(state.get_vmismatchCost(), state.get_vmatchCost(), equal);
+		vectorType antiDiag1F = addOp(match, state.get_antiDiag1());
+
+		// antiDiag2S (shift)
+		vectorUnionType antiDiag2S = shiftLeft(state.get_antiDiag2());
+
+		// antiDiag2M (pairwise max)
+		vectorType antiDiag2M = maxOp(antiDiag2S.simd, state.get_antiDiag2());
+
+		// antiDiag2F (final)
+		vectorType antiDiag2F = addOp(antiDiag2M, state.get_vgapCost());
+
+		// Compute antiDiag3
+		state.set_antiDiag3(maxOp(antiDiag1F, antiDiag2F));
+
+		// we need to have always antiDiag3 left-aligned
+		state.set_antiDiag3(blendvOp(state.get_antiDiag3(), setOp(NINF), state.vlast));
+
+		// x-drop termination
+		elementType antiDiagBest = hmaxOp(state.get_antiDiag3());
+		state.set_curr_score(antiDiagBest + state.get_score_offset());
+
+		int64_t scoreThreshold = state.get_best_score() - state.get_score_dropoff();
+
+		if (state.get_curr_score() < scoreThreshold)
+		{
+			state.xDropCond = true;
+			return; // GG: it's a void function and the values are saved in XavierState object
+		}
+
+		if (antiDiagBest > CUTOFF)
+		{
+			elementType min = hminOp(blendvOp(state.get_antiDiag3(), setOp(std::numeric_limits<elementType>::max()), state.vlast));
+			state.set_antiDiag2(subOp(state.get_antiDiag2(), setOp(min)));
+			state.set_antiDiag3(subOp(state.get_antiDiag3(), setOp(min)));
+			state.set_score_offset(state.get_score_offset() + min);
+
+			if (WIDENS && hmaxOp(state.get_antiDiag3()) > CUTOFF)
+			{
+				state.overflow = true;
+				return;
+			}
+		}
+
+		// Update best
+		if (state.get_curr_score() > state.get_best_score())
+			state.set_best_score(state.get_curr_score());
+
+		// antiDiag swap, offset updates, and new base load
+		short nextDir = dir ^ 1;
+
+		if (nextDir == goRIGHT)
+			state.moveRight();
+		else
+			state.moveDown();
+
+		// Update direction
+		dir = nextDir;
+	}
+}
+
+//======================================================================================
+// X-DROP ADAPTIVE BANDED ALIGNMENT
+//======================================================================================
+
+#ifdef XAVIER_WIDER
+// the extension of state from the start in int16 lanes, its result back in state. The int16 band has
+// half the cells of the int8 one, but a band whose scores spread past CUTOFF does not fit in int8 at all
+void
+XavierWiden (XavierState& state) {
+
+	XAVIER_WIDER::XavierState wide(state.startSeed, state.queryh, state.queryv, state.scoringScheme, state.scoreDropOff);
+	XAVIER_WIDER::XavierOneDirection(wide);
+
+	state.seed      = wide.seed;
+	state.bestScore = wide.bestScore;
+	state.currScore = wide.currScore;
+	state.xDropCond = wide.xDropCond;
+	state.overflow  = false;
+}
+#endif
+
+void
+XavierOneDirection (XavierState& state) {
+
+	if(!state.overflow)
+	{
+		// PHASE 1 (initial values load using dynamic programming)
+		XavierPhase1(state);
+		if(state.xDropCond) return;
+
+		// PHASE 2 (core vectorized computation)
+		if(!state.overflow) XavierPhase2(state);
+		if(state.xDropCond) return;
+
+		// PHASE 3 (align on one edge)
+		// GG: Phase3 removed to read to code easily (can be recovered from simd/ folder or older commits)
+
+		// PHASE 4 (reaching end of sequences)
+		if(!state.overflow) XavierPhase4(state);
+		if(state.xDropCond) return;
+	}
+
+#ifdef XAVIER_WIDER
+	if(state.overflow) XavierWiden(state);
+#endif
+}
+
+std::pair<int, int>
+XavierXDrop
+(
+	SeedX& seed,
+	ExtDirectionL direction,
+	XavierView const& target,
+	XavierView const& query,
+	ScoringSchemeX& scoringScheme,
+	int const &scoreDropOff
+)
+{
+	// TODO: add check scoring scheme correctness/input parameters
+
+	if (direction == XAVIER_EXTEND_LEFT)
+	{
+		SeedX _seed = seed; // need temporary datastruct
+
+		XavierView targetPrefix = target.reversedPrefix (getEndPositionH(seed));	// from read start til start seed (seed included)
+		XavierView queryPrefix  = query.reversedPrefix  (getEndPositionV(seed));	// from read start til start seed (seed included)
+
+		XavierState result (_seed, targetPrefix, queryPrefix, scoringScheme, scoreDropOff);
+
+		if (targetPrefix.length >= VECTORWIDTH || queryPrefix.length >= VECTORWIDTH) 
+			XavierOneDirection (result);
+
+		setBeginPositionH(seed, getEndPositionH(seed) - getEndPositionH(result.seed));
+		setBeginPositionV(seed, getEndPositionV(seed) - getEndPositionV(result.seed));
+
+		return std::make_pair(result.get_best_score(), result.get_curr_score());
+	}
+	else if (direction == XAVIER_EXTEND_RIGHT)
+	{
+		SeedX _seed = seed; // need temporary datastruct
+
+		XavierView targetSuffix = target.suffix (getBeginPositionH(seed)); 	// from end seed until the end (seed included)
+		XavierView querySuffix  = query.suffix  (getBeginPositionV(seed));		// from end seed until the end (seed included)
+
+		XavierState result (_seed, targetSuffix, querySuffix, scoringScheme, scoreDropOff);
+
+		if (targetSuffix.length >= VECTORWIDTH || querySuffix.length >= VECTORWIDTH) 
+			XavierOneDirection (result);
+
+		setEndPositionH (seed, getBeginPositionH(seed) + getEndPositionH(result.seed));
+		setEndPositionV (seed, getBeginPositionV(seed) + getEndPositionV(result.seed));
+
+		return std::make_pair(result.get_best_score(), result.get_curr_score());
+	}
+	else
+	{
+		SeedX _seed1 = seed; // need temporary datastruct
+		SeedX _seed2 = seed; // need temporary datastruct
+
+		XavierView targetPrefix = target.reversedPrefix (getEndPositionH(seed));	// from read start til start seed (seed not included)
+		XavierView queryPrefix  = query.reversedPrefix  (getEndPositionV(seed));	// from read start til start seed (seed not included)
+
+		XavierState result1(_seed1, targetPrefix, queryPrefix, scoringScheme, scoreDropOff);
+
+		if (targetPrefix.length < VECTORWIDTH || queryPrefix.length < VECTORWIDTH) 
+		{
+			setBeginPositionH (seed, getEndPositionH(seed) - targetPrefix.length);
+			setBeginPositionV (seed, getEndPositionV(seed) - queryPrefix.length);
+		}
+		else
+		{
+			XavierOneDirection (result1);
+
+			setBeginPositionH (seed, getEndPositionH(seed) - getEndPositionH(result1.seed));
+			setBeginPositionV (seed, getEndPositionV(seed) - getEndPositionV(result1.seed));
+		}
+
+		XavierView targetSuffix = target.suffix (getEndPositionH(seed)); 	// from end seed until the end (seed included)
+		XavierView querySuffix  = query.suffix  (getEndPositionV(seed));	// from end seed until the end (seed included)
+
+		XavierState result2(_seed2, targetSuffix, querySuffix, scoringScheme, scoreDropOff);
+
+		if (targetSuffix.length < VECTORWIDTH || querySuffix.length < VECTORWIDTH) 
+		{
+			setBeginPositionH (seed, getEndPositionH(seed) + targetSuffix.length);
+			setBeginPositionV (seed, getEndPositionV(seed) + querySuffix.length);
+		}
+		else
+		{
+			XavierOneDirection (result2);
+			
+			setEndPositionH (seed, getEndPositionH(seed) + getEndPositionH(result2.seed));
+			setEndPositionV (seed, getEndPositionV(seed) + getEndPositionV(result2.seed));
+		}
+
+		// seed already updated and saved in result1
+		// this operation sums up best and exit scores for result1 and result2 and stores them in result1
+		result1 += result2;
+		return std::make_pair(result1.get_best_score(), result1.get_curr_score());
+	}
+}
@@ -8,49 +8,35 @@
 #define SIMD_UTILS_H
 
 #include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <x86intrin.h>
 #include "score.h"
 #include "utils.h"
 
-//======================================================================================
-// GLOBAL FUNCTION DECLARATION
-//======================================================================================
-
-#ifndef __AVX2__
-#define __AVX2__
-#endif
-
-#ifdef  __AVX2__ 	// Compile flag: -mavx2
-#define VECTORWIDTH  (32)
-#define LOGICALWIDTH (VECTORWIDTH - 1)
-#define vectorType   __m256i
-#define addOp    	_mm256_adds_epi8  	// saturated arithmetic
-#define subOp    	_mm256_subs_epi8  	// saturated arithmetic
-#define maxOp    	_mm256_max_epi8   	// max
-#define setOp   	_mm256_set1_epi8  	// set1 operation
-#define blendvOp	_mm256_blendv_epi8  // blending operation
-#define cmpeqOp 	_mm256_cmpeq_epi8 	// compare equality operation
-#elif __SSE4_2__ 	// Compile flag: -msse4.2
-#define VECTORWIDTH  (8)
-#define LOGICALWIDTH (VECTORWIDTH - 1)
-#define vectorType  __m128i
-#define addOp    	_mm_adds_epi16 	// saturated arithmetic
-#define subOp    	_mm_subs_epi16  // saturated arithmetic
-#define maxOp    	_mm_max_epi16  	// max
-#define setOp   	_mm_set1_epi16  // set1 operation
-#define blendvOp 	_mm_blendv_epi8 // blending operation
-#define cmpeqOp  	_mm_cmpeq_epi16 // compare equality operation
-#endif
+/*
+ * Xavier is built once per instruction set and lane width, whatever the -m flags of the build: each one has
+ * a namespace with the same names (elementType, NINF, CUTOFF, vectorType, maskType, VECTORWIDTH and the
+ * operations below), compiled under #pragma GCC target, and xavier.h includes the kernel (kernel.h) in each of them.
+ *  - xavier_sse42:  16 int8 lanes
+ *  - xavier_avx2:   32 int8 lanes
+ *  - xavier_avx512: 64 int8 lanes, compare and blend through mask registers
+ *  - xavier_sse42_16, xavier_avx2_16, xavier_avx512_16: the same with int16 lanes (8, 16 and 32 of them),
+ *    for the extensions whose scores do not fit in int8 (see XavierWiden in kernel.h)
+ * Scores above CUTOFF are renormalized, the HEADROOM above it is what one anti-diagonal can add.
+ * shiftLeftOp moves every element one lane down (elem[i] = elem[i+1]), shiftRightOp one lane up,
+ * the lane left empty is filled by shiftLeft/shiftRight of kernel.h.
+ * hmaxOp/hminOp reduce a vector to its largest/smallest element in log2(VECTORWIDTH) steps, firstEqualOp is
+ * the first lane holding a value (which has to be there), from the compare mask
+ */
 
 //======================================================================================
 // GLOBAL VARIABLE DEFINITION
 //======================================================================================
 
-#define NINF  	(std::numeric_limits<int8_t>::min())
 #define goRIGHT (0)
 #define goDOWN  (1)
-#define MIDDLE 	(LOGICALWIDTH / 2)
-
-#define CUTOFF	(std::numeric_limits<int8_t>::max() - 25)
 
 #ifdef DEBUG
 	#define myLog( var ) do { std::cerr << "LOG:	" << __FILE__ << "(" << __LINE__ << ")	" << #var << " = " << (var) << std::endl; } while(0)
@@ -58,40 +44,48 @@
 	#define myLog( var )
 #endif
 
-//======================================================================================
-// SIMD UTILS
-//======================================================================================
-
-typedef int8_t elementType;
-
-typedef union {
-	vectorType  	simd;
-	elementType 	elem[VECTORWIDTH];
-} vectorUnionType;
-
-void
-printVectorC(vectorType a) {
-
-	vectorUnionType tmp;
-	tmp.simd = a;
+// bases of a sequence read in place: base x is seq[x * step] (complemented if comp), so a reversed prefix
+// or the reverse complement of a read is a view of the read itself, not a copy. Past the end it reads
+// like the copies it replaces: the terminating null of the string, then int8 NINF padding
+struct XavierView
+{
+	const char* seq;
+	long step;
+	int length;
+	bool comp;
 
-	printf("{");
-	for (int i = 0; i < VECTORWIDTH-1; ++i)
-		printf("%c,", tmp.elem[i]);
-	printf("%c}\n", tmp.elem[VECTORWIDTH-1]);
-}
+	XavierView(const char* seq, long step, int length, bool comp) : seq(seq), step(step), length(length), comp(comp) {}
+	XavierView(std::string const& s) : seq(s.data()), step(1), length(s.length()), comp(false) {}
 
-void
-printVectorD(vectorType a) {
+	int8_t operator[](int x) const
+	{
+		if(x < length)
+			return comp ? complement(seq[x * step]) : seq[x * step];
+		return x == length ? 0 : std::numeric_limits<int8_t>::min();
+	}
 
-	vectorUnionType tmp;
-	tmp.simd = a;
+	// bases [0, end) from the last one back
+	XavierView reversedPrefix(int end) const { return XavierView(seq + (end - 1) * step, -step, end, comp); }
+	// bases [begin, length)
+	XavierView suffix(int begin) const { return XavierView(seq + begin * step, step, length - begin, comp); }
+	// reverse complement
+	XavierView twin() const { return XavierView(seq + (length - 1) * step, -step, length, !comp); }
 
-	printf("{");
-	for (int i = 0; i < VECTORWIDTH-1; ++i)
-		printf("%d,", tmp.elem[i]);
-	printf("%d}\n", tmp.elem[VECTORWIDTH-1]);
-}
+	// A/C/G/T and a/c/g/t, anything else is its own complement (what ReadStore::twin gives)
+	static char complement(char c)
+	{
+		static const struct Table {
+			char t[256];
+			Table()
+			{
+				for(int b = 0; b < 256; ++b) t[b] = b;
+				t['A'] = 'T'; t['C'] = 'G'; t['G'] = 'C'; t['T'] = 'A';
+				t['a'] = 't'; t['c'] = 'g'; t['g'] = 'c'; t['t'] = 'a';
+			}
+		} table;
+		return table.t[(unsigned char)c];
+	}
+};
 
 enum ExtDirectionL
 {
@@ -101,239 +95,235 @@ enum ExtDirectionL
 	XAVIER_EXTEND_BOTH  = 3
 };
 
-#ifdef __AVX2__
-
-inline vectorUnionType
-shiftLeft (const vectorType& _a) { // this work for avx2
+//======================================================================================
+// SIMD UTILS
+//======================================================================================
 
-	vectorUnionType a;
-	a.simd = _a;
+namespace xavier_sse42 {
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
 
-	vectorUnionType b;
-	// https://stackoverflow.com/questions/25248766/emulating-shifts-on-32-bytes-with-avx
-	b.simd = _mm256_alignr_epi8(_mm256_permute2x128_si256(a.simd, a.simd, _MM_SHUFFLE(2, 0, 0, 1)), a.simd, 1);
-	b.elem[VECTORWIDTH - 1] = NINF;
+typedef int8_t elementType;
+const int HEADROOM = 25;
+const elementType NINF   = std::numeric_limits<elementType>::min();
+const elementType CUTOFF = std::numeric_limits<elementType>::max() - HEADROOM;
+
+const int VECTORWIDTH = 16;
+typedef __m128i vectorType;
+typedef __m128i maskType;
+
+inline vectorType addOp   (vectorType a, vectorType b) { return _mm_adds_epi8(a, b); }	// saturated arithmetic
+inline vectorType subOp   (vectorType a, vectorType b) { return _mm_subs_epi8(a, b); }	// saturated arithmetic
+inline vectorType maxOp   (vectorType a, vectorType b) { return _mm_max_epi8(a, b);  }
+inline vectorType setOp   (elementType a) { return _mm_set1_epi8(a); }
+inline vectorType zeroOp  () { return _mm_setzero_si128(); }
+inline maskType   cmpeqOp (vectorType a, vectorType b) { return _mm_cmpeq_epi8(a, b); }
+inline vectorType blendvOp(vectorType a, vectorType b, maskType m) { return _mm_blendv_epi8(a, b, m); }
+inline maskType   cmpgtOp (vectorType a, vectorType b) { return _mm_cmpgt_epi8(a, b); }
+inline vectorType shiftLeftOp (vectorType a) { return _mm_srli_si128(a, 1); }
+inline vectorType shiftRightOp(vectorType a) { return _mm_slli_si128(a, 1); }
+
+inline elementType hmaxOp(__m128i a)
+{
+	a = _mm_max_epi8(a, _mm_srli_si128(a, 8));
+	a = _mm_max_epi8(a, _mm_srli_si128(a, 4));
+	a = _mm_max_epi8(a, _mm_srli_si128(a, 2));
+	a = _mm_max_epi8(a, _mm_srli_si128(a, 1));
+	return (elementType)_mm_cvtsi128_si32(a);
+}
 
-	return b;
+inline elementType hminOp(__m128i a)
+{
+	a = _mm_min_epi8(a, _mm_srli_si128(a, 8));
+	a = _mm_min_epi8(a, _mm_srli_si128(a, 4));
+	a = _mm_min_epi8(a, _mm_srli_si128(a, 2));
+	a = _mm_min_epi8(a, _mm_srli_si128(a, 1));
+	return (elementType)_mm_cvtsi128_si32(a);
 }
 
-inline vectorUnionType
-shiftRight (const vectorType& _a) { // this work for avx2
-	vectorUnionType a;
-	a.simd = _a;
+inline int firstEqualOp(vectorType a, elementType x) { return __builtin_ctz(_mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_set1_epi8(x)))); }
 
-	vectorUnionType b;
-	// https://stackoverflow.com/questions/25248766/emulating-shifts-on-32-bytes-with-avx
-	b.simd = _mm256_alignr_epi8(a.simd, _mm256_permute2x128_si256(a.simd, a.simd, _MM_SHUFFLE(0, 0, 2, 0)), 16 - 1);
-	b.elem[0] = NINF;
-	return b;
+#pragma GCC pop_options
 }
 
-#elif __SSE4_2__
+namespace xavier_avx2 {
+#pragma GCC push_options
+#pragma GCC target("avx2")
 
-inline vectorUnionType
-shiftLeft(const vectorType& _a) { // this work for avx2
-	vectorUnionType a;
-	a.simd = _a;
-
-	vectorUnionType b;
-	// https://stackoverflow.com/questions/25248766/emulating-shifts-on-32-bytes-with-avx
-	b.simd = _mm256_alignr_epi8(_mm256_permute2x128_si256(a.simd, a.simd, _MM_SHUFFLE(2, 0, 0, 1)), a.simd, 2);
-	b.elem[VECTORWIDTH - 1] = NINF;
-	return b;
+typedef int8_t elementType;
+const int HEADROOM = 25;
+const elementType NINF   = std::numeric_limits<elementType>::min();
+const elementType CUTOFF = std::numeric_limits<elementType>::max() - HEADROOM;
+
+const int VECTORWIDTH = 32;
+typedef __m256i vectorType;
+typedef __m256i maskType;
+
+inline vectorType addOp   (vectorType a, vectorType b) { return _mm256_adds_epi8(a, b); }	// saturated arithmetic
+inline vectorType subOp   (vectorType a, vectorType b) { return _mm256_subs_epi8(a, b); }	// saturated arithmetic
+inline vectorType maxOp   (vectorType a, vectorType b) { return _mm256_max_epi8(a, b);  }
+inline vectorType setOp   (elementType a) { return _mm256_set1_epi8(a); }
+inline vectorType zeroOp  () { return _mm256_setzero_si256(); }
+inline maskType   cmpeqOp (vectorType a, vectorType b) { return _mm256_cmpeq_epi8(a, b); }
+inline vectorType blendvOp(vectorType a, vectorType b, maskType m) { return _mm256_blendv_epi8(a, b, m); }
+inline maskType   cmpgtOp (vectorType a, vectorType b) { return _mm256_cmpgt_epi8(a, b); }
+
+// https://stackoverflow.com/questions/25248766/emulating-shifts-on-32-bytes-with-avx
+inline vectorType shiftLeftOp (vectorType a) { return _mm256_alignr_epi8(_mm256_permute2x128_si256(a, a, _MM_SHUFFLE(2, 0, 0, 1)), a, 1); }
+inline vectorType shiftRightOp(vectorType a) { return _mm256_alignr_epi8(a, _mm256_permute2x128_si256(a, a, _MM_SHUFFLE(0, 0, 2, 0)), 16 - 1); }
+
+inline elementType hmaxOp(vectorType a) { return xavier_sse42::hmaxOp(_mm_max_epi8(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1))); }
+inline elementType hminOp(vectorType a) { return xavier_sse42::hminOp(_mm_min_epi8(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1))); }
+inline int firstEqualOp(vectorType a, elementType x) { return __builtin_ctz((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, _mm256_set1_epi8(x)))); }
+
+#pragma GCC pop_options
 }
 
-inline vectorUnionType
-shiftRight(const vectorType& _a) { // this work for avx2
-	vectorUnionType a;
-	a.simd = _a;
+namespace xavier_avx512 {
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
 
-	vectorUnionType b;
-	// https://stackoverflow.com/questions/25248766/emulating-shifts-on-32-bytes-with-avx
-	b.simd = _mm256_alignr_epi8(a.simd, _mm256_permute2x128_si256(a.simd, a.simd, _MM_SHUFFLE(0, 0, 2, 0)), 16 - 2);
-	b.elem[0] = NINF;
-	return b;
+typedef int8_t elementType;
+const int HEADROOM = 25;
+const elementType NINF   = std::numeric_limits<elementType>::min();
+const elementType CUTOFF = std::numeric_limits<elementType>::max() - HEADROOM;
+
+const int VECTORWIDTH = 64;
+typedef __m512i vectorType;
+typedef __mmask64 maskType;
+
+inline vectorType addOp   (vectorType a, vectorType b) { return _mm512_adds_epi8(a, b); }	// saturated arithmetic
+inline vectorType subOp   (vectorType a, vectorType b) { return _mm512_subs_epi8(a, b); }	// saturated arithmetic
+inline vectorType maxOp   (vectorType a, vectorType b) { return _mm512_max_epi8(a, b);  }
+inline vectorType setOp   (elementType a) { return _mm512_set1_epi8(a); }
+inline vectorType zeroOp  () { return _mm512_setzero_si512(); }
+inline maskType   cmpeqOp (vectorType a, vectorType b) { return _mm512_cmpeq_epi8_mask(a, b); }
+inline vectorType blendvOp(vectorType a, vectorType b, maskType m) { return _mm512_mask_blend_epi8(m, a, b); }
+inline maskType   cmpgtOp (vectorType a, vectorType b) { return _mm512_cmpgt_epi8_mask(a, b); }
+
+// alignr_epi8 works within 128-bit lanes: the byte crossing each lane comes from the next (previous) lane,
+// moved in place by alignr_epi32
+inline vectorType shiftLeftOp (vectorType a) { return _mm512_alignr_epi8(_mm512_alignr_epi32(zeroOp(), a, 4), a, 1); }
+inline vectorType shiftRightOp(vectorType a) { return _mm512_alignr_epi8(a, _mm512_alignr_epi32(a, zeroOp(), 12), 16 - 1); }
+
+inline elementType hmaxOp(vectorType a) { return xavier_avx2::hmaxOp(_mm256_max_epi8(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1))); }
+inline elementType hminOp(vectorType a) { return xavier_avx2::hminOp(_mm256_min_epi8(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1))); }
+inline int firstEqualOp(vectorType a, elementType x) { return __builtin_ctzll(_mm512_cmpeq_epi8_mask(a, _mm512_set1_epi8(x))); }
+
+#pragma GCC pop_options
 }
 
-#endif
+//======================================================================================
+// SIMD UTILS, 16-BIT LANES
+//======================================================================================
 
-class XavierState
+namespace xavier_sse42_16 {
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+
+typedef int16_t elementType;
+const int HEADROOM = 1024;
+const elementType NINF   = std::numeric_limits<elementType>::min();
+const elementType CUTOFF = std::numeric_limits<elementType>::max() - HEADROOM;
+
+const int VECTORWIDTH = 8;
+typedef __m128i vectorType;
+typedef __m128i maskType;
+
+inline vectorType addOp   (vectorType a, vectorType b) { return _mm_adds_epi16(a, b); }	// saturated arithmetic
+inline vectorType subOp   (vectorType a, vectorType b) { return _mm_subs_epi16(a, b); }	// saturated arithmetic
+inline vectorType maxOp   (vectorType a, vectorType b) { return _mm_max_epi16(a, b);  }
+inline vectorType setOp   (elementType a) { return _mm_set1_epi16(a); }
+inline vectorType zeroOp  () { return _mm_setzero_si128(); }
+inline maskType   cmpeqOp (vectorType a, vectorType b) { return _mm_cmpeq_epi16(a, b); }
+inline vectorType blendvOp(vectorType a, vectorType b, maskType m) { return _mm_blendv_epi8(a, b, m); }	// the mask has both bytes of a lane
+inline maskType   cmpgtOp (vectorType a, vectorType b) { return _mm_cmpgt_epi16(a, b); }
+inline vectorType shiftLeftOp (vectorType a) { return _mm_srli_si128(a, 2); }
+inline vectorType shiftRightOp(vectorType a) { return _mm_slli_si128(a, 2); }
+
+inline elementType hmaxOp(__m128i a)
 {
-public:
-
-	XavierState
-	(
-		SeedX& _seed,
-	 	std::string const& hseq,
-		std::string const& vseq,
-		ScoringSchemeX& scoringScheme,
-		int64_t const &_scoreDropOff
-	)
-	{
-		seed = _seed;
-
-		hlength = hseq.length() + 1;	// + VECTORWIDTH;
-		vlength = vseq.length() + 1;	// + VECTORWIDTH;
-
-		if (hlength < VECTORWIDTH || vlength < VECTORWIDTH)
-		{
-			setEndPositionH(seed, hlength);
-			setEndPositionV(seed, vlength);
-			//	GG: main function takes care of this
-			// 	return;
-		}
-
-		// Convert from string to int array
-		// This is the entire sequences
-		queryh = new int8_t[hlength + VECTORWIDTH];
-		queryv = new int8_t[vlength + VECTORWIDTH];
-
-		std::copy(hseq.begin(), hseq.begin() + hlength, queryh);
-		std::copy(vseq.begin(), vseq.begin() + vlength, queryv);
-
-		std::fill(queryh + hlength, queryh + hlength + VECTORWIDTH, NINF);
-		std::fill(queryv + vlength, queryv + vlength + VECTORWIDTH, NINF);
-
-		matchCost    = scoreMatch(scoringScheme   );
-		mismatchCost = scoreMismatch(scoringScheme);
-		gapCost      = scoreGap(scoringScheme     );
-
-		vmatchCost    = setOp (matchCost   );
-		vmismatchCost = setOp (mismatchCost);
-		vgapCost      = setOp (gapCost     );
-		vzeros        = _mm256_setzero_si256();
-
-		hoffset = LOGICALWIDTH;
-		voffset = LOGICALWIDTH;
-
-		bestScore    = 0;
-		currScore    = 0;
-		scoreOffset  = 0;
-		scoreDropOff = _scoreDropOff;
-		xDropCond   = false;
-	}
+	a = _mm_max_epi16(a, _mm_srli_si128(a, 8));
+	a = _mm_max_epi16(a, _mm_srli_si128(a, 4));
+	a = _mm_max_epi16(a, _mm_srli_si128(a, 2));
+	return (elementType)_mm_cvtsi128_si32(a);
+}
 
-	~XavierState()
-	{
-		delete [] queryh;
-		delete [] queryv;
-	}
+inline elementType hminOp(__m128i a)
+{
+	a = _mm_min_epi16(a, _mm_srli_si128(a, 8));
+	a = _mm_min_epi16(a, _mm_srli_si128(a, 4));
+	a = _mm_min_epi16(a, _mm_srli_si128(a, 2));
+	return (elementType)_mm_cvtsi128_si32(a);
+}
 
-	// i think this can be smaller than 64bit
-	int64_t get_score_offset  ( void ) { return scoreOffset;  }
-	int64_t get_best_score    ( void ) { return bestScore;    }
-	int64_t get_curr_score    ( void ) { return currScore;    }
-	int64_t get_score_dropoff ( void ) { return scoreDropOff; }
+inline int firstEqualOp(vectorType a, elementType x) { return __builtin_ctz(_mm_movemask_epi8(_mm_cmpeq_epi16(a, _mm_set1_epi16(x)))) / 2; }
 
-	void set_score_offset ( int64_t _scoreOffset ) { scoreOffset = _scoreOffset; }
-	void set_best_score   ( int64_t _bestScore   ) { bestScore   = _bestScore;   }
-	void set_curr_score   ( int64_t _currScore   ) { currScore   = _currScore;   }
+#pragma GCC pop_options
+}
 
-	int8_t get_match_cost    ( void ) { return matchCost;    }
-	int8_t get_mismatch_cost ( void ) { return mismatchCost; }
-	int8_t get_gap_cost      ( void ) { return gapCost;      }
+namespace xavier_avx2_16 {
+#pragma GCC push_options
+#pragma GCC target("avx2")
 
-	vectorType get_vqueryh ( void ) { return vqueryh.simd; }
-	vectorType get_vqueryv ( void ) { return vqueryv.simd; }
+typedef int16_t elementType;
+const int HEADROOM = 1024;
+const elementType NINF   = std::numeric_limits<elementType>::min();
+const elementType CUTOFF = std::numeric_limits<elementType>::max() - HEADROOM;
 
-	vectorType get_antiDiag1 ( void ) { return antiDiag1.simd; }
-	vectorType get_antiDiag2 ( void ) { return antiDiag2.simd; }
-	vectorType get_antiDiag3 ( void ) { return antiDiag3.simd; }
+const int VECTORWIDTH = 16;
+typedef __m256i vectorType;
+typedef __m256i maskType;
 
-	vectorType get_vmatchCost    ( void ) { return vmatchCost;    }
-	vectorType get_vmismatchCost ( void ) { return vmismatchCost; }
-	vectorType get_vgapCost      ( void ) { return vgapCost;      }
-	vectorType get_vzeros        ( void ) { return vzeros;        }
+inline vectorType addOp   (vectorType a, vectorType b) { return _mm256_adds_epi16(a, b); }	// saturated arithmetic
+inline vectorType subOp   (vectorType a, vectorType b) { return _mm256_subs_epi16(a, b); }	// saturated arithmetic
+inline vectorType maxOp   (vectorType a, vectorType b) { return _mm256_max_epi16(a, b);  }
+inline vectorType setOp   (elementType a) { return _mm256_set1_epi16(a); }
+inline vectorType zeroOp  () { return _mm256_setzero_si256(); }
+inline maskType   cmpeqOp (vectorType a, vectorType b) { return _mm256_cmpeq_epi16(a, b); }
+inline vectorType blendvOp(vectorType a, vectorType b, maskType m) { return _mm256_blendv_epi8(a, b, m); }
+inline maskType   cmpgtOp (vectorType a, vectorType b) { return _mm256_cmpgt_epi16(a, b); }
 
-	void update_vqueryh ( uint8_t idx, int8_t value ) { vqueryh.elem[idx] = value; }
-	void update_vqueryv ( uint8_t idx, int8_t value ) { vqueryv.elem[idx] = value; }
+inline vectorType shiftLeftOp (vectorType a) { return _mm256_alignr_epi8(_mm256_permute2x128_si256(a, a, _MM_SHUFFLE(2, 0, 0, 1)), a, 2); }
+inline vectorType shiftRightOp(vectorType a) { return _mm256_alignr_epi8(a, _mm256_permute2x128_si256(a, a, _MM_SHUFFLE(0, 0, 2, 0)), 16 - 2); }
 
-	void update_antiDiag1 ( uint8_t idx, int8_t value ) { antiDiag1.elem[idx] = value; }
-	void update_antiDiag2 ( uint8_t idx, int8_t value ) { antiDiag2.elem[idx] = value; }
-	void update_antiDiag3 ( uint8_t idx, int8_t value ) { antiDiag3.elem[idx] = value; }
+inline elementType hmaxOp(vectorType a) { return xavier_sse42_16::hmaxOp(_mm_max_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1))); }
+inline elementType hminOp(vectorType a) { return xavier_sse42_16::hminOp(_mm_min_epi16(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1))); }
+inline int firstEqualOp(vectorType a, elementType x) { return __builtin_ctz((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi16(a, _mm256_set1_epi16(x)))) / 2; }
 
-	void broadcast_antiDiag1 ( int8_t value ) { antiDiag1.simd = setOp( value ); }
-	void broadcast_antiDiag2 ( int8_t value ) { antiDiag2.simd = setOp( value ); }
-	void broadcast_antiDiag3 ( int8_t value ) { antiDiag3.simd = setOp( value ); }
+#pragma GCC pop_options
+}
 
-	void set_antiDiag1 ( vectorType vector ) { antiDiag1.simd = vector; }
-	void set_antiDiag2 ( vectorType vector ) { antiDiag2.simd = vector; }
-	void set_antiDiag3 ( vectorType vector ) { antiDiag3.simd = vector; }
+namespace xavier_avx512_16 {
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
 
-	void moveRight (void)
-	{
-		// (a) shift to the left on query horizontal
-		vqueryh = shiftLeft( vqueryh.simd );
-		vqueryh.elem[LOGICALWIDTH - 1] = queryh[hoffset++];
-
-		// (b) shift left on updated vector 1
-		// this places the right-aligned vector 2 as a left-aligned vector 1
-		antiDiag1.simd = antiDiag2.simd;
-		antiDiag1 = shiftLeft(antiDiag1.simd);
-		antiDiag2.simd = antiDiag3.simd;
-	}
+typedef int16_t elementType;
+const int HEADROOM = 1024;
+const elementType NINF   = std::numeric_limits<elementType>::min();
+const elementType CUTOFF = std::numeric_limits<elementType>::max() - HEADROOM;
 
-	void moveDown (void)
-	{
-		// (a) shift to the right on query vertical
-		vqueryv = shiftRight(vqueryv.simd);
-		// ==50054==ERROR: AddressSanitizer: heap-buffer-overflow on address 0x60600062b0e0 at pc 
-		// 0x0001019b50f1 bp 0x70000678ba30 sp 0x70000678ba28 READ of size 1 at 0x60600062b0e0 thread T6
-		vqueryv.elem[0] = queryv[voffset++]; 
-
-		// (b) shift to the right on updated vector 2
-		// this places the left-aligned vector 3 as a right-aligned vector 2
-		antiDiag1.simd = antiDiag2.simd;
-		antiDiag2.simd = antiDiag3.simd;
-		antiDiag2 = shiftRight( antiDiag2.simd );
-	}
+const int VECTORWIDTH = 32;
+typedef __m512i vectorType;
+typedef __mmask32 maskType;
 
-	// Seed position (define starting position and need to be updated when exiting)
-	SeedX seed;
-
-	// Sequence Lengths
-	unsigned int hlength;
-	unsigned int vlength;
-
-	// Sequences as ints
-	int8_t* queryh;
-	int8_t* queryv;
-
-	// Sequence pointers
-	int hoffset;
-	int voffset;
-
-	// Constant Scoring Values
-	int8_t matchCost;
-	int8_t mismatchCost;
-	int8_t gapCost;
-
-	// Constant Scoring Vectors
-	vectorType vmatchCost;
-	vectorType vmismatchCost;
-	vectorType vgapCost;
-	vectorType vzeros;
-
-	// Computation Vectors
-	vectorUnionType antiDiag1;
-	vectorUnionType antiDiag2;
-	vectorUnionType antiDiag3;
-
-	vectorUnionType vqueryh;
-	vectorUnionType vqueryv;
-
-	// X-Drop Variables
-	int64_t bestScore;
-	int64_t currScore;
-	int64_t scoreOffset;
-	int64_t scoreDropOff;
-	bool xDropCond;
-};
+inline vectorType addOp   (vectorType a, vectorType b) { return _mm512_adds_epi16(a, b); }	// saturated arithmetic
+inline vectorType subOp   (vectorType a, vectorType b) { return _mm512_subs_epi16(a, b); }	// saturated arithmetic
+inline vectorType maxOp   (vectorType a, vectorType b) { return _mm512_max_epi16(a, b);  }
+inline vectorType setOp   (elementType a) { return _mm512_set1_epi16(a); }
+inline vectorType zeroOp  () { return _mm512_setzero_si512(); }
+inline maskType   cmpeqOp (vectorType a, vectorType b) { return _mm512_cmpeq_epi16_mask(a, b); }
+inline vectorType blendvOp(vectorType a, vectorType b, maskType m) { return _mm512_mask_blend_epi16(m, a, b); }
+inline maskType   cmpgtOp (vectorType a, vectorType b) { return _mm512_cmpgt_epi16_mask(a, b); }
 
-void operator+=(XavierState& state1, const XavierState& state2)
-{
-	state1.bestScore = state1.bestScore + state2.bestScore;
-	state1.currScore = state1.currScore + state2.currScore;
+inline vectorType shiftLeftOp (vectorType a) { return _mm512_alignr_epi8(_mm512_alignr_epi32(zeroOp(), a, 4), a, 2); }
+inline vectorType shiftRightOp(vectorType a) { return _mm512_alignr_epi8(a, _mm512_alignr_epi32(a, zeroOp(), 12), 16 - 2); }
+
+inline elementType hmaxOp(vectorType a) { return xavier_avx2_16::hmaxOp(_mm256_max_epi16(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1))); }
+inline elementType hminOp(vectorType a) { return xavier_avx2_16::hminOp(_mm256_min_epi16(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1))); }
+inline int firstEqualOp(vectorType a, elementType x) { return __builtin_ctz(_mm512_cmpeq_epi16_mask(a, _mm512_set1_epi16(x))); }
+
+#pragma GCC pop_options
 }
 
 #endif
\ No newline at end of file
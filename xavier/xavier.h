@@ -8,368 +8,198 @@
 #define XAVIER_H
 
 #include<vector>
+#include<string>
 #include<iostream>
 #include<omp.h>
 #include<algorithm>
 #include<inttypes.h>
 #include<assert.h>
 #include<iterator>
+#include<stdlib.h>
 #include<x86intrin.h>
 #include"simdutils.h"
+#include"batch.h"
 
-void
-XavierPhase1(XavierState& state)
-{
-	myLog("Phase1");
-	// we need one more space for the off-grid values and one more space for antiDiag2
-	int DPmatrix[LOGICALWIDTH + 2][LOGICALWIDTH + 2];
-
-	// DPmatrix initialization
-	DPmatrix[0][0] = 0;
-	for(int i = 1; i < LOGICALWIDTH + 2; i++ )
-	{
-		DPmatrix[0][i] = -i;
-		DPmatrix[i][0] = -i;
-	}
-
-	// DPmax tracks maximum value in DPmatrix for xdrop condition
-	int DPmax = 0;
-
-	// Dynamic programming loop to fill DPmatrix
-	for(int i = 1; i < LOGICALWIDTH + 2; i++)
-	{
-		for (int j = 1; j <= LOGICALWIDTH + 2 - i; j++) // we only need the upper-left triangular matrix
-		{
-			int oneF = DPmatrix[i-1][j-1];
+//======================================================================================
+// X-DROP ADAPTIVE BANDED ALIGNMENT, ONE BUILD PER INSTRUCTION SET AND LANE WIDTH
+//======================================================================================
 
-			// Comparing bases
-			if(state.queryh[i-1] == state.queryv[j-1])
-				oneF += state.get_match_cost();
-			else
-				oneF += state.get_mismatch_cost();
+// int16 lanes first: the int8 kernels hand them the extensions whose scores they cannot hold. They also run
+// the batched extensions, one per lane (batchkernel.h)
 
-			int twoF = std::max(DPmatrix[i-1][j], DPmatrix[i][j-1]);
-			twoF += state.get_gap_cost();
+namespace xavier_sse42_16 {
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+#include"kernel.h"
+#include"batchkernel.h"
+#pragma GCC pop_options
+}
 
-			DPmatrix[i][j] = std::max(oneF, twoF);
-		
-			// Heuristic to keep track of the max in phase1
-			if(DPmatrix[i][j] > DPmax)
-				DPmax = DPmatrix[i][j];			
-		}
-	}
+namespace xavier_avx2_16 {
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#include"kernel.h"
+#include"batchkernel.h"
+#pragma GCC pop_options
+}
 
-	for(int i = 0; i < LOGICALWIDTH; ++i)
-	{
-		state.update_vqueryh(i, state.queryh[i + 1]);
-		state.update_vqueryv(i, state.queryv[LOGICALWIDTH - i]);
-	}
+namespace xavier_avx512_16 {
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+#include"kernel.h"
+#include"batchkernel.h"
+#pragma GCC pop_options
+}
 
-	state.update_vqueryh(LOGICALWIDTH, NINF);
-	state.update_vqueryv(LOGICALWIDTH, NINF);
+namespace xavier_sse42 {
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+#define XAVIER_WIDER xavier_sse42_16
+#include"kernel.h"
+#undef XAVIER_WIDER
+#pragma GCC pop_options
+}
 
-	int antiDiagMax = std::numeric_limits<int8_t>::min();
+namespace xavier_avx2 {
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define XAVIER_WIDER xavier_avx2_16
+#include"kernel.h"
+#undef XAVIER_WIDER
+#pragma GCC pop_options
+}
 
-	// Load DPmatrix into antiDiag1 and antiDiag2 vector and find max elem at the end of phase1 in antiDiag1
-	for(int i = 1; i < LOGICALWIDTH + 1; ++i)
-	{
-		int value1 = DPmatrix[i][LOGICALWIDTH - i + 1];
-		int value2 = DPmatrix[i + 1][LOGICALWIDTH - i + 1];
+namespace xavier_avx512 {
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+#define XAVIER_WIDER xavier_avx512_16
+#include"kernel.h"
+#undef XAVIER_WIDER
+#pragma GCC pop_options
+}
 
-		state.update_antiDiag1(i - 1, value1);
-		state.update_antiDiag2(i, value2);
+//======================================================================================
+// RUN-TIME DISPATCH
+//======================================================================================
 
-		if(value1 > antiDiagMax)
-			antiDiagMax = value1;
-	}
+typedef std::pair<int, int> (*XavierKernel)(SeedX&, ExtDirectionL, XavierView const&, XavierView const&, ScoringSchemeX&, int const&);
+typedef void (*XavierBatchKernel)(const std::vector<XDropJob>&, std::vector<XDropResult>&, int, int, int, int);
 
-	state.update_antiDiag1(LOGICALWIDTH, NINF);
-	state.update_antiDiag2(0, NINF);
-	state.broadcast_antiDiag3(NINF);
+struct XavierISA
+{
+	const char* name;
+	XavierKernel kernel;
+	XavierBatchKernel batch;	// int16 lanes, one extension each
+};
 
-	state.set_best_score(DPmax);
-	state.set_curr_score(antiDiagMax);
+// from the widest vectors down
+enum { XAVIER_AVX512BW = 0, XAVIER_AVX2 = 1, XAVIER_SSE42 = 2, XAVIER_NUMISA = 3 };
 
-	if(antiDiagMax < DPmax - state.get_score_dropoff())
+static const XavierISA xavierISAs[XAVIER_NUMISA] =
+{
+	{ "avx512bw", xavier_avx512::XavierXDrop, xavier_avx512_16::XavierBatchXDrop },
+	{ "avx2",     xavier_avx2::XavierXDrop,   xavier_avx2_16::XavierBatchXDrop   },
+	{ "sse4.2",   xavier_sse42::XavierXDrop,  xavier_sse42_16::XavierBatchXDrop  }
+};
+
+// cpuid (and the OS saving the vector registers), __builtin_cpu_supports only takes literals
+inline bool
+xavierSupported(int isa)
+{
+	__builtin_cpu_init();
+	switch(isa)
 	{
-		state.xDropCond = true;
-
-		setEndPositionH(state.seed, state.hoffset);
-		setEndPositionV(state.seed, state.voffset);
-
-		return;
+		case XAVIER_AVX512BW: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+		case XAVIER_AVX2:     return __builtin_cpu_supports("avx2");
+		case XAVIER_SSE42:    return __builtin_cpu_supports("sse4.2");
+		default:              return false;
 	}
-	// antiDiag2 going right, first computation of antiDiag3 is going down
 }
 
-void
-XavierPhase2(XavierState& state)
+inline int
+xavierBest()
 {
-	myLog("Phase2");
-	while(state.hoffset < state.hlength && state.voffset < state.vlength)
-	{
-		// antiDiag1F (final)
-		// NOTE: -1 for a match and 0 for a mismatch
-		vectorType match = cmpeqOp(state.get_vqueryh(), state.get_vqueryv());
-		match = blendvOp(state.get_vmismatchCost(), state.get_vmatchCost(), match);
-		vectorType antiDiag1F = addOp(match, state.get_antiDiag1());
-
-		// antiDiag2S (shift)
-		vectorUnionType antiDiag2S = shiftLeft(state.get_antiDiag2());
-
-		// antiDiag2M (pairwise max)
-		vectorType antiDiag2M = maxOp(antiDiag2S.simd, state.get_antiDiag2());
-
-		// antiDiag2F (final)
-		vectorType antiDiag2F = addOp(antiDiag2M, state.get_vgapCost());
-
-		// Compute antiDiag3
-		state.set_antiDiag3(maxOp(antiDiag1F, antiDiag2F));
+	for(int isa = 0; isa < XAVIER_NUMISA; ++isa)
+		if(xavierSupported(isa))
+			return isa;
 
-		// we need to have always antiDiag3 left-aligned
-		state.update_antiDiag3(LOGICALWIDTH, NINF);
-
-		// TODO: x-drop termination
-		// Note: Don't need to check x-drop every time
-		// Create custom max_element that also returns position to save computation
-		int8_t antiDiagBest = *std::max_element(state.antiDiag3.elem, state.antiDiag3.elem + VECTORWIDTH);
-		state.set_curr_score(antiDiagBest + state.get_score_offset());
-
-		int64_t scoreThreshold = state.get_best_score() - state.get_score_dropoff();
-		if (state.get_curr_score() < scoreThreshold)
-		{
-			state.xDropCond = true;
-			
-			setBeginPositionH(state.seed, 0);
-			setBeginPositionV(state.seed, 0);
-
-			setEndPositionH(state.seed, state.hoffset);
-			setEndPositionV(state.seed, state.voffset);
-			
-			return; // GG: it's a void function and the values are saved in XavierState object
-		}
-
-		if (antiDiagBest > CUTOFF)
-		{
-			int8_t min = *std::min_element(state.antiDiag3.elem, state.antiDiag3.elem + LOGICALWIDTH);
-			state.set_antiDiag2(subOp(state.get_antiDiag2(), setOp(min)));
-			state.set_antiDiag3(subOp(state.get_antiDiag3(), setOp(min)));
-			state.set_score_offset(state.get_score_offset() + min);
-		}
-
-		// Update best
-		if (state.get_curr_score() > state.get_best_score())
-			state.set_best_score(state.get_curr_score());
-
-		// TODO: optimize this
-		int maxpos, max = 0;
-		for (int i = 0; i < VECTORWIDTH; ++i)
-		{
-			if (state.antiDiag3.elem[i] > max)
-			{
-				maxpos = i;
-				max = state.antiDiag3.elem[i];
-			}
-		}
-
-		setEndPositionH(state.seed, state.hoffset);
-		setEndPositionV(state.seed, state.voffset);
-
-		if (maxpos > MIDDLE)
-			state.moveRight();
-		else
-			state.moveDown();
-	}
+	fprintf(stderr, "Xavier needs at least SSE4.2\n");
+	exit(1);
 }
 
-void
-XavierPhase4(XavierState& state)
+// the kernel XavierXDrop runs unless xavierSelect() was called: AVX2 wherever the CPU has it, so that the
+// overlaps do not depend on the host (the kernels may end an extension a few cells apart)
+inline int&
+xavierSelected()
 {
-	myLog("Phase4");
-	int dir = state.hoffset >= state.hlength ? goDOWN : goRIGHT;
+	static int selected = xavierSupported(XAVIER_AVX2) ? XAVIER_AVX2 : xavierBest();
+	return selected;
+}
 
-	for (int i = 0; i < (LOGICALWIDTH - 3); i++)
+// use the kernel of isa ("avx512bw", "avx2", "sse4.2" or "auto" for the widest of this CPU), before any alignment starts
+inline void
+xavierSelect(std::string const& isa)
+{
+	if(isa == "auto")
 	{
-		// antiDiag1F (final)
-		// NOTE: -1 for a match and 0 for a mismatch
-		vectorType match = cmpeqOp(state.get_vqueryh(), state.get_vqueryv());
-		match = blendvOp(state.get_vmismatchCost(), state.get_vmatchCost(), match);
-		vectorType antiDiag1F = addOp(match, state.get_antiDiag1());
-
-		// antiDiag2S (shift)
-		vectorUnionType antiDiag2S = shiftLeft(state.get_antiDiag2());
-
-		// antiDiag2M (pairwise max)
-		vectorType antiDiag2M = maxOp(antiDiag2S.simd, state.get_antiDiag2());
-
-		// antiDiag2F (final)
-		vectorType antiDiag2F = addOp(antiDiag2M, state.get_vgapCost());
-
-		// Compute antiDiag3
-		state.set_antiDiag3(maxOp(antiDiag1F, antiDiag2F));
-
-		// we need to have always antiDiag3 left-aligned
-		state.update_antiDiag3(LOGICALWIDTH, NINF);
-
-		// TODO: x-drop termination
-		// note: Don't need to check x drop every time
-		// Create custom max_element that also returns position to save computation
-		int8_t antiDiagBest = *std::max_element(state.antiDiag3.elem, state.antiDiag3.elem + VECTORWIDTH);
-		state.set_curr_score(antiDiagBest + state.get_score_offset());
-
-		int64_t scoreThreshold = state.get_best_score() - state.get_score_dropoff();
-
-		if (state.get_curr_score() < scoreThreshold)
-		{
-			state.xDropCond = true;
-			return; // GG: it's a void function and the values are saved in XavierState object
-		}
-
-		if (antiDiagBest > CUTOFF)
+		xavierSelected() = xavierBest();
+		return;
+	}
+	for(int i = 0; i < XAVIER_NUMISA; ++i)
+	{
+		if(isa != xavierISAs[i].name) continue;
+		if(!xavierSupported(i))
 		{
-			int8_t min = *std::min_element(state.antiDiag3.elem, state.antiDiag3.elem + LOGICALWIDTH);
-			state.set_antiDiag2(subOp(state.get_antiDiag2(), setOp(min)));
-			state.set_antiDiag3(subOp(state.get_antiDiag3(), setOp(min)));
-			state.set_score_offset(state.get_score_offset() + min);
+			fprintf(stderr, "This CPU does not support %s\n", isa.c_str());
+			exit(1);
 		}
-
-		// Update best
-		if (state.get_curr_score() > state.get_best_score())
-			state.set_best_score(state.get_curr_score());
-
-		// antiDiag swap, offset updates, and new base load
-		short nextDir = dir ^ 1;
-
-		if (nextDir == goRIGHT)
-			state.moveRight();
-		else
-			state.moveDown();
-
-		// Update direction
-		dir = nextDir;
+		xavierSelected() = i;
+		return;
 	}
+	fprintf(stderr, "Unknown instruction set %s, use auto, avx512bw, avx2 or sse4.2\n", isa.c_str());
+	exit(1);
 }
 
-//======================================================================================
-// X-DROP ADAPTIVE BANDED ALIGNMENT
-//======================================================================================
-
-void
-XavierOneDirection (XavierState& state) {
-
-	// PHASE 1 (initial values load using dynamic programming)
-	XavierPhase1(state);
-	if(state.xDropCond)  return;
-
-	// PHASE 2 (core vectorized computation)
-	XavierPhase2(state);
-	if(state.xDropCond) return;
-
-	// PHASE 3 (align on one edge)
-	// GG: Phase3 removed to read to code easily (can be recovered from simd/ folder or older commits)
-
-	// PHASE 4 (reaching end of sequences)
-	XavierPhase4(state);
-	if(state.xDropCond) return;
+inline const char*
+xavierISA()
+{
+	return xavierISAs[xavierSelected()].name;
 }
 
+// target and query are strings or views of them (e.g. XavierView(read).twin() for the other strand).
+// Any linear scoring scheme within +/- xavier_sse42_16::HEADROOM: int8 lanes while the scores fit, int16 otherwise
 std::pair<int, int>
 XavierXDrop
 (
 	SeedX& seed,
 	ExtDirectionL direction,
-	std::string const& target,
-	std::string const& query,
+	XavierView const& target,
+	XavierView const& query,
 	ScoringSchemeX& scoringScheme,
 	int const &scoreDropOff
 )
 {
-	// TODO: add check scoring scheme correctness/input parameters
-
-	if (direction == XAVIER_EXTEND_LEFT)
+	if(!xavier_sse42_16::fitsLanes(scoringScheme))
 	{
-		SeedX _seed = seed; // need temporary datastruct
-
-		std::string targetPrefix = target.substr (0, getEndPositionH(seed));	// from read start til start seed (seed included)
-		std::string queryPrefix  = query.substr  (0, getEndPositionV(seed));	// from read start til start seed (seed included)
-		std::reverse (targetPrefix.begin(), targetPrefix.end());
-		std::reverse (queryPrefix.begin(),  queryPrefix.end());
-
-		XavierState result (_seed, targetPrefix, queryPrefix, scoringScheme, scoreDropOff);
-
-		if (targetPrefix.length() >= VECTORWIDTH || queryPrefix.length() >= VECTORWIDTH) 
-			XavierOneDirection (result);
-
-		setBeginPositionH(seed, getEndPositionH(seed) - getEndPositionH(result.seed));
-		setBeginPositionV(seed, getEndPositionV(seed) - getEndPositionV(result.seed));
-
-		return std::make_pair(result.get_best_score(), result.get_curr_score());
+		fprintf(stderr, "Xavier scores have to be within +/-%d\n", xavier_sse42_16::HEADROOM);
+		exit(1);
 	}
-	else if (direction == XAVIER_EXTEND_RIGHT)
-	{
-		SeedX _seed = seed; // need temporary datastruct
-
-		std::string targetSuffix = target.substr (getBeginPositionH(seed), target.length()); 	// from end seed until the end (seed included)
-		std::string querySuffix  = query.substr  (getBeginPositionV(seed), query.length());		// from end seed until the end (seed included)
-
-		XavierState result (_seed, targetSuffix, querySuffix, scoringScheme, scoreDropOff);
-
-		if (targetSuffix.length() >= VECTORWIDTH || querySuffix.length() >= VECTORWIDTH) 
-			XavierOneDirection (result);
+	return xavierISAs[xavierSelected()].kernel(seed, direction, target, query, scoringScheme, scoreDropOff);
+}
 
-		setEndPositionH (seed, getBeginPositionH(seed) + getEndPositionH(result.seed));
-		setEndPositionV (seed, getBeginPositionV(seed) + getEndPositionV(result.seed));
+// many extensions at once, one per int16 lane of the instruction set XavierXDrop runs (see batch.h)
+class BatchXDrop {
+public:
+	BatchXDrop(int match, int mismatch, int gap, int xdrop) : match(match), mismatch(mismatch), gap(gap), xdrop(xdrop) {}
 
-		return std::make_pair(result.get_best_score(), result.get_curr_score());
-	}
-	else
+	// results[x] is the extension of jobs[x]
+	void run(const std::vector<XDropJob>& jobs, std::vector<XDropResult>& results) const
 	{
-		SeedX _seed1 = seed; // need temporary datastruct
-		SeedX _seed2 = seed; // need temporary datastruct
-
-		std::string targetPrefix = target.substr (0, getEndPositionH(seed));	// from read start til start seed (seed not included)
-		std::string queryPrefix  = query.substr  (0, getEndPositionV(seed));	// from read start til start seed (seed not included)
-
-		std::reverse (targetPrefix.begin(), targetPrefix.end());
-		std::reverse (queryPrefix.begin(),  queryPrefix.end());
-
-		XavierState result1(_seed1, targetPrefix, queryPrefix, scoringScheme, scoreDropOff);
-
-		if (targetPrefix.length() < VECTORWIDTH || queryPrefix.length() < VECTORWIDTH) 
-		{
-			setBeginPositionH (seed, getEndPositionH(seed) - targetPrefix.length());
-			setBeginPositionV (seed, getEndPositionV(seed) - queryPrefix.length());
-		}
-		else
-		{
-			XavierOneDirection (result1);
-
-			setBeginPositionH (seed, getEndPositionH(seed) - getEndPositionH(result1.seed));
-			setBeginPositionV (seed, getEndPositionV(seed) - getEndPositionV(result1.seed));
-		}
-
-		std::string targetSuffix = target.substr (getEndPositionH(seed), target.length()); 	// from end seed until the end (seed included)
-		std::string querySuffix  = query.substr  (getEndPositionV(seed), query.length());	// from end seed until the end (seed included)
+		xavierISAs[xavierSelected()].batch(jobs, results, match, mismatch, gap, xdrop);
+	}
 
-		XavierState result2(_seed2, targetSuffix, querySuffix, scoringScheme, scoreDropOff);
+private:
+	int match, mismatch, gap, xdrop;
+};
 
-		if (targetSuffix.length() < VECTORWIDTH || querySuffix.length() < VECTORWIDTH) 
-		{
-			setBeginPositionH (seed, getEndPositionH(seed) + targetSuffix.length());
-			setBeginPositionV (seed, getEndPositionV(seed) + querySuffix.length());
-		}
-		else
-		{
-			XavierOneDirection (result2);
-			
-			setEndPositionH (seed, getEndPositionH(seed) + getEndPositionH(result2.seed));
-			setEndPositionV (seed, getEndPositionV(seed) + getEndPositionV(result2.seed));
-		}
-
-		// seed already updated and saved in result1
-		// this operation sums up best and exit scores for result1 and result2 and stores them in result1
-		result1 += result2;
-		return std::make_pair(result1.get_best_score(), result1.get_curr_score());
-	}
-}
-#endif
\ No newline at end of file
+#endif